@@ -39,6 +39,7 @@
 
 #include <reflex/input.h>
 #include <reflex/absmatcher.h>
+#include <reflex/output.h>
 #include <sstream>
 #include <stack>
 
@@ -95,6 +96,7 @@ class AbstractLexer {
     :
       in_(input),
       os_(&os),
+      sink_(NULL),
       base_(NULL),
       size_(0),
       matcher_(NULL),
@@ -107,6 +109,11 @@ class AbstractLexer {
   virtual ~AbstractLexer()
   {
     DBGLOG("AbstractLexer::~AbstractLexer()");
+    if (sink_ != NULL)
+    {
+      sink_->detach();
+      sink_->owner(NULL, NULL);
+    }
     if (matcher_ != NULL)
       delete matcher_;
   }
@@ -136,6 +143,8 @@ class AbstractLexer {
     /// @returns reference to *this
   {
     in_ = input;
+    if (sink_ != NULL)
+      sink_->detach();
     if (has_matcher())
       matcher().input(in_); // reset and assign new input
     return *this;
@@ -178,6 +187,8 @@ class AbstractLexer {
       size_t size) ///< nonzero size of the buffer
     /// @returns reference to *this
   {
+    if (sink_ != NULL)
+      sink_->detach();
     if (has_matcher())
     {
       matcher().buffer(base, size); // reset and assign new buffer
@@ -193,9 +204,35 @@ class AbstractLexer {
   inline AbstractLexer& out(std::ostream& os) ///< output stream to echo text matches to
     /// @returns reference to *this
   {
+    if (sink_ != NULL)
+    {
+      sink_->detach();
+      sink_->owner(NULL, NULL);
+    }
     os_ = &os;
+    sink_ = NULL;
+    return *this;
+  }
+  /// Set the current output to the given batched output sink to echo text matches to without copying, the sink is used by one lexer at a time and when the sink is deleted first this lexer echoes to std::cout.
+  inline AbstractLexer& out(Output& output) ///< output sink to echo text matches to
+    /// @returns reference to *this
+  {
+    if (sink_ != NULL && sink_ != &output)
+    {
+      sink_->detach();
+      sink_->owner(NULL, NULL);
+    }
+    os_ = &output.stream();
+    sink_ = &output;
+    output.owner(&sink_, &os_);
     return *this;
   }
+  /// Returns pointer to the current batched output sink, NULL if none was set.
+  inline Output *sink() const
+    /// @returns pointer to the current reflex::Output or NULL
+  {
+    return sink_ != NULL && os_ == &sink_->stream() ? sink_ : NULL;
+  }
   /// Returns the current output stream used to echo text matches to.
   inline std::ostream& out() const
     /// @returns reference to the current std::ostream object
@@ -240,6 +277,19 @@ class AbstractLexer {
   {
     return matcher_;
   }
+  /// Returns the memory in bytes held by this lexer and its current matcher per component, excluding the matchers pushed on the stack.
+  typename M::Memory memory_usage() const
+    /// @returns memory usage
+  {
+    typename M::Memory memory;
+    if (has_matcher())
+      memory = matcher_->memory_usage();
+    size_t lexer = sizeof(AbstractLexer) + stack_.size() * sizeof(Matcher*) + state_.size() * sizeof(int);
+    memory.matcher += lexer;
+    memory.total += lexer;
+    memory.peak += lexer;
+    return memory;
+  }
   /// Returns a new copy of the matcher for the given input.
   virtual Matcher *new_matcher(
       const Input& input = Input(), ///< reflex::Input character sequence to match
@@ -252,6 +302,8 @@ class AbstractLexer {
   /// Delete a matcher.
   void del_matcher(Matcher *matcher)
   {
+    if (sink_ != NULL)
+      sink_->detach();
     if (matcher != NULL)
       delete matcher;
     if (matcher_ == matcher)
@@ -266,6 +318,8 @@ class AbstractLexer {
   /// Pop matcher from the stack and continue scanning where it left off, delete the current matcher.
   bool pop_matcher()
   {
+    if (sink_ != NULL)
+      sink_->detach();
     if (matcher_ != NULL)
       delete matcher_;
     if (!stack_.empty())
@@ -280,7 +334,11 @@ class AbstractLexer {
   /// Echo the matched text to the current output.
   inline void echo() const
   {
-    out().write(matcher().begin(), matcher().size());
+    Output *output = sink();
+    if (output != NULL)
+      output->echo(matcher());
+    else
+      out().write(matcher().begin(), matcher().size());
   }
   /// Returns 0-terminated pattern match as a char pointer, does not include matched \0s, this is a constant-time operation.
   inline const char *text() const
@@ -457,6 +515,7 @@ class AbstractLexer {
  protected:
   Input                in_;      ///< the input character sequence to scan
   std::ostream        *os_;      ///< the output stream to echo text matches to
+  Output              *sink_;    ///< the batched output sink to echo text matches to, if non-NULL
   char                *base_;    ///< the buffer to scan in place, if non-NULL
   size_t               size_;    ///< the size of the buffer to scan in place, if nonzero
   Matcher             *matcher_; ///< the matcher used for scanning
@@ -68,6 +68,15 @@
 #define WITH_SPAN 1
 #endif
 
+/// This compile-time option adds ring() to use a double-mapped ring buffer that is rotated instead of shifted, requires Linux memfd_create().
+#ifndef WITH_RING
+#if defined(__linux__)
+#define WITH_RING 1
+#else
+#define WITH_RING 0
+#endif
+#endif
+
 #include <reflex/convert.h>
 #include <reflex/debug.h>
 #include <reflex/input.h>
@@ -78,6 +87,11 @@
 #include <cctype>
 #include <iterator>
 
+#if WITH_RING
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 namespace reflex {
 
 /// Check ASCII word-like character `[A-Za-z0-9_]`, permitting the character range 0..303 (0x12f) and EOF.
@@ -162,6 +176,15 @@ class AbstractMatcher {
     virtual void operator()(AbstractMatcher&, const char*, size_t, size_t) = 0;
     virtual ~Handler() { };
   };
+  /// Memory in bytes held by a matcher per component, see AbstractMatcher::memory_usage().
+  struct Memory {
+    Memory() : matcher(), buffer(), pattern(), total(), peak() { }
+    size_t matcher; ///< the matcher object with its matching state
+    size_t buffer;  ///< the input buffer owned by the matcher, zero when matching a buffer or span in place
+    size_t pattern; ///< the pattern owned by the matcher, zero when the pattern is shared by reference
+    size_t total;   ///< total memory held
+    size_t peak;    ///< peak memory held, with the largest input buffer held since the matcher was constructed
+  };
  protected:
   /// AbstractMatcher::Options for matcher engines.
   struct Option {
@@ -347,22 +370,27 @@ class AbstractMatcher {
     init();
     opt_ = opt;
   }
+  /// Construct a base abstract matcher to match a span of bytes in place without reading input and without allocating a buffer.
+  AbstractMatcher(
+      const char   *base, ///< base of the span of bytes
+      size_t        size, ///< length of the span in bytes
+      const Option& opt)  ///< options
+    :
+      scan(this, Const::SCAN),
+      find(this, Const::FIND),
+      split(this, Const::SPLIT)
+  {
+    opt_ = opt;
+    rbf_ = NULL;
+    rng_ = 0;
+    pkb_ = 0;
+    init_span(base, size);
+  }
   /// Delete abstract matcher, deletes this matcher's internal buffer.
   virtual ~AbstractMatcher()
   {
     DBGLOG("AbstractMatcher::~AbstractMatcher()");
-    if (own_)
-    {
-#if WITH_REALLOC
-#if defined(__WIN32__) || defined(_WIN32) || defined(WIN32) || defined(_WIN64) || defined(__BORLANDC__)
-      _aligned_free(static_cast<void*>(buf_));
-#else
-      std::free(static_cast<void*>(buf_));
-#endif
-#else
-      delete[] buf_;
-#endif
-    }
+    dealloc();
   }
   /// Polymorphic cloning.
   virtual AbstractMatcher *clone() = 0;
@@ -444,6 +472,8 @@ class AbstractMatcher {
     num_ = 0;
     res_ = 0;
     own_ = true;
+    if (max_ > pkb_)
+      pkb_ = max_;
     eof_ = false;
     mat_ = false;
     cml_ = false;
@@ -481,12 +511,31 @@ class AbstractMatcher {
     eof_ = in.eof();
     return eof_;
   }
+  /// Use a double-mapped ring buffer of at least the given size, rounded up to a multiple of the page size, instead of shifting the buffer contents with memmove() when the buffer is full, returns false when not supported or when scanning a buffer in place.
+  bool ring(size_t size = Const::BUFSZ) ///< minimum ring buffer size in bytes
+    /// @returns true when successful
+  {
+    DBGLOG("AbstractMatcher::ring(%zu)", size);
+    if (!own_)
+      return false;
+    if (rng_ >= size)
+      return true;
+    if (size < end_ + Const::BLOCK + 1)
+      size = end_ + Const::BLOCK + 1;
+    return rotate(size);
+  }
 #if WITH_SPAN
   /// Set event handler functor to invoke when the buffer contents are shifted out, e.g. for logging the data searched.
   inline void set_handler(Handler *handler)
   {
     evh_ = handler;
   }
+  /// Get event handler functor to invoke when the buffer contents are shifted out.
+  inline Handler *get_handler() const
+    /// @returns pointer to event handler functor or NULL
+  {
+    return evh_;
+  }
   /// Invoke handler explicitly (externally) with zero shift distance.
   inline void handle(size_t gap = 0)
   {
@@ -562,46 +611,8 @@ class AbstractMatcher {
   {
     if (size > 0)
     {
-      if (own_)
-      {
-#if WITH_REALLOC
-#if defined(__WIN32__) || defined(_WIN32) || defined(WIN32) || defined(_WIN64) || defined(__BORLANDC__)
-        _aligned_free(static_cast<void*>(buf_));
-#else
-        std::free(static_cast<void*>(buf_));
-#endif
-#else
-        delete[] buf_;
-#endif
-      }
-      buf_ = base;
-      txt_ = buf_;
-      len_ = 0;
-      cap_ = 0;
-      cur_ = 0;
-      pos_ = 0;
-      end_ = size - 1;
-      max_ = size;
-      ind_ = 0;
-      blk_ = 0;
-      got_ = Const::BOB;
-      chr_ = '\0';
-#if WITH_SPAN
-      bol_ = buf_;
-      evh_ = NULL;
-#endif
-      lpb_ = buf_;
-      lno_ = 1;
-#if WITH_SPAN
-      cpb_ = buf_;
-#endif
-      cno_ = 0;
-      num_ = 0;
-      res_ = 0;
-      own_ = false;
-      eof_ = true;
-      mat_ = false;
-      cml_ = false;
+      dealloc();
+      init_span(base, size - 1);
     }
     return *this;
   }
@@ -1234,6 +1245,17 @@ class AbstractMatcher {
       return 0;
     return end_ - (txt_ - buf_);
   }
+  /// Returns the memory in bytes held by this matcher per component and its peak memory, excluding the memory of a pattern shared by reference.
+  virtual Memory memory_usage() const
+    /// @returns memory usage
+  {
+    Memory memory;
+    memory.matcher = sizeof(AbstractMatcher);
+    memory.buffer = own_ ? max_ : 0;
+    memory.total = memory.matcher + memory.buffer;
+    memory.peak = memory.matcher + (pkb_ > memory.buffer ? pkb_ : memory.buffer);
+    return memory;
+  }
   /// Returns the byte offset of the match from the start of the line.
   inline size_t border()
     /// @returns border offset
@@ -1341,6 +1363,66 @@ class AbstractMatcher {
     }
     return false;
   }
+  /// Skip input bytes in the specified set of bytes, such as white space, and return true, or return false when no input was skipped.
+  bool skip_bytes(const char *set) ///< 0-terminated string of (up to 8 for SIMD) bytes to skip over
+    /// @returns true if input was skipped, false otherwise
+  {
+    DBGLOG("AbstractMatcher::skip_bytes()");
+    reset_text();
+    int c = cur_ < end_ ? static_cast<unsigned char>(buf_[cur_]) : peek();
+    if (c == EOF || c == '\0' || std::strchr(set, c) == NULL)
+      return false;
+    len_ = 0;
+    while (true)
+    {
+      const char *s = skipbytes(buf_ + cur_, buf_ + end_, set);
+      if (s < buf_ + end_)
+      {
+        set_current(s - buf_);
+        txt_ = buf_ + cur_;
+        return true;
+      }
+      pos_ = cur_ = end_;
+      txt_ = buf_ + end_;
+      if (peek_more() == EOF)
+        break;
+    }
+    set_current(end_);
+    return true;
+  }
+  /// Skip the rest of the line, but not the newline, when the input starts with the specified prefix, such as a comment, and return true, or return false when no input was skipped.
+  bool skip_line(const char *prefix) ///< literal string that starts the line to skip, not empty
+    /// @returns true if input was skipped, false otherwise
+  {
+    DBGLOG("AbstractMatcher::skip_line()");
+    reset_text();
+    size_t n = std::strlen(prefix);
+    if (cur_ < end_ && buf_[cur_] != prefix[0])
+      return false;
+    while (end_ - cur_ < n && peek_more() != EOF)
+      continue;
+    if (end_ - cur_ < n || std::memcmp(buf_ + cur_, prefix, n) != 0)
+      return false;
+    len_ = 0;
+    size_t loc = cur_ + n;
+    while (true)
+    {
+      const char *s = static_cast<const char*>(std::memchr(buf_ + loc, '\n', end_ - loc));
+      if (s != NULL)
+      {
+        set_current(s - buf_);
+        txt_ = buf_ + cur_;
+        return true;
+      }
+      pos_ = cur_ = end_;
+      txt_ = buf_ + end_;
+      if (peek_more() == EOF)
+        break;
+      loc = pos_;
+    }
+    set_current(end_);
+    return true;
+  }
   /// Fetch the rest of the input as text, useful for searching/splitting up to n times after which the rest is needed.
   const char *rest()
     /// @returns const char* string of the remaining input (wrapped with more input when AbstractMatcher::wrap is defined)
@@ -1487,10 +1569,47 @@ class AbstractMatcher {
   Operation split; ///< functor to split input
   Input in;        ///< input character sequence being matched by this matcher
  protected:
+  /// Set the buffer base to match a span of bytes in place, the byte at base[size] may be modified by text() when the buffer is not 0-terminated.
+  void init_span(
+      const char *base, ///< base of the span of bytes
+      size_t      size) ///< length of the span in bytes
+  {
+    buf_ = const_cast<char*>(base); // buffer is not modified unless text() is used
+    txt_ = buf_;
+    len_ = 0;
+    cap_ = 0;
+    cur_ = 0;
+    pos_ = 0;
+    end_ = size;
+    max_ = size + 1;
+    ind_ = 0;
+    blk_ = 0;
+    got_ = Const::BOB;
+    chr_ = '\0';
+#if WITH_SPAN
+    bol_ = buf_;
+    evh_ = NULL;
+#endif
+    lpb_ = buf_;
+    lno_ = 1;
+#if WITH_SPAN
+    cpb_ = buf_;
+#endif
+    cno_ = 0;
+    num_ = 0;
+    res_ = 0;
+    own_ = false;
+    eof_ = true;
+    mat_ = false;
+    cml_ = false;
+  }
   /// Initialize the base abstract matcher at construction.
   virtual void init(const char *opt = NULL) ///< options
   {
     DBGLOG("AbstractMatcher::init(%s)", opt ? opt : "");
+    rbf_ = NULL;
+    rng_ = 0;
+    pkb_ = 0;
     own_ = false; // require allocation of a buffer
     reset(opt);
   }
@@ -1526,16 +1645,39 @@ class AbstractMatcher {
       ind_ -= gap;
       pos_ -= gap;
       end_ -= gap;
-      txt_ -= gap;
-      bol_ -= gap;
-      lpb_ -= gap;
       num_ += gap;
-      std::memmove(buf_, buf_ + gap, end_);
+      if (own_ && rng_ > 0)
+      {
+        // rotate the ring buffer, keeping the buffer contents in place
+        buf_ += gap;
+        if (buf_ >= rbf_ + rng_)
+        {
+          buf_ -= rng_;
+          txt_ -= rng_;
+          bol_ -= rng_;
+          lpb_ -= rng_;
+        }
+      }
+      else
+      {
+        txt_ -= gap;
+        bol_ -= gap;
+        lpb_ -= gap;
+        std::memmove(buf_, buf_ + gap, end_);
+      }
     }
     if (max_ - end_ >= need + 1)
     {
       DBGLOG("Shift buffer to close gap of %zu bytes", gap);
     }
+    else if (own_ && rng_ > 0)
+    {
+      DBGLOG("Expand ring buffer");
+      // invoke user-defined handler when defined
+      handle();
+      if (!rotate(end_ + need + 1))
+        throw std::bad_alloc();
+    }
     else
     {
       size_t newmax = end_ + need;
@@ -1578,11 +1720,34 @@ class AbstractMatcher {
       pos_ -= gap;
       end_ -= gap;
       num_ += gap;
-      if (end_ > 0)
+      if (own_ && rng_ > 0)
+      {
+        // rotate the ring buffer, keeping the buffer contents in place
+        buf_ = txt_;
+        if (buf_ >= rbf_ + rng_)
+          buf_ -= rng_;
+      }
+      else if (end_ > 0)
+      {
         std::memmove(buf_, txt_, end_);
+      }
       txt_ = buf_;
       lpb_ = buf_;
     }
+    else if (own_ && rng_ > 0)
+    {
+      DBGLOG("Expand ring buffer");
+      (void)lineno();
+      cur_ -= gap;
+      ind_ -= gap;
+      pos_ -= gap;
+      end_ -= gap;
+      num_ += gap;
+      buf_ = txt_;
+      lpb_ = buf_;
+      if (!rotate(end_ + need + 1))
+        throw std::bad_alloc();
+    }
     else
     {
       size_t newmax = end_ - gap + need;
@@ -1618,8 +1783,89 @@ class AbstractMatcher {
       }
     }
 #endif
+    if (own_ && max_ > pkb_)
+      pkb_ = max_;
     return true;
   }
+  /// Move the buffer contents to a new double-mapped ring buffer of at least the given size, change max_, buf_, bol_, cpb_, lpb_, and txt_.
+  bool rotate(size_t size) ///< minimum ring buffer size in bytes
+    /// @returns true when successful
+  {
+#if WITH_RING && defined(MFD_CLOEXEC)
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t len = rng_ > 0 ? rng_ : page;
+    while (len < size)
+      len *= 2;
+    len = (len + page - 1) & ~(page - 1);
+    DBGLOG("AbstractMatcher::rotate(%zu) ring size %zu bytes", size, len);
+    // map the same memory twice in a row, such that the contents of the ring are contiguous across the wrap point
+    int fd = memfd_create("reflex", MFD_CLOEXEC);
+    if (fd < 0)
+      return false;
+    char *base = NULL;
+    if (ftruncate(fd, static_cast<off_t>(len)) == 0)
+    {
+      void *addr = mmap(NULL, 2 * len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (addr != MAP_FAILED)
+      {
+        base = static_cast<char*>(addr);
+        if (mmap(base, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+            mmap(base + len, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+        {
+          munmap(base, 2 * len);
+          base = NULL;
+        }
+      }
+    }
+    close(fd);
+    if (base == NULL)
+      return false;
+    std::memcpy(base, buf_, end_);
+    base[end_] = '\0';
+    txt_ = base + (txt_ - buf_);
+    lpb_ = base + (lpb_ - buf_);
+#if WITH_SPAN
+    bol_ = base + (bol_ - buf_);
+    cpb_ = base + (cpb_ - buf_);
+#endif
+    dealloc();
+    buf_ = base;
+    rbf_ = base;
+    rng_ = len;
+    max_ = len;
+    own_ = true;
+    if (max_ > pkb_)
+      pkb_ = max_;
+    return true;
+#else
+    (void)size;
+    return false;
+#endif
+  }
+  /// Delete this matcher's buffer when owned.
+  void dealloc()
+  {
+    if (!own_)
+      return;
+    if (rng_ > 0)
+    {
+#if WITH_RING
+      munmap(rbf_, 2 * rng_);
+#endif
+      rbf_ = NULL;
+      rng_ = 0;
+      return;
+    }
+#if WITH_REALLOC
+#if defined(__WIN32__) || defined(_WIN32) || defined(WIN32) || defined(_WIN64) || defined(__BORLANDC__)
+    _aligned_free(static_cast<void*>(buf_));
+#else
+    std::free(static_cast<void*>(buf_));
+#endif
+#else
+    delete[] buf_;
+#endif
+  }
   /// Returns the next character read from the current input source.
   inline int get()
     /// @returns the character read (unsigned char 0..255) or EOF (-1)
@@ -1740,6 +1986,9 @@ class AbstractMatcher {
   size_t      cno_; ///< column number count (cached)
   size_t      num_; ///< number of bytes shifted out so far, when buffer shifted
   size_t      res_; ///< reserve bytes to keep in the buffer before bol_ when shifting
+  char       *rbf_; ///< base of the double-mapped ring buffer, mapped twice in a row
+  size_t      rng_; ///< size of the ring buffer when AbstractMatcher::ring() is used, zero otherwise
+  size_t      pkb_; ///< peak size of the buffer owned, the largest AbstractMatcher::max_
   bool        own_; ///< true when AbstractMatcher::buf_ allocation is owned and should be deleted
   bool        eof_; ///< true when input has reached EOF
   bool        mat_; ///< true when AbstractMatcher::matches() was successful
@@ -1895,6 +2144,17 @@ class PatternMatcher : public AbstractMatcher {
       pat_(new Pattern(pattern)),
       del_(true)
   { }
+  /// Construct a base abstract matcher from a persistent pattern object (that is shared with this class) to match a span of bytes in place.
+  PatternMatcher(
+      const Pattern& pattern, ///< pattern object for this matcher
+      const char    *base,    ///< base of the span of bytes
+      size_t         size,    ///< length of the span in bytes
+      const Option&  opt)     ///< options
+    :
+      AbstractMatcher(base, size, opt),
+      pat_(&pattern),
+      del_(false)
+  { }
   const Pattern *pat_; ///< points to the pattern object used by the matcher
   bool           del_; ///< true if PatternMatcher::pat_ was allocated and should be deleted
 };
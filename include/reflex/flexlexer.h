@@ -488,11 +488,15 @@ class FlexLexer : public AbstractLexer<M> {
   /// Put back one character on the input character sequence for matching, invalidating the current match info and text.
   inline void unput(char c) ///< 8-bit character to put back
   {
+    if (this->sink() != NULL)
+      this->sink()->flush();
     this->matcher().unput(c);
   }
   /// Put back one wide character on the input character sequence for matching, invalidating the current match info and text.
   inline void unput(int c) ///< wide character to put back
   {
+    if (this->sink() != NULL)
+      this->sink()->flush();
     this->matcher().wunput(c);
   }
   /// Output one character.
@@ -556,7 +560,13 @@ class FlexLexer : public AbstractLexer<M> {
       const char *s, ///< points to text to output
       size_t      n) ///< length of text to output
   {
-    this->out().write(s, static_cast<std::streamsize>(n));
+    Output *output = this->sink();
+    if (output == NULL)
+      this->out().write(s, static_cast<std::streamsize>(n));
+    else if (this->has_matcher() && s == this->matcher().begin() && n == this->matcher().size())
+      output->echo(this->matcher()); // ECHO without copying
+    else
+      output->write(s, n);
   }
   /// Invoked by reflex-generated yyFlexLexer when an error occurs.
   virtual void LexerError(const char *s) ///< error message
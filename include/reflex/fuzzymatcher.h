@@ -203,6 +203,31 @@ class FuzzyMatcher : public Matcher {
     bool                   alt; ///< true if alternating between pattern char substitution and insertion, otherwise insertion only
     bool                   sub; ///< flag alternates between pattern char substitution (true) and insertion (false)
   };
+  /// Find the first char of the pattern prefix in [s,e), in either case when the prefix is case-insensitive, stored in lower case.
+  const char *find_prefix(const char *s, const char *e) const
+    /// @returns pointer to the char found or NULL
+  {
+    char c = *pat_->chr_;
+    const char *l = static_cast<const char*>(std::memchr(s, c, e - s));
+    if (pat_->icp_ && c >= 'a' && c <= 'z')
+    {
+      const char *u = static_cast<const char*>(std::memchr(s, c - ('a' - 'A'), (l != NULL ? l : e) - s));
+      if (u != NULL)
+        return u;
+    }
+    return l;
+  }
+  /// Replace a pattern that is matched with the bit-parallel NFA by its DFA owned by this matcher, fuzzy matching walks the DFA opcode table.
+  void use_dfa()
+  {
+    // FuzzyMatcher::del_ hides PatternMatcher::del_ that is true when the matcher owns its pattern
+    const Pattern *pattern = pat_->clone_dfa();
+    if (own_pattern())
+      delete pat_;
+    pat_ = pattern;
+    PatternMatcher<Pattern>::del_ = true;
+    init_advance();
+  }
   /// Set backtrack point.
   void point(BacktrackPoint& bpt, const Pattern::Opcode *pc, size_t len, bool alternate = true, bool eof = false)
   {
@@ -315,6 +340,8 @@ class FuzzyMatcher : public Matcher {
     REFLEX_OVERRIDE
   {
     DBGLOG("BEGIN FuzzyMatcher::match()");
+    if (pat_->opc_ == NULL && !pat_->nfa_.empty())
+      use_dfa();
     reset_text();
     SaveState sst(ded_);
     len_ = 0; // split text length starts with 0
@@ -934,7 +961,7 @@ unrolled:
       }
       else if (s < e)
       {
-        s = static_cast<const char*>(std::memchr(s, *pat_->chr_, e - s));
+        s = find_prefix(s, e);
         if (s != NULL)
         {
           loc = s - buf_;
@@ -1087,7 +1114,7 @@ unrolled:
               {
                 const char *s = buf_ + loc;
                 const char *e = buf_ + end_;
-                s = static_cast<const char*>(std::memchr(s, *pat_->chr_, e - s));
+                s = find_prefix(s, e);
                 if (s != NULL)
                 {
                   loc = s - buf_;
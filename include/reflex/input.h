@@ -58,7 +58,8 @@ sequence of characters:
 
 - An Input object is instantiated and (re)assigned a (new) source input: either
   a `char*` string, a `wchar_t*` wide string, a `std::string`, a
-  `std::wstring`, a `FILE*` descriptor, or a `std::istream` object.
+  `std::wstring`, a `FILE*` descriptor, a file descriptor, or a `std::istream`
+  object.
 
 - Strings specified as input must be persistent and cannot be temporary.  The
   input string contents are incrementally extracted and converted as necessary,
@@ -75,6 +76,14 @@ sequence of characters:
   automatically to an UTF-8 character sequence when reading the file with
   get(). Also, size() gives the content size in the number of UTF-8 bytes.
 
+- When assigned a file descriptor as input with `Input(fd)`, the file is read
+  with `read()` directly into the buffer passed to get(), bypassing the stdio
+  `FILE*` buffer.  A BOM is checked and UTF-16/32 content is converted to UTF-8
+  the same way as `FILE*` input, reading the file in small blocks to decode.
+  Optionally specify a `file_hint` to advise the kernel to read ahead
+  sequentially and to drop pages after reading them, or specify the file
+  encoding with `Input(fd, enc)`.
+
 - An input object can be reassigned a new source of input for reading at any
   time.
 
@@ -320,6 +329,14 @@ class Input {
     static const file_encoding_type null_data  = 38; ///< swap NUL with LF
     static const file_encoding_type custom     = 39; ///< custom code page
   };
+  /// Common file_hint constants type, differs from file_encoding_type to select the Input(int, file_hint_type) or Input(int, file_encoding_type) constructor.
+  typedef unsigned int file_hint_type;
+  /// Common file_hint constants to advise the kernel how file descriptor input is read, may be combined with `|`.
+  struct file_hint {
+    static const file_hint_type none       = 0; ///< no advice
+    static const file_hint_type sequential = 1; ///< posix_fadvise() POSIX_FADV_SEQUENTIAL to read ahead more aggressively
+    static const file_hint_type noreuse    = 2; ///< posix_fadvise() POSIX_FADV_DONTNEED on data read, for cold scans that should not fill the page cache
+  };
   /// FILE* handler functor base class to analyze FILE* input, handle errors and non-blocking FILE* reads
   struct Handler {
     virtual size_t operator()(
@@ -340,7 +357,9 @@ class Input {
       wstring_(NULL),
       file_(NULL),
       istream_(NULL),
-      size_(0)
+      fd_(-1),
+      size_(0),
+      fdbuf_(NULL)
   {
     init();
   }
@@ -351,14 +370,25 @@ class Input {
       wstring_(input.wstring_),
       file_(input.file_),
       istream_(input.istream_),
+      fd_(input.fd_),
       size_(input.size_),
       uidx_(input.uidx_),
       ulen_(input.ulen_),
       utfx_(input.utfx_),
+      hint_(input.hint_),
       page_(input.page_),
-      handler_(input.handler_)
+      handler_(input.handler_),
+      fdeof_(input.fdeof_),
+      fdpos_(input.fdpos_),
+      fdlen_(input.fdlen_),
+      fdbuf_(NULL)
   {
     std::memcpy(utf8_, input.utf8_, sizeof(utf8_));
+    if (fdpos_ < fdlen_)
+    {
+      fdbuf_ = new char[FDBUF];
+      std::memcpy(fdbuf_, input.fdbuf_, fdlen_);
+    }
   }
   /// Construct input character sequence from a char* string
   Input(
@@ -369,7 +399,9 @@ class Input {
       wstring_(NULL),
       file_(NULL),
       istream_(NULL),
-      size_(size)
+      fd_(-1),
+      size_(size),
+      fdbuf_(NULL)
   {
     init();
   }
@@ -380,7 +412,9 @@ class Input {
       wstring_(NULL),
       file_(NULL),
       istream_(NULL),
-      size_(cstring != NULL ? std::strlen(cstring) : 0)
+      fd_(-1),
+      size_(cstring != NULL ? std::strlen(cstring) : 0),
+      fdbuf_(NULL)
   {
     init();
   }
@@ -391,7 +425,9 @@ class Input {
       wstring_(NULL),
       file_(NULL),
       istream_(NULL),
-      size_(string.size())
+      fd_(-1),
+      size_(string.size()),
+      fdbuf_(NULL)
   {
     init();
   }
@@ -402,7 +438,9 @@ class Input {
       wstring_(NULL),
       file_(NULL),
       istream_(NULL),
-      size_(string != NULL ? string->size() : 0)
+      fd_(-1),
+      size_(string != NULL ? string->size() : 0),
+      fdbuf_(NULL)
   {
     init();
   }
@@ -413,7 +451,9 @@ class Input {
       wstring_(wstring),
       file_(NULL),
       istream_(NULL),
-      size_(0)
+      fd_(-1),
+      size_(0),
+      fdbuf_(NULL)
   {
     init();
   }
@@ -424,7 +464,9 @@ class Input {
       wstring_(wstring.c_str()),
       file_(NULL),
       istream_(NULL),
-      size_(0)
+      fd_(-1),
+      size_(0),
+      fdbuf_(NULL)
   {
     init();
   }
@@ -435,7 +477,9 @@ class Input {
       wstring_(wstring != NULL ? wstring->c_str() : NULL),
       file_(NULL),
       istream_(NULL),
-      size_(0)
+      fd_(-1),
+      size_(0),
+      fdbuf_(NULL)
   {
     init();
   }
@@ -446,7 +490,9 @@ class Input {
       wstring_(NULL),
       file_(file),
       istream_(NULL),
-      size_(0)
+      fd_(-1),
+      size_(0),
+      fdbuf_(NULL)
   {
     init();
   }
@@ -460,9 +506,47 @@ class Input {
       wstring_(NULL),
       file_(file),
       istream_(NULL),
-      size_(0)
+      fd_(-1),
+      size_(0),
+      fdbuf_(NULL)
+  {
+    init();
+    if (file_encoding() == file_encoding::plain)
+      file_encoding(enc, page);
+  }
+  /// Construct input character sequence from an open file descriptor read with read() without stdio buffering, supports UTF-8 conversion from UTF-16 and UTF-32.
+  explicit Input(
+      int            fd,                     ///< input file descriptor
+      file_hint_type hint = file_hint::none) ///< file_hint to advise the kernel
+    :
+      cstring_(NULL),
+      wstring_(NULL),
+      file_(NULL),
+      istream_(NULL),
+      fd_(fd),
+      size_(0),
+      fdbuf_(NULL)
+  {
+    init();
+    file_hint(hint);
+  }
+  /// Construct input character sequence from an open file descriptor read with read() without stdio buffering, using the specified file encoding.
+  Input(
+      int                   fd,                     ///< input file descriptor
+      file_encoding_type    enc,                    ///< file_encoding (when UTF BOM is not present)
+      const unsigned short *page = NULL,            ///< code page for file_encoding::custom
+      file_hint_type        hint = file_hint::none) ///< file_hint to advise the kernel
+    :
+      cstring_(NULL),
+      wstring_(NULL),
+      file_(NULL),
+      istream_(NULL),
+      fd_(fd),
+      size_(0),
+      fdbuf_(NULL)
   {
     init();
+    file_hint(hint);
     if (file_encoding() == file_encoding::plain)
       file_encoding(enc, page);
   }
@@ -473,7 +557,9 @@ class Input {
       wstring_(NULL),
       file_(NULL),
       istream_(&istream),
-      size_(0)
+      fd_(-1),
+      size_(0),
+      fdbuf_(NULL)
   {
     init();
   }
@@ -484,10 +570,17 @@ class Input {
       wstring_(NULL),
       file_(NULL),
       istream_(istream),
-      size_(0)
+      fd_(-1),
+      size_(0),
+      fdbuf_(NULL)
   {
     init();
   }
+  /// Delete input, releases the block read buffer of file descriptor input.
+  ~Input()
+  {
+    delete[] fdbuf_;
+  }
   /// Copy assignment operator.
   Input& operator=(const Input& input)
   {
@@ -495,13 +588,24 @@ class Input {
     wstring_ = input.wstring_;
     file_ = input.file_;
     istream_ = input.istream_;
+    fd_ = input.fd_;
     size_ = input.size_;
     uidx_ = input.uidx_;
     ulen_ = input.ulen_;
     utfx_ = input.utfx_;
+    hint_ = input.hint_;
     page_ = input.page_;
     handler_ = input.handler_;
+    fdeof_ = input.fdeof_;
+    fdpos_ = input.fdpos_;
+    fdlen_ = input.fdlen_;
     std::memcpy(utf8_, input.utf8_, sizeof(utf8_));
+    if (fdpos_ < fdlen_ && this != &input)
+    {
+      if (fdbuf_ == NULL)
+        fdbuf_ = new char[FDBUF];
+      std::memcpy(fdbuf_, input.fdbuf_, fdlen_);
+    }
     return *this;
   }
   /// Cast this Input object to a string, returns NULL when this Input is not a string.
@@ -558,6 +662,12 @@ class Input {
   {
     return istream_;
   }
+  /// Get the file descriptor of this Input object, returns -1 when this Input is not a file descriptor.
+  int fd() const
+    /// @returns file descriptor or -1
+  {
+    return fd_;
+  }
   /// Get the size of the input character sequence in number of ASCII/UTF-8 bytes (zero if size is not determinable from a `FILE*` or `std::istream` source).
   size_t size()
     /// @returns the nonzero number of ASCII/UTF-8 bytes available to read, or zero when source is empty or if size is not determinable e.g. when reading from standard input
@@ -569,7 +679,7 @@ class Input {
       if (size_ == 0)
         wstring_size();
     }
-    else if (file_)
+    else if (file_ || fd_ >= 0)
     {
       if (size_ == 0)
         file_size();
@@ -585,7 +695,7 @@ class Input {
   bool assigned() const
     /// @returns true if this Input object was assigned (not default constructed or cleared)
   {
-    return cstring_ || wstring_ || file_ || istream_;
+    return cstring_ || wstring_ || file_ || istream_ || fd_ >= 0;
   }
   /// Clear this Input by unassigning it.
   void clear()
@@ -594,6 +704,7 @@ class Input {
     wstring_ = NULL;
     file_ = NULL;
     istream_ = NULL;
+    fd_ = -1;
     size_ = 0;
   }
   /// Check if input is available.
@@ -608,6 +719,8 @@ class Input {
       return !::feof(file_) && !::ferror(file_);
     if (istream_)
       return istream_->good();
+    if (fd_ >= 0)
+      return !fdeof_ || fdpos_ < fdlen_;
     return false;
   }
   /// Check if input reached EOF.
@@ -622,6 +735,8 @@ class Input {
       return ::feof(file_) != 0;
     if (istream_)
       return istream_->eof();
+    if (fd_ >= 0)
+      return fdeof_ && fdpos_ >= fdlen_;
     return true;
   }
   /// Get a single character (unsigned char 0..255) or EOF (-1) when end-of-input is reached.
@@ -713,17 +828,18 @@ class Input {
         size_ -= n - k;
       return n - k;
     }
-    if (file_)
+    if (file_ || fd_ >= 0)
     {
       while (true)
       {
         size_t k = file_get(s, n);
         // invoke handler when set, pass FILE* and buffer pointer and size, handler returns equal or lesser size
-        if (handler_ != NULL)
+        if (handler_ != NULL && file_ != NULL)
           k = (*handler_)(file_, s, k);
         if (k > 0)
         {
-          clearerr(file_);
+          if (file_ != NULL)
+            clearerr(file_);
           return k;
         }
         // if a non-recoverable error occurred, then return 0, permit non-blocking IO errors to continue
@@ -754,19 +870,32 @@ class Input {
   {
     return utfx_;
   }
-  /// Initialize the state after (re)setting the input source, auto-detects UTF BOM in FILE* input if the file size is known.
+  /// Set file_hint to advise the kernel how file descriptor input is read, has no effect on other input sources.
+  void file_hint(file_hint_type hint) ///< file_hint
+    ;
+  /// Get the file_hint of the current file descriptor input.
+  file_hint_type file_hint() const
+    /// @returns current file_hint constant
+  {
+    return hint_;
+  }
+  /// Initialize the state after (re)setting the input source, auto-detects UTF BOM in FILE* and file descriptor input if the file size is known.
   void init()
   {
     std::memset(utf8_, 0, sizeof(utf8_));
     uidx_ = 0;
     ulen_ = 0;
     utfx_ = 0;
+    hint_ = 0;
     page_ = NULL;
     handler_ = NULL;
-    if (file_ != NULL)
+    fdeof_ = false;
+    fdpos_ = 0;
+    fdlen_ = 0;
+    if (file_ != NULL || fd_ >= 0)
       file_init();
   }
-  /// Called by init() for a FILE*.
+  /// Called by init() for a FILE* or a file descriptor.
   void file_init();
   /// Called by size() for a wstring.
   void wstring_size();
@@ -774,7 +903,14 @@ class Input {
   void file_size();
   /// Called by size() for a std::istream.
   void istream_size();
-  /// Implements get() on a FILE*, is non-blocking if file is non-blocking, get() blocks to read at least one byte.
+  /// Read up to n items of the given size from the FILE* or file descriptor into buffer s, reads a whole number of items from a file descriptor unless EOF or an error occurs.
+  size_t file_fread(
+      void  *s,    ///< points to the buffer to fill with input
+      size_t size, ///< size of an item in bytes
+      size_t n)    ///< number of items to read
+    /// @returns number of items read
+    ;
+  /// Implements get() on a FILE* or a file descriptor, is non-blocking if file is non-blocking, get() blocks to read at least one byte.
   size_t file_get(
       char  *s, ///< points to the string buffer to fill with input
       size_t n) ///< size of buffer pointed to by s
@@ -784,11 +920,11 @@ class Input {
       char  *s, ///< points to the string buffer to file with input
       size_t n) ///< size of the buffer pointed to by s
   {
-    if (file_ == NULL)
+    if (file_ == NULL && fd_ < 0)
       return false;
     while (true)
     {
-      size_t k = ::fread(s, 1, n, file_);
+      size_t k = file_fread(s, 1, n);
       s += k;
       n -= k;
       if (n == 0)
@@ -809,13 +945,20 @@ class Input {
   const wchar_t        *wstring_; ///< NUL-terminated wide string input (when non-null)
   FILE                 *file_;    ///< FILE* input (when non-null)
   std::istream         *istream_; ///< stream input (when non-null)
+  int                   fd_;      ///< file descriptor input (when >= 0)
   size_t                size_;    ///< size of the remaining input in bytes (size_ == 0 may indicate size is not set)
   char                  utf8_[8]; ///< UTF-8 normalization buffer, >=8 bytes
   unsigned short        uidx_;    ///< index in utf8_[]
   unsigned short        ulen_;    ///< length of data (remaining after uidx_) in utf8_[] or 0 if no data
   file_encoding_type    utfx_;    ///< file_encoding
+  file_hint_type        hint_;    ///< file_hint of file descriptor input
   const unsigned short *page_;    ///< custom code page
   Handler              *handler_; ///< to handle FILE* errors and non-blocking FILE* reads
+  bool                  fdeof_;   ///< true when file descriptor input reached EOF or failed
+  unsigned short        fdpos_;   ///< index in fdbuf_[]
+  unsigned short        fdlen_;   ///< length of data in fdbuf_[]
+  char                 *fdbuf_;   ///< block read buffer of FDBUF bytes allocated for file descriptor input, to decode and to fill small requests without a read() per byte
+  static const size_t   FDBUF = 512; ///< size of the block read buffer fdbuf_[]
 };
 
 /// Stream buffer for reflex::Input, derived from std::streambuf.
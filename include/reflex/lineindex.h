@@ -0,0 +1,204 @@
+/******************************************************************************\
+* Copyright (c) 2016, Robert van Engelen, Genivia Inc. All rights reserved.    *
+*                                                                              *
+* Redistribution and use in source and binary forms, with or without           *
+* modification, are permitted provided that the following conditions are met:  *
+*                                                                              *
+*   (1) Redistributions of source code must retain the above copyright notice, *
+*       this list of conditions and the following disclaimer.                  *
+*                                                                              *
+*   (2) Redistributions in binary form must reproduce the above copyright      *
+*       notice, this list of conditions and the following disclaimer in the    *
+*       documentation and/or other materials provided with the distribution.   *
+*                                                                              *
+*   (3) The name of the author may not be used to endorse or promote products  *
+*       derived from this software without specific prior written permission.  *
+*                                                                              *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED *
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF         *
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO   *
+* EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,       *
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, *
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;  *
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,     *
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR      *
+* OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF       *
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                                   *
+\******************************************************************************/
+
+/**
+@file      lineindex.h
+@brief     RE/flex index of the lines in a span of bytes for random access line and column numbers
+@author    Robert van Engelen - engelen@genivia.com
+@copyright (c) 2016-2023, Robert van Engelen, Genivia Inc. All rights reserved.
+@copyright (c) BSD-3 License - see LICENSE.txt
+*/
+
+#ifndef REFLEX_LINEINDEX_H
+#define REFLEX_LINEINDEX_H
+
+#include <reflex/absmatcher.h>
+#include <reflex/simd.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace reflex {
+
+/// Index of the newlines in a span of bytes to obtain the line number, column number, and begin and end of the line of any position in the span in O(log n) time.
+/**
+A matcher counts line numbers incrementally with `lineno()` from the previous
+match to the current match, which is fast when matching forward, but is slow
+when the positions of matches jump around in a large buffer.  A `LineIndex`
+keeps the positions of all newlines of a span of bytes, which are located once
+when the index is built.  The index does not depend on a pattern and may be
+shared by several matchers of different patterns that search the same span.
+
+Example:
+
+```
+#include <reflex/lineindex.h>
+#include <reflex/matcher.h>
+
+reflex::LineIndex index(data, size);
+reflex::Matcher matcher(pattern, reflex::Input(data, size));
+while (matcher.find())
+  std::cout << index.lineno(matcher) << ":" << index.columno(matcher) << std::endl;
+```
+
+The span must not change while the index is used.  Positions are byte offsets
+from the start of the span, such as the `first()` position of a matcher that
+searches the span from its start.
+*/
+class LineIndex {
+ public:
+  /// Construct an empty line index.
+  LineIndex()
+    :
+      data_(NULL),
+      size_(0)
+  { }
+  /// Construct a line index of a span of bytes.
+  LineIndex(
+      const char *data, ///< points to the span of bytes
+      size_t      size) ///< size of the span in bytes
+  {
+    build(data, size);
+  }
+  /// Construct a line index of a string.
+  explicit LineIndex(const std::string& string) ///< string to index, must not change while the index is used
+  {
+    build(string.data(), string.size());
+  }
+  /// Build the line index of a span of bytes, replaces the current index.
+  void build(
+      const char *data, ///< points to the span of bytes
+      size_t      size) ///< size of the span in bytes
+  {
+    data_ = data;
+    size_ = data != NULL ? size : 0;
+    nls_.clear();
+    if (size_ == 0)
+      return;
+    const char *e = data_ + size_;
+    nls_.reserve(nlcount(data_, e));
+    for (const char *s = data_; (s = static_cast<const char*>(std::memchr(s, '\n', e - s))) != NULL; ++s)
+      nls_.push_back(s - data_);
+  }
+  /// Returns pointer to the span of bytes indexed.
+  const char *data() const
+    /// @returns pointer to the span
+  {
+    return data_;
+  }
+  /// Returns the size of the span of bytes indexed.
+  size_t size() const
+    /// @returns size of the span in bytes
+  {
+    return size_;
+  }
+  /// Returns the number of lines in the span, where the last line may be empty or may be a line without a newline.
+  size_t lines() const
+    /// @returns number of lines
+  {
+    return nls_.size() + 1;
+  }
+  /// Returns the line number of a position in the span.
+  size_t lineno(size_t pos) const ///< position in the span
+    /// @returns line number, starting with line 1
+  {
+    return std::lower_bound(nls_.begin(), nls_.end(), pos) - nls_.begin() + 1;
+  }
+  /// Returns the line number of the match of a matcher that searches the span from its start.
+  size_t lineno(const AbstractMatcher& matcher) const ///< matcher with a match
+    /// @returns line number, starting with line 1
+  {
+    return lineno(matcher.first());
+  }
+  /// Returns the position of the begin of the line of a position in the span.
+  size_t bol(size_t pos) const ///< position in the span
+    /// @returns position of the first byte of the line
+  {
+    return bol_of(lineno(pos));
+  }
+  /// Returns the position of the end of the line of a position in the span.
+  size_t eol(size_t pos) const ///< position in the span
+    /// @returns position of the newline of the line or the size of the span when the line has no newline
+  {
+    return eol_of(lineno(pos));
+  }
+  /// Returns the position of the begin of a line.
+  size_t bol_of(size_t line) const ///< line number, starting with line 1
+    /// @returns position of the first byte of the line
+  {
+    if (line <= 1)
+      return 0;
+    if (line > nls_.size() + 1)
+      return size_;
+    return nls_[line - 2] + 1;
+  }
+  /// Returns the position of the end of a line.
+  size_t eol_of(size_t line) const ///< line number, starting with line 1
+    /// @returns position of the newline of the line or the size of the span when the line has no newline
+  {
+    return line > 0 && line <= nls_.size() ? nls_[line - 1] : size_;
+  }
+  /// Returns the column number of a position in the span, taking tab spacing into account and counting UTF-8 multibyte characters as one column each, takes time linear in the length of the line up to the position.
+  size_t columno(
+      size_t pos,      ///< position in the span
+      size_t tabs = 8) ///< tab size 1, 2, 4, or 8
+    const
+    /// @returns column number, starting with column 0
+  {
+    if (pos > size_)
+      pos = size_;
+    const char *s = data_ + bol(pos);
+    const char *e = data_ + pos;
+    size_t k = 0;
+    size_t m = tabs - 1;
+    while (s < e)
+    {
+      if (*s == '\t')
+        k += 1 + (~k & m); // count tab spacing
+      else
+        k += ((*s & 0xc0) != 0x80); // count column offset in UTF-8 chars
+      ++s;
+    }
+    return k;
+  }
+  /// Returns the column number of the match of a matcher that searches the span from its start, taking the tab size of the matcher into account.
+  size_t columno(AbstractMatcher& matcher) const ///< matcher with a match
+    /// @returns column number, starting with column 0
+  {
+    return columno(matcher.first(), matcher.tabs());
+  }
+ protected:
+  const char         *data_; ///< span of bytes indexed
+  size_t              size_; ///< size of the span in bytes
+  std::vector<size_t> nls_;  ///< positions of the newlines in the span, in increasing order
+};
+
+} // namespace reflex
+
+#endif
@@ -102,7 +102,8 @@ class Matcher : public PatternMatcher<reflex::Pattern> {
     :
       PatternMatcher<reflex::Pattern>(matcher),
       ded_(matcher.ded_),
-      tab_(matcher.tab_)
+      tab_(matcher.tab_),
+      shr_(matcher.shr_)
   {
     DBGLOG("Matcher::Matcher(matcher)");
     init_advance();
@@ -114,6 +115,7 @@ class Matcher : public PatternMatcher<reflex::Pattern> {
     PatternMatcher<reflex::Pattern>::operator=(matcher);
     ded_ = matcher.ded_;
     tab_ = matcher.tab_;
+    shr_ = matcher.shr_;
     init_advance();
     return *this;
   }
@@ -131,6 +133,19 @@ class Matcher : public PatternMatcher<reflex::Pattern> {
     }
     return *this;
   }
+  /// Set the pattern to the latest pattern published by a shared pattern, call between matches to switch to an updated pattern, the pattern is kept alive until this matcher switches again or is deleted.
+  Matcher& pattern(const SharedPattern& shared) ///< shared pattern
+    /// @returns this matcher
+  {
+    DBGLOG("Matcher::pattern(shared)");
+    std::shared_ptr<const Pattern> pattern = shared.get();
+    if (pat_ != pattern.get())
+    {
+      this->pattern(*pattern);
+      shr_.swap(pattern);
+    }
+    return *this;
+  }
   /// Set the pattern to use with this matcher (the given pattern is shared and must be persistent).
   virtual Matcher& pattern(const Pattern *pattern) ///< pattern object for this matcher
     /// @returns this matcher
@@ -172,6 +187,61 @@ class Matcher : public PatternMatcher<reflex::Pattern> {
     ASSERT(pat_ != NULL);
     return *pat_;
   }
+  /// Match a batch of strings entirely against a pattern, advancing several strings in lock-step through the pattern's opcode table to hide memory latency.
+  static void match_batch(
+      const Pattern&     pattern, ///< a reflex::Pattern
+      const char *const *data,    ///< array of n strings, do not need to be 0-terminated
+      const size_t      *size,    ///< array of n string lengths in bytes
+      size_t             n,       ///< number of strings
+      size_t            *accept); ///< array of n results, set to the nonzero accept index of a match or zero
+  /// Returns true if the input from the current position on contains a match, faster than find() because the search stops at the first accepting state reached instead of extending the match, then first() is the position of the match and the search continues after the accepting position.
+  bool contains()
+    /// @returns true if a match was found
+  {
+    return find_any(false);
+  }
+  /// Returns the number of matches from the current position on, or the number of distinct lines on which matches start, a convenience wrapper that iterates find() and keeps only the count.
+  size_t count_all(bool lines = false) ///< true to count distinct lines with matches, using the line counter of lineno()
+    /// @returns number of matches or number of lines with matches
+  {
+    size_t n = 0;
+    if (!lines)
+    {
+      while (match(Const::FIND) != 0)
+        ++n;
+      return n;
+    }
+    size_t line = 0;
+    // the line counted last extends at least up to eol, past its newline or up to the end of the buffer scanned
+    size_t eol = 0;
+    while (match(Const::FIND) != 0)
+    {
+      // matches that start before eol do not need lineno() and each byte is scanned for a newline at most once
+      if (n > 0 && first() < eol)
+        continue;
+      size_t l = lineno();
+      if (n == 0 || l != line)
+      {
+        line = l;
+        ++n;
+      }
+      const char *e = static_cast<const char*>(std::memchr(txt_, '\n', buf_ + end_ - txt_));
+      eol = num_ + (e != NULL ? e - buf_ + 1 : end_);
+    }
+    return n;
+  }
+  /// Appends the locations [first,last) of all matches from the current position on to a vector of offset pairs, a convenience wrapper that iterates find() and keeps only the offsets.
+  size_t find_all(std::vector< std::pair<size_t,size_t> >& offsets) ///< vector of (first,last) pairs to append to
+    /// @returns number of matches found
+  {
+    size_t n = 0;
+    while (match(Const::FIND) != 0)
+    {
+      offsets.push_back(std::pair<size_t,size_t>(first(), last()));
+      ++n;
+    }
+    return n;
+  }
   /// Polymorphic cloning.
   virtual Matcher *clone() REFLEX_OVERRIDE
   {
@@ -186,6 +256,24 @@ class Matcher : public PatternMatcher<reflex::Pattern> {
     tab_.resize(0);
     init_advance();
   }
+  /// Returns the memory in bytes held by this matcher per component and its peak memory, including the memory of a pattern owned by this matcher.
+  virtual Memory memory_usage() const REFLEX_OVERRIDE
+    /// @returns memory usage
+  {
+    Memory memory = PatternMatcher<reflex::Pattern>::memory_usage();
+    memory.matcher = sizeof(Matcher) + tab_.capacity() * sizeof(size_t) + lap_.capacity() * sizeof(int) + stk_.size() * sizeof(Stops);
+    size_t peak = 0;
+    if (del_ && pat_ != NULL)
+    {
+      Pattern::Memory pattern = pat_->memory_usage();
+      memory.pattern = pattern.total;
+      peak = pattern.peak - pattern.total;
+    }
+    memory.total = memory.matcher + memory.buffer + memory.pattern;
+    // the peak of the base matcher is its object plus its largest buffer
+    memory.peak += memory.total - sizeof(AbstractMatcher) - memory.buffer + peak;
+    return memory;
+  }
   /// Returns captured text as a std::pair<const char*,size_t> with string pointer (non-0-terminated) and length.
   virtual std::pair<const char*,size_t> operator[](size_t n) const REFLEX_OVERRIDE
   {
@@ -338,6 +426,35 @@ class Matcher : public PatternMatcher<reflex::Pattern> {
     if (c != EOF)
       --cur_;
   }
+  /// FSM code interpreter of the cold states of hybrid FSM code, returns true to continue with the hot state indexed by s >= size, or false to halt with c.
+  inline bool FSM_CODE(const Pattern::Opcode *code, Pattern::Index size, Pattern::Index& s, int& c)
+  {
+    while (true)
+    {
+      const Pattern::Opcode *pc = code + s;
+      if (Pattern::is_opcode_redo(*pc))
+        FSM_REDO(), ++pc;
+      else if (!Pattern::is_opcode_goto(*pc))
+        FSM_TAKE(Pattern::long_index_of(*pc++));
+      if (Pattern::is_opcode_halt(*pc))
+      {
+        c = AbstractMatcher::Const::UNK;
+        return false;
+      }
+      c = FSM_CHAR();
+      if (c == EOF)
+        return false;
+      while (!Pattern::is_opcode_goto(*pc, static_cast<unsigned char>(c)))
+        pc += 1 + (Pattern::index_of(*pc) == Pattern::Const::LONG);
+      s = Pattern::index_of(*pc);
+      if (s == Pattern::Const::HALT)
+        return false;
+      if (s == Pattern::Const::LONG)
+        s = Pattern::long_index_of(pc[1]);
+      if (s >= size)
+        return true;
+    }
+  }
   /// FSM code HEAD.
   inline void FSM_HEAD(Pattern::Lookahead la)
   {
@@ -453,6 +570,19 @@ class Matcher : public PatternMatcher<reflex::Pattern> {
   }
  protected:
   typedef std::vector<size_t> Stops; ///< indent margin/tab stops
+  /// Construct matcher engine from a persistent pattern to match a span of bytes in place, used by reflex::SpanMatcher.
+  Matcher(
+      const Pattern& pattern, ///< a reflex::Pattern
+      const char    *base,    ///< base of the span of bytes
+      size_t         size,    ///< length of the span in bytes
+      const Option&  opt)     ///< options
+    :
+      PatternMatcher<reflex::Pattern>(pattern, base, size, opt),
+      ded_(0)
+  {
+    DBGLOG("Matcher::Matcher(span)");
+    init_advance();
+  }
   /// FSM data for FSM code
   struct FSM {
     FSM() : bol(), nul(), ch() { }
@@ -1329,6 +1459,22 @@ class Matcher : public PatternMatcher<reflex::Pattern> {
     /// @returns nonzero if input matched the pattern
     REFLEX_OVERRIDE
     ;
+  /// Search for a match that stops at the first accepting state reached, optionally without matching across a newline, used by contains() and SpanMatcher::find_line().
+  bool find_any(bool line); ///< true to run the DFA on one line at a time
+  /// Policies of match_policy() to specialize match() for the pattern and options, see init_match().
+  struct Policy {
+    static const int FSM  = 0x01; ///< match with FSM code instead of the opcode table
+    static const int WORD = 0x02; ///< check word boundaries with option W
+    static const int PRED = 0x04; ///< check the predictor properties bol_, lbk_ and one_ of the pattern
+    static const int LOOK = 0x08; ///< reset lookahead positions for patterns with lookaheads
+    static const int DENT = 0x10; ///< update indent stops and dedents for patterns with indent anchors
+    static const int ALL  = 0x1e; ///< all checks
+  };
+  /// match() specialized at compile time by policy P, a combination of Policy flags.
+  template<int P>
+  size_t match_policy(Method method);
+  /// Initialize the specialized match() for the pattern and options.
+  void init_match();
   /// match() with optimized AVX512BW string search scheme defined in matcher_avx512bw.cpp
   size_t simd_match_avx512bw(Method method);
   /// match() with optimized AVX2 string search scheme defined in matcher_avx2.cpp
@@ -1414,6 +1560,36 @@ class Matcher : public PatternMatcher<reflex::Pattern> {
   // Fallback Boyer-Moore methods
   bool advance_string_bm(size_t loc);
   bool advance_string_bm_pma(size_t loc);
+  // Case-insensitive string methods
+  bool advance_string_icase(size_t loc);
+  bool advance_string_icase_pma(size_t loc);
+  // Case-insensitive string AVX2 methods
+  bool simd_advance_string_icase_avx2(size_t loc);
+  bool simd_advance_string_icase_pma_avx2(size_t loc);
+  // Case-insensitive string AVX512BW methods
+  bool simd_advance_string_icase_avx512bw(size_t loc);
+  bool simd_advance_string_icase_pma_avx512bw(size_t loc);
+  // Case-insensitive string NEON methods
+  bool simd_advance_string_icase_neon(const char *& s, const char *e);
+  bool simd_advance_string_icase_pma_neon(const char *& s, const char *e);
+  /// Returns 0x20 to fold an ASCII letter to lower case with OR when c is a lower case letter of a case-insensitive prefix string, zero otherwise.
+  static inline char icase_mask(char c)
+    /// @returns 0x20 or zero
+  {
+    return c >= 'a' && c <= 'z' ? 0x20 : 0x00;
+  }
+  /// Returns true if the n bytes at s match the case-insensitive prefix string t with lower case ASCII letters.
+  static inline bool icase_equal(const char *s, const char *t, size_t n)
+    /// @returns true if s matches t
+  {
+    while (n-- > 0)
+    {
+      char c = *t++;
+      if ((*s++ | icase_mask(c)) != c)
+        return false;
+    }
+    return true;
+  }
 #if !defined(WITH_NO_INDENT)
   /// Update indentation column counter for indent() and dedent().
   inline void newline()
@@ -1445,16 +1621,286 @@ class Matcher : public PatternMatcher<reflex::Pattern> {
     return (col_ <= 0 || (!tab_.empty() && tab_.back() >= col_)) && (tab_.empty() || tab_.back() <= col_);
   }
 #endif
-  size_t            ded_; ///< dedent count
-  size_t            col_; ///< column counter for indent matching, updated by newline(), indent(), and dedent()
-  Stops             tab_; ///< tab stops set by detecting indent margins
-  std::vector<int>  lap_; ///< lookahead position in input that heads a lookahead match (indexed by lookahead number)
-  std::stack<Stops> stk_; ///< stack to push/pop stops
-  FSM               fsm_; ///< local state for FSM code
-  bool (Matcher::*  adv_)(size_t loc); ///< advance FIND function pointer
-  bool              mrk_; ///< indent \i or dedent \j in pattern found: should check and update indent stops
+  size_t                                ded_; ///< dedent count
+  size_t                                col_; ///< column counter for indent matching, updated by newline(), indent(), and dedent()
+  Stops                                 tab_; ///< tab stops set by detecting indent margins
+  std::vector<int>                      lap_; ///< lookahead position in input that heads a lookahead match (indexed by lookahead number)
+  std::stack<Stops,std::vector<Stops> > stk_; ///< stack to push/pop stops, a vector is not allocated until used
+  FSM                                   fsm_; ///< local state for FSM code
+  bool (Matcher::*                      adv_)(size_t loc); ///< advance FIND function pointer
+  size_t (Matcher::*                    pol_)(Method method); ///< match() specialized by policy, function pointer
+  bool                                  mrk_; ///< indent \i or dedent \j in pattern found: should check and update indent stops
+  std::shared_ptr<const Pattern>        shr_; ///< latest pattern of a SharedPattern used by this matcher, to keep it alive
+};
+
+/// RE/flex matcher engine to match a span of bytes in place, does not read input, does not allocate a buffer, and does not modify the span.
+/**
+A SpanMatcher is used by reflex::match(), reflex::search(), and reflex::find_all()
+to efficiently match short strings such as tokens, keys, and headers.  The span
+does not need to be 0-terminated.  A SpanMatcher inherits Matcher privately and
+only exports the members that do not modify the span, so it cannot be used as a
+Matcher or AbstractMatcher reference.  The members text(), span(), rest(),
+unput() and wunput() are not accessible, use str() or strview() instead.
+*/
+class SpanMatcher : private Matcher {
+ public:
+  using Matcher::accept;
+  using Matcher::first;
+  using Matcher::last;
+  using Matcher::size;
+  using Matcher::wsize;
+  using Matcher::empty;
+  using Matcher::begin;
+  using Matcher::end;
+  using Matcher::str;
+  using Matcher::wstr;
+#if __cplusplus >= 201703L
+  using Matcher::strview;
+#endif
+  using Matcher::lineno;
+  using Matcher::columno;
+  using Matcher::lineno_end;
+  using Matcher::columno_end;
+  using Matcher::lines;
+  using Matcher::columns;
+  using Matcher::at_end;
+  using Matcher::hit_end;
+  using Matcher::contains;
+  using Matcher::count_all;
+  using Matcher::find_all;
+  /// Construct matcher engine from a persistent pattern to match a span of bytes in place.
+  SpanMatcher(
+      const Pattern& pattern,           ///< a reflex::Pattern
+      const char    *base,              ///< base of the span of bytes
+      size_t         size,              ///< length of the span in bytes
+      const Option&  opt = Option())    ///< options
+    :
+      Matcher(pattern, base != NULL ? base : "", size, opt)
+  { }
+  /// Returns nonzero accept index if the entire span matches the pattern.
+  size_t matches()
+    /// @returns nonzero accept index if the entire span matched, zero (i.e. false) otherwise
+  {
+    if (!mat_ && at_bob())
+    {
+      mat_ = Matcher::match(Const::MATCH) != 0 && pos_ >= end_;
+      if (!mat_)
+        cap_ = 0;
+    }
+    return mat_ ? cap_ : 0;
+  }
+  /// Search the span for the next match, returns nonzero accept index of the match and use first() and last() to obtain the match location.
+  size_t search()
+    /// @returns nonzero accept index of the match, zero (i.e. false) otherwise
+  {
+    return Matcher::match(Const::FIND);
+  }
+  /// Search the span for the next line that contains a match, returns true and the line location [first,last) without its newline when found, then continues the search at the next line.
+  bool find_line(
+      size_t& first, ///< set to the position of the first byte of the line
+      size_t& last)  ///< set to the exclusive position of the last byte of the line, excluding the newline
+    /// @returns true if a line with a match was found
+  {
+    if (!find_any(true))
+      return false;
+    const char *b = txt_;
+    while (b > buf_ && b[-1] != '\n')
+      --b;
+    const char *e = static_cast<const char*>(std::memchr(txt_, '\n', buf_ + end_ - txt_));
+    if (e == NULL)
+      e = buf_ + end_;
+    first = b - buf_;
+    last = e - buf_;
+    set_current(e < buf_ + end_ ? last + 1 : end_);
+    return true;
+  }
 };
 
+/// Returns nonzero accept index if the span of bytes matches the pattern entirely, does not allocate memory.
+inline size_t match(
+    const Pattern& pattern, ///< a reflex::Pattern
+    const char    *data,    ///< data to match, does not need to be 0-terminated
+    size_t         size)    ///< length of the data in bytes
+  /// @returns nonzero accept index if the data matched, zero (i.e. false) otherwise
+{
+  SpanMatcher matcher(pattern, data, size);
+  return matcher.matches();
+}
+
+/// Returns nonzero accept index if the string matches the pattern entirely, does not allocate memory.
+inline size_t match(
+    const Pattern&     pattern, ///< a reflex::Pattern
+    const std::string& string)  ///< string to match
+  /// @returns nonzero accept index if the string matched, zero (i.e. false) otherwise
+{
+  return match(pattern, string.data(), string.size());
+}
+
+/// Search a span of bytes for the first match of the pattern, returns nonzero accept index and the match location [first,last) when found, does not allocate memory.
+inline size_t search(
+    const Pattern& pattern,        ///< a reflex::Pattern
+    const char    *data,           ///< data to search, does not need to be 0-terminated
+    size_t         size,           ///< length of the data in bytes
+    size_t        *first = NULL,   ///< if non-NULL, set to the position of the first byte of the match
+    size_t        *last = NULL)    ///< if non-NULL, set to the exclusive position of the last byte of the match
+  /// @returns nonzero accept index of the match, zero (i.e. false) otherwise
+{
+  SpanMatcher matcher(pattern, data, size);
+  size_t accept = matcher.search();
+  if (accept != 0)
+  {
+    if (first != NULL)
+      *first = matcher.first();
+    if (last != NULL)
+      *last = matcher.last();
+  }
+  return accept;
+}
+
+/// Search a string for the first match of the pattern, returns nonzero accept index and the match location [first,last) when found, does not allocate memory.
+inline size_t search(
+    const Pattern&     pattern,      ///< a reflex::Pattern
+    const std::string& string,       ///< string to search
+    size_t            *first = NULL, ///< if non-NULL, set to the position of the first byte of the match
+    size_t            *last = NULL)  ///< if non-NULL, set to the exclusive position of the last byte of the match
+  /// @returns nonzero accept index of the match, zero (i.e. false) otherwise
+{
+  return search(pattern, string.data(), string.size(), first, last);
+}
+
+/// Returns true if the span of bytes contains a match of the pattern, stops at the first accepting state reached, does not allocate memory.
+inline bool contains(
+    const Pattern& pattern, ///< a reflex::Pattern
+    const char    *data,    ///< data to search, does not need to be 0-terminated
+    size_t         size)    ///< length of the data in bytes
+  /// @returns true if the data contains a match
+{
+  SpanMatcher matcher(pattern, data, size);
+  return matcher.contains();
+}
+
+/// Returns true if the string contains a match of the pattern, stops at the first accepting state reached, does not allocate memory.
+inline bool contains(
+    const Pattern&     pattern, ///< a reflex::Pattern
+    const std::string& string)  ///< string to search
+  /// @returns true if the string contains a match
+{
+  return contains(pattern, string.data(), string.size());
+}
+
+/// Returns the number of matches of the pattern in a span of bytes, does not allocate memory.
+inline size_t count_all(
+    const Pattern& pattern, ///< a reflex::Pattern
+    const char    *data,    ///< data to search, does not need to be 0-terminated
+    size_t         size)    ///< length of the data in bytes
+  /// @returns number of matches
+{
+  SpanMatcher matcher(pattern, data, size);
+  return matcher.count_all();
+}
+
+/// Returns the number of matches of the pattern in a string, does not allocate memory.
+inline size_t count_all(
+    const Pattern&     pattern, ///< a reflex::Pattern
+    const std::string& string)  ///< string to search
+  /// @returns number of matches
+{
+  return count_all(pattern, string.data(), string.size());
+}
+
+/// Returns the number of distinct lines in a span of bytes on which matches of the pattern start, does not allocate memory.
+inline size_t count_lines(
+    const Pattern& pattern, ///< a reflex::Pattern
+    const char    *data,    ///< data to search, does not need to be 0-terminated
+    size_t         size)    ///< length of the data in bytes
+  /// @returns number of lines with matches
+{
+  SpanMatcher matcher(pattern, data, size);
+  return matcher.count_all(true);
+}
+
+/// Returns the number of distinct lines in a string on which matches of the pattern start, does not allocate memory.
+inline size_t count_lines(
+    const Pattern&     pattern, ///< a reflex::Pattern
+    const std::string& string)  ///< string to search
+  /// @returns number of lines with matches
+{
+  return count_lines(pattern, string.data(), string.size());
+}
+
+/// Find all lines in a span of bytes that contain a match of the pattern, invoking `f(first, last)` for each line without its newline, skips to the next line when a line matches, does not allocate memory.
+template<typename F> /// @tparam <F> function or functor with parameters (size_t first, size_t last)
+inline size_t find_lines(
+    const Pattern& pattern, ///< a reflex::Pattern
+    const char    *data,    ///< data to search, does not need to be 0-terminated
+    size_t         size,    ///< length of the data in bytes
+    F              f)       ///< function invoked for each line that contains a match
+  /// @returns number of lines that contain a match
+{
+  SpanMatcher matcher(pattern, data, size);
+  size_t n = 0;
+  size_t first, last;
+  while (matcher.find_line(first, last))
+  {
+    f(first, last);
+    ++n;
+  }
+  return n;
+}
+
+/// Find all lines in a string that contain a match of the pattern, invoking `f(first, last)` for each line without its newline, skips to the next line when a line matches, does not allocate memory.
+template<typename F> /// @tparam <F> function or functor with parameters (size_t first, size_t last)
+inline size_t find_lines(
+    const Pattern&     pattern, ///< a reflex::Pattern
+    const std::string& string,  ///< string to search
+    F                  f)       ///< function invoked for each line that contains a match
+  /// @returns number of lines that contain a match
+{
+  return find_lines(pattern, string.data(), string.size(), f);
+}
+
+/// Find all matches of the pattern in a span of bytes, invoking `f(accept, first, last)` for each match, does not allocate memory.
+template<typename F> /// @tparam <F> function or functor with parameters (size_t accept, size_t first, size_t last)
+inline size_t find_all(
+    const Pattern& pattern, ///< a reflex::Pattern
+    const char    *data,    ///< data to search, does not need to be 0-terminated
+    size_t         size,    ///< length of the data in bytes
+    F              f)       ///< function invoked for each match
+  /// @returns number of matches found
+{
+  SpanMatcher matcher(pattern, data, size);
+  size_t n = 0;
+  size_t accept;
+  while ((accept = matcher.search()) != 0)
+  {
+    f(accept, matcher.first(), matcher.last());
+    ++n;
+  }
+  return n;
+}
+
+/// Find all matches of the pattern in a string, invoking `f(accept, first, last)` for each match, does not allocate memory.
+template<typename F> /// @tparam <F> function or functor with parameters (size_t accept, size_t first, size_t last)
+inline size_t find_all(
+    const Pattern&     pattern, ///< a reflex::Pattern
+    const std::string& string,  ///< string to search
+    F                  f)       ///< function invoked for each match
+  /// @returns number of matches found
+{
+  return find_all(pattern, string.data(), string.size(), f);
+}
+
+/// Match a batch of strings entirely against a pattern, sets accept[i] to the nonzero accept index if data[i] matched or zero otherwise, does not allocate memory.
+inline void match_batch(
+    const Pattern&     pattern, ///< a reflex::Pattern
+    const char *const *data,    ///< array of n strings, do not need to be 0-terminated
+    const size_t      *size,    ///< array of n string lengths in bytes
+    size_t             n,       ///< number of strings
+    size_t            *accept)  ///< array of n results
+{
+  Matcher::match_batch(pattern, data, size, n, accept);
+}
+
 } // namespace reflex
 
 #endif
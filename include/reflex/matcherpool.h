@@ -0,0 +1,309 @@
+/******************************************************************************\
+* Copyright (c) 2016, Robert van Engelen, Genivia Inc. All rights reserved.    *
+*                                                                              *
+* Redistribution and use in source and binary forms, with or without           *
+* modification, are permitted provided that the following conditions are met:  *
+*                                                                              *
+*   (1) Redistributions of source code must retain the above copyright notice, *
+*       this list of conditions and the following disclaimer.                  *
+*                                                                              *
+*   (2) Redistributions in binary form must reproduce the above copyright      *
+*       notice, this list of conditions and the following disclaimer in the    *
+*       documentation and/or other materials provided with the distribution.   *
+*                                                                              *
+*   (3) The name of the author may not be used to endorse or promote products  *
+*       derived from this software without specific prior written permission.  *
+*                                                                              *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED *
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF         *
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO   *
+* EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,       *
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, *
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;  *
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,     *
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR      *
+* OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF       *
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                                   *
+\******************************************************************************/
+
+/**
+@file      matcherpool.h
+@brief     RE/flex thread-safe pool of reusable matchers that share a pattern
+@author    Robert van Engelen - engelen@genivia.com
+@copyright (c) 2016-2023, Robert van Engelen, Genivia Inc. All rights reserved.
+@copyright (c) BSD-3 License - see LICENSE.txt
+*/
+
+#ifndef REFLEX_MATCHERPOOL_H
+#define REFLEX_MATCHERPOOL_H
+
+#include <reflex/matcher.h>
+#include <mutex>
+#include <vector>
+
+namespace reflex {
+
+/// RE/flex matcher engine class that is recycled by a reflex::MatcherPool, keeps its own buffer while scanning a buffer in place and sizes its buffer to the input.
+class PooledMatcher : public Matcher {
+ public:
+  /// Construct a pooled matcher engine from a pattern, options, and the initial size of the buffer to allocate.
+  PooledMatcher(
+      const Pattern *pattern,                              ///< points to a reflex::Pattern
+      const char    *opt = NULL,                           ///< option string of the form `(A|N|T(=[[:digit:]])?|;)*`
+      size_t         size = AbstractMatcher::Const::BLOCK) ///< initial buffer size in bytes
+    :
+      Matcher(pattern, Input(), opt),
+      keep_(NULL),
+      kmax_(0),
+      size_(size > 0 ? size : 1)
+  {
+    fit(size_);
+  }
+  /// Delete pooled matcher, deletes this matcher's own buffer also when scanning a buffer in place.
+  virtual ~PooledMatcher()
+  {
+    DBGLOG("PooledMatcher::~PooledMatcher()");
+    restore();
+  }
+  /// Reset this matcher's state to the initial state and set options (when provided), stops scanning a buffer in place.
+  virtual void reset(const char *opt = NULL) REFLEX_OVERRIDE
+  {
+    DBGLOG("PooledMatcher::reset()");
+    restore();
+    Matcher::reset(opt);
+  }
+  using Matcher::buffer;
+  /// Set the buffer base containing 0-terminated character data to scan in place (data may be modified), reset/restart the matcher, this matcher's own buffer is kept for reuse.
+  PooledMatcher& buffer(
+      char  *base, ///< base of the buffer containing 0-terminated character data
+      size_t size) ///< nonzero size of the buffer
+    /// @returns this matcher
+  {
+    if (size > 0)
+    {
+      reset();
+      keep_ = buf_;
+      kmax_ = max_;
+      own_ = false; // prevent AbstractMatcher::buffer() from deleting our own buffer
+      AbstractMatcher::buffer(base, size);
+    }
+    return *this;
+  }
+  /// Set the input character sequence for this matcher and reset/restart the matcher, the buffer is enlarged to hold all input up to Const::BUFSZ bytes when the input size is known.
+  virtual PooledMatcher& input(const Input& input) ///< input character sequence for this matcher
+    /// @returns this matcher
+    REFLEX_OVERRIDE
+  {
+    DBGLOG("PooledMatcher::input()");
+    Matcher::input(input);
+    size_t n = in.size();
+    if (n >= max_ && n < Const::BUFSZ)
+      fit(n);
+    return *this;
+  }
+  /// Reset this matcher to the initial state for reuse, shrinks the buffer when it grew larger than its initial size.
+  void recycle()
+  {
+    DBGLOG("PooledMatcher::recycle()");
+    in = Input();
+    while (!stk_.empty())
+      stk_.pop();
+    reset();
+    if (max_ > size_ + 1)
+      fit(size_);
+  }
+ protected:
+  /// Restore this matcher's own buffer after scanning a buffer in place.
+  void restore()
+  {
+    if (keep_ != NULL)
+    {
+      buf_ = keep_;
+      max_ = kmax_;
+      own_ = true;
+      keep_ = NULL;
+    }
+  }
+  /// Reallocate this matcher's own buffer when no input is buffered, i.e. right after reset().
+  void fit(size_t size) ///< new buffer size in bytes, excluding a byte for a terminating \0
+  {
+    if (!own_ || rng_ > 0 || end_ > 0 || size + 1 == max_)
+      return;
+    DBGLOG("PooledMatcher::fit(%zu)", size);
+    // adjust max to add byte for a terminating \0
+    max_ = size + 1;
+#if WITH_REALLOC
+#if defined(__WIN32__) || defined(_WIN32) || defined(WIN32) || defined(_WIN64) || defined(__BORLANDC__)
+    char *newbuf = static_cast<char*>(_aligned_realloc(static_cast<void*>(buf_), max_, 4096));
+#else
+    char *newbuf = static_cast<char*>(std::realloc(static_cast<void*>(buf_), max_));
+#endif
+    if (newbuf == NULL)
+      throw std::bad_alloc();
+#else
+    char *newbuf = new char[max_];
+    delete[] buf_;
+#endif
+    buf_ = newbuf;
+    buf_[0] = '\0';
+    txt_ = buf_;
+#if WITH_SPAN
+    bol_ = buf_;
+    cpb_ = buf_;
+#endif
+    lpb_ = buf_;
+  }
+  char  *keep_; ///< this matcher's own buffer kept while scanning a buffer in place
+  size_t kmax_; ///< size of the kept buffer
+  size_t size_; ///< initial buffer size to shrink the buffer back to when recycled
+};
+
+/// Thread-safe pool of pre-initialized reflex::PooledMatcher objects that share a reflex::Pattern.
+/**
+Matchers are acquired from the pool with acquire() and returned to the pool
+with release(), or by using a MatcherPool::Guard object that releases the
+matcher when it goes out of scope.  A released matcher is reset in O(1) and is
+reused by the next acquire() without allocating a new buffer.  The pattern is
+shared by all matchers in the pool and must be persistent.
+
+Example:
+
+```
+static const reflex::Pattern pattern("[A-Za-z-]+: [^\\r\\n]*\\r?\\n");
+static reflex::MatcherPool pool(pattern);
+
+bool valid(char *headers, size_t size) // headers[size - 1] == '\0'
+{
+  reflex::MatcherPool::Guard matcher(pool, headers, size); // zero copy
+  while (matcher->scan() != 0)
+    continue;
+  return matcher->at_end();
+}
+```
+*/
+class MatcherPool {
+ public:
+  /// Scoped matcher acquired from a pool, the matcher is released to the pool when the guard goes out of scope.
+  class Guard {
+   public:
+    /// Acquire a matcher from the pool to match the given input.
+    Guard(
+        MatcherPool& pool,            ///< pool to acquire the matcher from
+        const Input& input = Input()) ///< input character sequence for the matcher
+      :
+        pool_(pool),
+        matcher_(pool.acquire(input))
+    { }
+    /// Acquire a matcher from the pool to match a 0-terminated buffer in place.
+    Guard(
+        MatcherPool& pool, ///< pool to acquire the matcher from
+        char        *base, ///< base of the buffer containing 0-terminated character data
+        size_t       size) ///< nonzero size of the buffer
+      :
+        pool_(pool),
+        matcher_(pool.acquire(base, size))
+    { }
+    /// Release the matcher to the pool.
+    ~Guard()
+    {
+      pool_.release(matcher_);
+    }
+    /// Returns reference to the matcher.
+    PooledMatcher& operator*() const
+    {
+      return *matcher_;
+    }
+    /// Returns pointer to the matcher.
+    PooledMatcher *operator->() const
+    {
+      return matcher_;
+    }
+   private:
+    Guard(const Guard&);            // non-copyable
+    Guard& operator=(const Guard&); // non-assignable
+    MatcherPool&   pool_;    ///< the pool to release the matcher to
+    PooledMatcher *matcher_; ///< the matcher acquired
+  };
+  /// Construct a pool of matchers that share a pattern.
+  MatcherPool(
+      const Pattern& pattern,                         ///< persistent pattern shared by the matchers in the pool
+      const char    *opt = NULL,                      ///< matcher option string of the form `(A|N|T(=[[:digit:]])?|;)*`
+      size_t         size = AbstractMatcher::Const::BLOCK) ///< initial buffer size of the matchers in bytes
+    :
+      pat_(&pattern),
+      opt_(opt != NULL ? opt : ""),
+      size_(size)
+  { }
+  /// Delete the pool and the matchers in the pool, all matchers must have been released.
+  ~MatcherPool()
+  {
+    for (std::vector<PooledMatcher*>::iterator i = free_.begin(); i != free_.end(); ++i)
+      delete *i;
+  }
+  /// Pre-initialize matchers and add them to the pool.
+  void reserve(size_t n) ///< number of matchers in the pool to reserve
+  {
+    std::vector<PooledMatcher*> matchers;
+    for (size_t i = size(); i < n; ++i)
+      matchers.push_back(new PooledMatcher(pat_, opt_.c_str(), size_));
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.insert(free_.end(), matchers.begin(), matchers.end());
+  }
+  /// Returns the number of matchers in the pool that are available.
+  size_t size()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return free_.size();
+  }
+  /// Acquire a matcher from the pool to match the given input.
+  PooledMatcher *acquire(const Input& input = Input()) ///< input character sequence for the matcher
+    /// @returns pointer to a matcher
+  {
+    PooledMatcher *matcher = get();
+    matcher->input(input);
+    return matcher;
+  }
+  /// Acquire a matcher from the pool to match a 0-terminated buffer in place without copying the buffer.
+  PooledMatcher *acquire(
+      char  *base, ///< base of the buffer containing 0-terminated character data
+      size_t size) ///< nonzero size of the buffer
+    /// @returns pointer to a matcher
+  {
+    PooledMatcher *matcher = get();
+    matcher->buffer(base, size);
+    return matcher;
+  }
+  /// Release a matcher to the pool.
+  void release(PooledMatcher *matcher) ///< matcher acquired from this pool
+  {
+    if (matcher == NULL)
+      return;
+    matcher->recycle();
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(matcher);
+  }
+ protected:
+  /// Get an available matcher from the pool or create a new matcher.
+  PooledMatcher *get()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!free_.empty())
+      {
+        PooledMatcher *matcher = free_.back();
+        free_.pop_back();
+        return matcher;
+      }
+    }
+    return new PooledMatcher(pat_, opt_.c_str(), size_);
+  }
+  const Pattern              *pat_;   ///< the pattern shared by the matchers in the pool
+  std::string                 opt_;   ///< matcher options
+  size_t                      size_;  ///< initial buffer size of the matchers in bytes
+  std::mutex                  mutex_; ///< mutex to protect the pool
+  std::vector<PooledMatcher*> free_;  ///< matchers in the pool that are available
+};
+
+} // namespace reflex
+
+#endif
@@ -0,0 +1,450 @@
+/******************************************************************************\
+* Copyright (c) 2016, Robert van Engelen, Genivia Inc. All rights reserved.    *
+*                                                                              *
+* Redistribution and use in source and binary forms, with or without           *
+* modification, are permitted provided that the following conditions are met:  *
+*                                                                              *
+*   (1) Redistributions of source code must retain the above copyright notice, *
+*       this list of conditions and the following disclaimer.                  *
+*                                                                              *
+*   (2) Redistributions in binary form must reproduce the above copyright      *
+*       notice, this list of conditions and the following disclaimer in the    *
+*       documentation and/or other materials provided with the distribution.   *
+*                                                                              *
+*   (3) The name of the author may not be used to endorse or promote products  *
+*       derived from this software without specific prior written permission.  *
+*                                                                              *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED *
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF         *
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO   *
+* EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,       *
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, *
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;  *
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,     *
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR      *
+* OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF       *
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                                   *
+\******************************************************************************/
+
+/**
+@file      output.h
+@brief     RE/flex batched output sink to write matches with writev() without copying
+@author    Robert van Engelen - engelen@genivia.com
+@copyright (c) 2016-2023, Robert van Engelen, Genivia Inc. All rights reserved.
+@copyright (c) BSD-3 License - see LICENSE.txt
+*/
+
+#ifndef REFLEX_OUTPUT_H
+#define REFLEX_OUTPUT_H
+
+#include <reflex/absmatcher.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+
+#if (defined(__WIN32__) || defined(_WIN32) || defined(WIN32) || defined(_WIN64) || defined(__BORLANDC__)) && !defined(__CYGWIN__)
+#include <io.h>
+#else
+#include <climits>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+namespace reflex {
+
+/// Batched output sink that collects output in a buffer and writes it with writev() to a file descriptor or to a std::ostream.
+/**
+Text written to the sink with put() and write() is copied into an internal
+buffer.  Matched text echoed with echo() is not copied but referenced in the
+matcher's buffer, such that consecutive matches are written with one vector
+element.  The references are written when the sink is flushed, which happens
+when the internal buffer or vector is full, when the matcher is about to shift
+or reallocate its buffer, when flush() is called, and when the sink is deleted.
+
+A filter passes the unmatched input before each match found with find() to the
+sink with pass(), which forwards the unmatched input directly from the
+matcher's buffer without copying:
+
+```
+reflex::Output out(1); // write to stdout
+reflex::Matcher matcher("password=\\S+", reflex::Input(0));
+out.attach(matcher);
+while (matcher.find())
+{
+  out.pass(matcher);
+  out.write("password=****", 13);
+}
+out.pass(matcher); // pass the rest of the input
+out.flush();
+```
+
+The sink is also a std::streambuf, such that stream() returns a std::ostream
+that writes to the sink to keep output in order when mixed.
+
+@warning Call flush() before the matcher is deleted, reset, or assigned new
+input, and before unput() is used, because the references into the matcher's
+buffer are invalidated.  A reflex::AbstractLexer flushes its sink when needed.
+*/
+class Output : public std::streambuf {
+ public:
+  /// Common constants.
+  struct Const {
+    static const size_t BUFSZ = 65536; ///< default internal buffer size
+    static const size_t IOVSZ = 64;    ///< max number of vector elements to write at once
+  };
+  /// Construct an output sink to write to a file descriptor.
+  Output(
+      int    fd = 1,            ///< file descriptor to write to, stdout by default
+      size_t size = Const::BUFSZ) ///< size of the internal buffer
+    :
+      str_(this),
+      fd_(fd),
+      os_(NULL)
+  {
+    init(size);
+  }
+  /// Construct an output sink to write to a std::ostream.
+  Output(
+      std::ostream& os,                 ///< output stream to write to
+      size_t        size = Const::BUFSZ) ///< size of the internal buffer
+    :
+      str_(this),
+      fd_(-1),
+      os_(&os)
+  {
+    init(size);
+  }
+  /// Flush and delete the output sink, clears the pointers of the owner to this sink.
+  virtual ~Output()
+  {
+    detach();
+    if (own_ != NULL && *own_ == this)
+      *own_ = NULL;
+    if (oos_ != NULL && *oos_ == &str_)
+      *oos_ = NULL;
+    delete[] buf_;
+  }
+  /// Set the pointers of the owner of this sink, such as a lexer, to this sink and to its stream, which are cleared when this sink is deleted, NULL to unset.
+  void owner(
+      Output       **sink, ///< points to the owner's pointer to this sink or NULL
+      std::ostream **os)   ///< points to the owner's pointer to the stream of this sink or NULL
+  {
+    own_ = sink;
+    oos_ = os;
+  }
+  /// Returns a std::ostream that writes to this sink.
+  std::ostream& stream()
+    /// @returns reference to std::ostream
+  {
+    return str_;
+  }
+  /// Returns true if no write error occurred.
+  bool good() const
+    /// @returns true if no write error occurred
+  {
+    return !err_;
+  }
+  /// Returns the number of bytes collected and not yet written.
+  size_t pending() const
+    /// @returns number of bytes
+  {
+    size_t n = 0;
+    for (size_t i = 0; i < num_; ++i)
+      n += vec_[i].len;
+    return n;
+  }
+  /// Copy a character to this sink.
+  void put(int c) ///< character to write
+  {
+    if (len_ >= max_ || num_ >= Const::IOVSZ)
+      flush();
+    buf_[len_] = static_cast<char>(c);
+    add(buf_ + len_++, 1);
+  }
+  /// Copy n bytes to this sink, or write them directly with the collected output when n is large.
+  void write(
+      const char *s, ///< points to the bytes to write
+      size_t      n) ///< number of bytes to write
+  {
+    if (n == 0)
+      return;
+    if (n > max_ - len_)
+    {
+      if (n >= max_ / 2)
+      {
+        // write the collected output and these bytes together without copying
+        add(s, n);
+        flush();
+        return;
+      }
+      flush();
+    }
+    else if (num_ >= Const::IOVSZ)
+    {
+      flush();
+    }
+    std::memcpy(buf_ + len_, s, n);
+    add(buf_ + len_, n);
+    len_ += n;
+  }
+  /// Collect a reference to n bytes to write without copying, the bytes must not change until flushed.
+  void ref(
+      const char *s, ///< points to the bytes to write
+      size_t      n) ///< number of bytes to write
+  {
+    if (n > 0)
+      add(s, n);
+  }
+  /// Attach this sink to a matcher to flush the sink before the matcher shifts its buffer and to pass the unmatched input that the matcher shifts out.
+  void attach(AbstractMatcher& matcher) ///< matcher to attach to
+  {
+#if WITH_SPAN
+    if (mat_ == &matcher && matcher.get_handler() == &flh_)
+      return;
+    flush();
+    if (matcher.get_handler() == NULL || matcher.get_handler() == &flh_)
+    {
+      matcher.set_handler(&flh_);
+      mat_ = &matcher;
+      pos_ = low_ = matcher.before().num;
+    }
+    else
+    {
+      mat_ = NULL;
+    }
+#else
+    (void)matcher;
+#endif
+  }
+  /// Flush this sink and detach it from the attached matcher, must be called before the attached matcher is deleted.
+  void detach()
+  {
+    flush();
+#if WITH_SPAN
+    if (mat_ != NULL && mat_->get_handler() == &flh_)
+      mat_->set_handler(NULL);
+    mat_ = NULL;
+    pas_ = false;
+#endif
+  }
+  /// Echo the text matched by the matcher to this sink without copying the text.
+  void echo(AbstractMatcher& matcher) ///< matcher with a match
+  {
+#if WITH_SPAN
+    attach(matcher);
+    if (mat_ == &matcher)
+    {
+      if (pas_)
+        pass(matcher);
+      ref(matcher.begin(), matcher.size());
+      return;
+    }
+#endif
+    write(matcher.begin(), matcher.size());
+  }
+#if WITH_SPAN
+  /// Pass the unmatched input before the current match found with find() to this sink without copying, or the rest of the input when find() returned zero, the match itself is skipped unless echoed with echo().
+  void pass(AbstractMatcher& matcher) ///< matcher after find()
+  {
+    attach(matcher);
+    if (mat_ != &matcher)
+      return;
+    pas_ = true;
+    size_t first = matcher.first();
+    if (pos_ < low_)
+      pos_ = low_;
+    if (pos_ < first)
+      ref(matcher.begin() - (first - pos_), first - pos_);
+    pos_ = matcher.last();
+  }
+#endif
+  /// Write the collected output.
+  bool flush()
+    /// @returns true when successful
+  {
+    if (num_ > 0)
+    {
+      if (os_ != NULL)
+      {
+        for (size_t i = 0; i < num_; ++i)
+          os_->write(vec_[i].ptr, static_cast<std::streamsize>(vec_[i].len));
+        err_ = err_ || !os_->good();
+      }
+      else
+      {
+        err_ = err_ || !writev();
+      }
+      num_ = 0;
+    }
+    len_ = 0;
+    return !err_;
+  }
+ protected:
+  /// A vector element with a pointer to the bytes to write and the number of bytes.
+  struct Chunk {
+    const char *ptr; ///< points to the bytes to write
+    size_t      len; ///< number of bytes to write
+  };
+#if WITH_SPAN
+  /// Handler invoked by the attached matcher before it shifts or reallocates its buffer.
+  struct Flush : public AbstractMatcher::Handler {
+    virtual void operator()(AbstractMatcher& matcher, const char *buf, size_t gap, size_t num)
+    {
+      out->shift(matcher, buf, gap, num);
+    }
+    Output *out; ///< the sink to flush
+  };
+  /// Pass the unmatched input that is shifted out and flush, invoked by the matcher before it shifts gap bytes out of its buffer.
+  void shift(
+      AbstractMatcher& matcher, ///< matcher that shifts its buffer
+      const char      *buf,     ///< the matcher's buffer
+      size_t           gap,     ///< number of bytes shifted out
+      size_t           num)     ///< number of bytes shifted out before
+  {
+    if (&matcher != mat_)
+      return;
+    if (pas_ && pos_ < num + gap)
+    {
+      if (pos_ < num)
+        pos_ = num;
+      ref(buf + (pos_ - num), num + gap - pos_);
+      pos_ = num + gap;
+    }
+    flush();
+    low_ = num + gap;
+  }
+#endif
+  /// Collect a vector element, combine it with the last element when contiguous, s must not point into buf_ when the vector is full.
+  void add(
+      const char *s, ///< points to the bytes to write
+      size_t      n) ///< number of bytes to write
+  {
+    if (num_ > 0 && vec_[num_ - 1].ptr + vec_[num_ - 1].len == s)
+    {
+      vec_[num_ - 1].len += n;
+      return;
+    }
+    if (num_ >= Const::IOVSZ)
+      flush();
+    vec_[num_].ptr = s;
+    vec_[num_].len = n;
+    ++num_;
+  }
+  /// Write the vector elements to the file descriptor.
+  bool writev()
+    /// @returns true when successful
+  {
+    size_t i = 0;
+    while (i < num_)
+    {
+#if (defined(__WIN32__) || defined(_WIN32) || defined(WIN32) || defined(_WIN64) || defined(__BORLANDC__)) && !defined(__CYGWIN__)
+      int k = ::_write(fd_, vec_[i].ptr, static_cast<unsigned int>(vec_[i].len < 0x40000000 ? vec_[i].len : 0x40000000));
+#else
+      struct iovec iov[Const::IOVSZ];
+      int cnt = 0;
+      for (size_t j = i; j < num_ && cnt < static_cast<int>(Const::IOVSZ); ++j, ++cnt)
+      {
+        iov[cnt].iov_base = const_cast<char*>(vec_[j].ptr);
+        iov[cnt].iov_len = vec_[j].len;
+      }
+#if defined(IOV_MAX)
+      if (cnt > IOV_MAX)
+        cnt = IOV_MAX;
+#endif
+      ssize_t k = ::writev(fd_, iov, cnt);
+#endif
+      if (k < 0)
+      {
+        if (errno == EINTR)
+          continue;
+#if !(defined(__WIN32__) || defined(_WIN32) || defined(WIN32) || defined(_WIN64) || defined(__BORLANDC__)) || defined(__CYGWIN__)
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+          // wait until the non-blocking file descriptor is writable instead of spinning
+          struct pollfd pfd;
+          pfd.fd = fd_;
+          pfd.events = POLLOUT;
+          pfd.revents = 0;
+          if (::poll(&pfd, 1, -1) >= 0 || errno == EINTR)
+            continue;
+        }
+#endif
+        return false;
+      }
+      // skip the elements written, a partial write leaves the rest of an element to write
+      size_t n = static_cast<size_t>(k);
+      while (i < num_ && n >= vec_[i].len)
+        n -= vec_[i++].len;
+      if (n > 0)
+      {
+        vec_[i].ptr += n;
+        vec_[i].len -= n;
+      }
+    }
+    return true;
+  }
+  /// Initialize the sink with an internal buffer of the given size.
+  void init(size_t size) ///< size of the internal buffer
+  {
+    own_ = NULL;
+    oos_ = NULL;
+    max_ = size > 0 ? size : 1;
+    buf_ = new char[max_];
+    len_ = 0;
+    num_ = 0;
+    err_ = false;
+#if WITH_SPAN
+    flh_.out = this;
+    mat_ = NULL;
+    pos_ = 0;
+    low_ = 0;
+    pas_ = false;
+#endif
+  }
+  /// Write a character to this sink, called by std::ostream.
+  virtual int_type overflow(int_type c) REFLEX_OVERRIDE
+  {
+    if (traits_type::eq_int_type(c, traits_type::eof()))
+      return traits_type::not_eof(c);
+    put(traits_type::to_char_type(c));
+    return c;
+  }
+  /// Write n characters to this sink, called by std::ostream.
+  virtual std::streamsize xsputn(const char *s, std::streamsize n) REFLEX_OVERRIDE
+  {
+    write(s, static_cast<size_t>(n));
+    return n;
+  }
+  /// Flush this sink, called by std::ostream.
+  virtual int sync() REFLEX_OVERRIDE
+  {
+    return flush() ? 0 : -1;
+  }
+  std::ostream     str_;              ///< stream that writes to this sink
+  int              fd_;               ///< file descriptor to write to or -1
+  std::ostream    *os_;               ///< stream to write to or NULL
+  Output         **own_;              ///< points to the owner's pointer to this sink or NULL
+  std::ostream   **oos_;              ///< points to the owner's pointer to the stream of this sink or NULL
+  char            *buf_;              ///< internal buffer with copied output
+  size_t           max_;              ///< size of the internal buffer
+  size_t           len_;              ///< number of bytes used in the internal buffer
+  Chunk            vec_[Const::IOVSZ]; ///< vector elements to write
+  size_t           num_;              ///< number of vector elements
+  bool             err_;              ///< true when a write error occurred
+#if WITH_SPAN
+  Flush            flh_;              ///< handler invoked by the attached matcher
+  AbstractMatcher *mat_;              ///< the attached matcher or NULL
+  size_t           pos_;              ///< position in the input of the attached matcher up to which input was passed or skipped
+  size_t           low_;              ///< position in the input of the attached matcher of the first byte in its buffer
+  bool             pas_;              ///< true when pass() was used to pass unmatched input
+#endif
+ private:
+  Output(const Output&);            // non-copyable
+  Output& operator=(const Output&); // non-assignable
+};
+
+} // namespace reflex
+
+#endif
@@ -0,0 +1,341 @@
+/******************************************************************************\
+* Copyright (c) 2016, Robert van Engelen, Genivia Inc. All rights reserved.    *
+*                                                                              *
+* Redistribution and use in source and binary forms, with or without           *
+* modification, are permitted provided that the following conditions are met:  *
+*                                                                              *
+*   (1) Redistributions of source code must retain the above copyright notice, *
+*       this list of conditions and the following disclaimer.                  *
+*                                                                              *
+*   (2) Redistributions in binary form must reproduce the above copyright      *
+*       notice, this list of conditions and the following disclaimer in the    *
+*       documentation and/or other materials provided with the distribution.   *
+*                                                                              *
+*   (3) The name of the author may not be used to endorse or promote products  *
+*       derived from this software without specific prior written permission.  *
+*                                                                              *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED *
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF         *
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO   *
+* EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,       *
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, *
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;  *
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,     *
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR      *
+* OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF       *
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                                   *
+\******************************************************************************/
+
+/**
+@file      parallel.h
+@brief     RE/flex speculative parallel lexing of a large buffer by reflex-generated lexers
+@author    Robert van Engelen - engelen@genivia.com
+@copyright (c) 2016-2023, Robert van Engelen, Genivia Inc. All rights reserved.
+@copyright (c) BSD-3 License - see LICENSE.txt
+*/
+
+#ifndef REFLEX_PARALLEL_H
+#define REFLEX_PARALLEL_H
+
+#include <reflex/input.h>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <ostream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace reflex {
+
+/// Speculative parallel lexer driver that tokenizes a buffer in chunks by instances of a reflex-generated lexer class L, one thread per chunk.
+/**
+The buffer is split into chunks, optionally aligned to start right after a
+synchronization byte such as a newline.  Each chunk is tokenized by a separate
+lexer that starts at the beginning of the chunk in the `INITIAL` start
+condition.  Since the start of a chunk may be in the middle of a token or in a
+different start condition, the tokens of a chunk are speculative until the
+lexer of the previous chunk reaches the same position in the same start
+condition after returning a token.  From that point on both lexers produce the
+same tokens, so the speculative tokens are kept and the rest is discarded.
+Otherwise, the lexer of the previous chunk continues to tokenize sequentially
+until it synchronizes with a lexer of a chunk further on.
+Because the lexer of a chunk starts as if at the beginning of the input, its
+first token may differ when anchors or word boundaries depend on the byte
+before the chunk.  Therefore, a chunk is synchronized at its start only when it
+starts right after a newline and otherwise after its first token.
+
+Lexer class L is a class generated by reflex with a `L(const reflex::Input&,
+std::ostream&)` constructor, a `int lex()` method that returns nonzero tokens
+and zero at the end of the input, a `int start()` method that returns the
+start condition, and a `matcher()` method.  Lexer actions should not keep
+state in the lexer other than the start condition and should not echo text,
+because output is discarded.
+
+Example:
+
+```
+#include "lex.yy.h"
+#include <reflex/parallel.h>
+
+reflex::ParallelLexer<Lexer> lexer(8);
+lexer.lex(data, size);
+for (size_t i = 0; i < lexer.chunks(); ++i)
+  for (auto& token : lexer.tokens(i))
+    std::cout << token.id << ": " << std::string(data + token.first, token.size) << '\n';
+```
+*/
+template<class L> /// @tparam <L> lexer class generated by reflex
+class ParallelLexer {
+ public:
+  /// A token returned by the lexer.
+  struct Token {
+    Token(int id, size_t first, size_t size)
+      :
+        id(id),
+        first(first),
+        size(size)
+    { }
+    int    id;    ///< nonzero token returned by the lexer
+    size_t first; ///< position of the token's text in the buffer
+    size_t size;  ///< length of the token's text in bytes
+  };
+  /// Tokens of a chunk.
+  typedef std::vector<Token> Tokens;
+  /// Construct a parallel lexer driver.
+  ParallelLexer(
+      size_t threads = 0,    ///< number of threads and chunks, or zero to use the hardware concurrency
+      int    sync    = '\n') ///< chunks start right after this byte, or -1 to split chunks at any byte
+    :
+      threads_(threads > 0 ? threads : std::max<size_t>(std::thread::hardware_concurrency(), 1)),
+      sync_(sync),
+      relexed_(0)
+  { }
+  /// Delete the parallel lexer driver.
+  virtual ~ParallelLexer()
+  {
+    clear();
+  }
+  /// Tokenize a buffer in parallel, rethrows an exception thrown by a lexer when tokenizing the buffer sequentially would have thrown it.
+  size_t lex(
+      const char *data, ///< points to the buffer to tokenize
+      size_t      size) ///< size of the buffer in bytes
+    /// @returns total number of tokens
+  {
+    clear();
+    relexed_ = 0;
+    size_t n = std::min(threads_, std::max<size_t>(size, 1));
+    for (size_t i = 0; i < n; ++i)
+    {
+      size_t begin = i * (size / n);
+      if (i > 0 && sync_ >= 0)
+      {
+        const char *s = static_cast<const char*>(std::memchr(data + begin, sync_, size - begin));
+        begin = s != NULL ? s - data + 1 : size;
+      }
+      if (i > 0 && (begin >= size || begin <= chunks_.back()->begin))
+        continue;
+      chunks_.push_back(new Chunk(begin));
+    }
+    for (size_t i = 0; i < chunks_.size(); ++i)
+      chunks_[i]->end = i + 1 < chunks_.size() ? chunks_[i + 1]->begin : size;
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunks_.size(); ++i)
+      workers.push_back(std::thread(&ParallelLexer::speculate, chunks_[i], data, size));
+    speculate(chunks_[0], data, size);
+    for (size_t i = 0; i < workers.size(); ++i)
+      workers[i].join();
+    synchronize(data);
+    size_t count = 0;
+    for (size_t i = 0; i < chunks_.size(); ++i)
+      count += chunks_[i]->tokens.size();
+    return count;
+  }
+  /// Returns the number of chunks tokenized by the last lex() call.
+  size_t chunks() const
+  {
+    return chunks_.size();
+  }
+  /// Returns the tokens of chunk i, the tokens of chunks 0 to chunks()-1 concatenated in order are the tokens of the buffer.
+  const Tokens& tokens(size_t i) const
+  {
+    return chunks_.at(i)->tokens;
+  }
+  /// Returns the number of bytes tokenized sequentially by the last lex() call, because speculative lexing failed to synchronize.
+  size_t relexed() const
+  {
+    return relexed_;
+  }
+ protected:
+  /// A chunk of the buffer with its lexer and its speculative tokens.
+  struct Chunk {
+    Chunk(size_t begin)
+      :
+        begin(begin),
+        end(begin),
+        lexer(NULL),
+        null(NULL),
+        eof(false)
+    { }
+    ~Chunk()
+    {
+      if (lexer != NULL)
+        delete lexer;
+    }
+    size_t                             begin;  ///< position of the chunk in the buffer
+    size_t                             end;    ///< position of the next chunk in the buffer
+    L                                 *lexer;  ///< lexer of this chunk or NULL
+    std::ostream                       null;   ///< discards lexer output
+    Tokens                             tokens; ///< tokens of this chunk
+    std::vector<std::pair<size_t,int> > states; ///< position and start condition of the lexer after each token
+    std::exception_ptr                 error;  ///< exception thrown by the lexer
+    bool                               eof;    ///< lexer reached the end of the buffer
+  };
+  /// Tokenize a chunk until its lexer returns a token that ends at or after the end of the chunk.
+  static void speculate(
+      Chunk      *chunk, ///< chunk to tokenize
+      const char *data,  ///< points to the buffer
+      size_t      size)  ///< size of the buffer in bytes
+  {
+    try
+    {
+      chunk->lexer = new L(Input(data + chunk->begin, size - chunk->begin), chunk->null);
+      size_t pos = chunk->begin;
+      while (pos < chunk->end || chunk->end == size)
+      {
+        if (!next(chunk->lexer, chunk->begin, chunk->tokens, chunk->states))
+        {
+          chunk->eof = true;
+          break;
+        }
+        pos = chunk->states.back().first;
+      }
+    }
+    catch (...)
+    {
+      chunk->error = std::current_exception();
+    }
+  }
+  /// Invoke the lexer to return the next token, add the token and the lexer state after the token.
+  static bool next(
+      L                                   *lexer,  ///< lexer
+      size_t                               begin,  ///< position in the buffer where the lexer started
+      Tokens&                              tokens, ///< tokens to add the token to
+      std::vector<std::pair<size_t,int> >& states) ///< states to add the lexer state to
+    /// @returns true if a token was returned, false at the end of the buffer
+  {
+    int id = lexer->lex();
+    if (id == 0)
+      return false;
+    size_t first = begin + lexer->matcher().first();
+    size_t size = lexer->matcher().size();
+    tokens.push_back(Token(id, first, size));
+    states.push_back(std::pair<size_t,int>(first + size, lexer->start()));
+    return true;
+  }
+  /// Compare lexer states by position.
+  static bool before(const std::pair<size_t,int>& a, const std::pair<size_t,int>& b)
+  {
+    return a.first < b.first;
+  }
+  /// Validate speculative tokens chunk by chunk, continue with the lexer of a chunk until it reaches the same state as a lexer of a chunk further on.
+  void synchronize(const char *data) ///< points to the buffer
+  {
+    Chunk *chunk = chunks_[0];
+    if (chunk->error)
+      std::rethrow_exception(chunk->error);
+    std::pair<size_t,int> state(chunk->begin, 0);
+    if (!chunk->states.empty())
+      state = chunk->states.back();
+    for (size_t i = 1; i < chunks_.size(); ++i)
+    {
+      Chunk *next_chunk = chunks_[i];
+      bool synced = false;
+      while (!chunk->eof)
+      {
+        if (!next_chunk->error)
+        {
+          // the lexer of the next chunk starts as if at the begin of a line, anchors and word boundaries match the same only after a newline
+          if (state.first == next_chunk->begin && state.second == 0 && data[state.first - 1] == '\n')
+          {
+            synced = true;
+            break;
+          }
+          typename std::vector<std::pair<size_t,int> >::iterator j = std::lower_bound(next_chunk->states.begin(), next_chunk->states.end(), state, before);
+          if (j != next_chunk->states.end() && j->first == state.first)
+          {
+            // skip lexer states at the same position with a different start condition
+            while (j != next_chunk->states.end() && j->first == state.first && j->second != state.second)
+              ++j;
+            if (j != next_chunk->states.end() && *j == state)
+            {
+              size_t k = j - next_chunk->states.begin() + 1;
+              next_chunk->tokens.erase(next_chunk->tokens.begin(), next_chunk->tokens.begin() + k);
+              next_chunk->states.erase(next_chunk->states.begin(), next_chunk->states.begin() + k);
+              synced = true;
+              break;
+            }
+          }
+          else if (j == next_chunk->states.end())
+          {
+            // the speculative tokens of the next chunk are exhausted, tokenize further on sequentially
+            break;
+          }
+        }
+        else if (state.first >= next_chunk->end)
+        {
+          break;
+        }
+        size_t pos = state.first;
+        if (!next(chunk->lexer, chunk->begin, chunk->tokens, chunk->states))
+        {
+          chunk->eof = true;
+          break;
+        }
+        state = chunk->states.back();
+        relexed_ += state.first - pos;
+      }
+      if (synced)
+      {
+        delete chunk->lexer;
+        chunk->lexer = NULL;
+        chunk = next_chunk;
+        if (!chunk->states.empty())
+          state = chunk->states.back();
+      }
+      else
+      {
+        // the lexer of the current chunk continues, discard the speculative tokens of the next chunk
+        next_chunk->tokens.clear();
+        next_chunk->states.clear();
+        delete next_chunk->lexer;
+        next_chunk->lexer = NULL;
+      }
+    }
+    while (!chunk->eof)
+    {
+      size_t pos = state.first;
+      if (!next(chunk->lexer, chunk->begin, chunk->tokens, chunk->states))
+        break;
+      state = chunk->states.back();
+      relexed_ += state.first - pos;
+    }
+    delete chunk->lexer;
+    chunk->lexer = NULL;
+  }
+  /// Delete all chunks.
+  void clear()
+  {
+    for (size_t i = 0; i < chunks_.size(); ++i)
+      delete chunks_[i];
+    chunks_.clear();
+  }
+  size_t              threads_; ///< number of threads
+  int                 sync_;    ///< synchronization byte or -1
+  size_t              relexed_; ///< number of bytes tokenized sequentially
+  std::vector<Chunk*> chunks_;  ///< chunks of the buffer tokenized
+};
+
+} // namespace reflex
+
+#endif
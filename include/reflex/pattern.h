@@ -55,6 +55,8 @@
 #include <bitset>
 #include <vector>
 #include <stack>
+#include <memory>
+#include <mutex>
 
 // ugrep 7.0: use vectorized bitap (hashed) with AVX2, but it is not faster (in our extensive emperical testing)
 // #define WITH_BITAP_AVX2
@@ -76,8 +78,9 @@ namespace reflex {
 
 /// Pattern class holds a regex pattern and its compiled FSM opcode table or code for the reflex::Matcher engine.
 class Pattern {
-  friend class Matcher;      ///< permit access by the reflex::Matcher engine
-  friend class FuzzyMatcher; ///< permit access by the reflex::FuzzyMatcher engine
+  friend class Matcher;       ///< permit access by the reflex::Matcher engine
+  friend class FuzzyMatcher;  ///< permit access by the reflex::FuzzyMatcher engine
+  friend class StreamMatcher; ///< permit access by the reflex::StreamMatcher engine
  public:
   typedef uint8_t  Bitap;  ///< bitap bitmask, unsigned 8, 16 or 32 bit for 8, 16 or 32 BITS (number of characters matched)
   typedef uint16_t Pred;   ///< predict match bits for PM3+PM5 or PM4+PM4 to store 2x8 bits
@@ -108,12 +111,36 @@ class Pattern {
     static const Pred   PM_M = 4;          ///< total predict-match length 4 of PM4
 #endif
   };
+  /// Complexity estimate of a pattern computed after parsing and refined while constructing its DFA, see Pattern::estimate().
+  struct Estimate {
+    Estimate() : positions(), follows(), fanout(), repeats(), depth(), states(), bytes(), exact() { }
+    size_t positions; ///< number of regex positions, a position in a bounded repeat x{n,m} counts m times
+    size_t follows;   ///< total size of the follow sets of the positions
+    size_t fanout;    ///< max size of a follow set, large for alternations such as the UTF-8 sequences of Unicode character classes
+    size_t repeats;   ///< max number of copies of a position made by nested bounded repeats, e.g. 500 for (x{50}){10}
+    size_t depth;     ///< longest sequence of positions without loops, the number of DFA levels to extrapolate the growth of the DFA
+    size_t states;    ///< estimated number of DFA states, extrapolated from the growth of the DFA levels constructed
+    size_t bytes;     ///< estimated memory in bytes to construct the DFA
+    bool   exact;     ///< true if the DFA was constructed and the number of states is exact
+  };
+  /// Memory in bytes held by a pattern per component, see Pattern::memory_usage().
+  struct Memory {
+    Memory() : pattern(), opcodes(), predictor(), hfa(), nfa(), total(), peak() { }
+    size_t pattern;   ///< the pattern object with its regex string and subpattern tables
+    size_t opcodes;   ///< the opcode table owned by the pattern, zero for FSM code and for opcode tables passed to the constructor
+    size_t predictor; ///< the predictor tables, tables shared by patterns with identical tables are counted by each pattern
+    size_t hfa;       ///< the indexing hash finite state automaton
+    size_t nfa;       ///< the bit-parallel NFA tables
+    size_t total;     ///< total memory held
+    size_t peak;      ///< peak memory held when constructing the pattern, including the DFA released after assembling its opcodes
+  };
   /// Construct an unset pattern.
   Pattern()
     :
       opc_(NULL),
       fsm_(NULL),
-      nop_(0)
+      nop_(0),
+      tbl_(NULL)
   {
     init(NULL);
   }
@@ -124,7 +151,8 @@ class Pattern {
     :
       rex_(regex),
       opc_(NULL),
-      fsm_(NULL)
+      fsm_(NULL),
+      tbl_(NULL)
   {
     init(options);
   }
@@ -135,7 +163,8 @@ class Pattern {
     :
       rex_(regex),
       opc_(NULL),
-      fsm_(NULL)
+      fsm_(NULL),
+      tbl_(NULL)
   {
     init(options.c_str());
   }
@@ -146,7 +175,8 @@ class Pattern {
     :
       rex_(regex),
       opc_(NULL),
-      fsm_(NULL)
+      fsm_(NULL),
+      tbl_(NULL)
   {
     init(options);
   }
@@ -157,7 +187,8 @@ class Pattern {
     :
       rex_(regex),
       opc_(NULL),
-      fsm_(NULL)
+      fsm_(NULL),
+      tbl_(NULL)
   {
     init(options.c_str());
   }
@@ -167,7 +198,8 @@ class Pattern {
       const char   *pred = NULL)
     :
       opc_(code),
-      fsm_(NULL)
+      fsm_(NULL),
+      tbl_(NULL)
   {
     init(NULL, pred);
   }
@@ -177,24 +209,37 @@ class Pattern {
       const char *pred = NULL)
     :
       opc_(NULL),
-      fsm_(fsm)
+      fsm_(fsm),
+      tbl_(NULL)
   {
     init(NULL, pred);
   }
   /// Copy constructor.
   Pattern(const Pattern& pattern) ///< pattern to copy
+    :
+      opc_(NULL),
+      fsm_(NULL),
+      nop_(0),
+      tbl_(NULL)
   {
     operator=(pattern);
   }
-  /// Destructor, deletes internal code array when owned and allocated.
+  /// Destructor, deletes internal code array when owned and allocated and releases the predictor tables.
   virtual ~Pattern()
   {
     clear();
+    release_tables();
   }
   /// Clear and delete pattern data.
   void clear()
   {
     rex_.clear();
+    end_.clear();
+    acc_.clear();
+    nfa_.clear();
+    for (size_t i = 0; i < HFA::MAX_DEPTH; ++i)
+      hfa_.hashes[i].clear();
+    hfa_.states.clear();
     if (nop_ > 0 && opc_ != NULL)
       delete[] opc_;
     opc_ = NULL;
@@ -266,6 +311,10 @@ class Pattern {
     vms_ = pattern.vms_;
     ems_ = pattern.ems_;
     wms_ = pattern.wms_;
+    ams_ = pattern.ams_;
+    hno_ = pattern.hno_;
+    est_ = pattern.est_;
+    dmu_ = pattern.dmu_;
     if (pattern.nop_ > 0 && pattern.opc_ != NULL)
     {
       nop_ = pattern.nop_;
@@ -276,8 +325,11 @@ class Pattern {
     }
     else
     {
+      opc_ = pattern.opc_;
       fsm_ = pattern.fsm_;
+      nfa_ = pattern.nfa_;
     }
+    copy_predictor(pattern);
     return *this;
   }
   /// Assign a (new) pattern.
@@ -322,6 +374,20 @@ class Pattern {
   {
     return choice >= 1 && choice <= size() && acc_.at(choice - 1);
   }
+  /// Add a regex as a new top-level alternative to this pattern and recompile the pattern as a whole, when the regex contains top-level alternations then these are added as new subpatterns, do not call while matchers use this pattern, use SharedPattern::add() instead.
+  Accept add(const char *regex) ///< regex string to add as a new subpattern
+    /// @returns the subpattern index of the (first) subpattern added
+    ;
+  /// Add a regex as a new top-level alternative to this pattern and recompile the pattern as a whole, when the regex contains top-level alternations then these are added as new subpatterns, do not call while matchers use this pattern, use SharedPattern::add() instead.
+  Accept add(const std::string& regex) ///< regex string to add as a new subpattern
+    /// @returns the subpattern index of the (first) subpattern added
+  {
+    return add(regex.c_str());
+  }
+  /// Remove a top-level alternative from this pattern and recompile the pattern as a whole, the subpattern indexes of the other subpatterns do not change and the removed subpattern is no longer reachable, removing the last subpattern also drops the removed subpatterns before it to decrease size(), do not call while matchers use this pattern, use SharedPattern::remove() instead.
+  Pattern& remove(Accept choice) ///< subpattern index of the subpattern to remove, 1 to size()
+    /// @returns reference to this pattern
+    ;
   /// Get the number of finite state machine nodes (vertices).
   size_t nodes() const
     /// @returns number of nodes or 0 when no finite state machine was constructed by this pattern
@@ -334,6 +400,22 @@ class Pattern {
   {
     return nop_ > 0 ? eno_ : 0;
   }
+  /// Get the number of positions of the bit-parallel NFA simulated instead of a DFA that grows beyond DFA::NFA_STATES states.
+  size_t positions() const
+    /// @returns number of NFA positions or 0 when the pattern is matched with a DFA
+  {
+    return nfa_.size;
+  }
+  /// Get the complexity estimate of this pattern computed after parsing and refined while constructing its DFA.
+  const Estimate& estimate() const
+    /// @returns estimate with the exact number of DFA states when the DFA was constructed
+  {
+    return est_;
+  }
+  /// Get the memory in bytes held by this pattern per component and the peak memory held when constructing this pattern.
+  Memory memory_usage() const
+    /// @returns memory usage
+    ;
   /// Get the code size in number of words.
   size_t words() const
     /// @returns number of words or 0 when no code was generated by this pattern
@@ -726,6 +808,19 @@ class Pattern {
     {
       return &node->edges[c];
     }
+    /// memory in bytes held by the tree.
+    size_t bytes() const
+    {
+      return tree != NULL ? sizeof(Node) + bytes(*tree) : 0;
+    }
+    /// memory in bytes held by the edges of a tree node and its subnodes.
+    static size_t bytes(const Node& node)
+    {
+      size_t bytes = node.edges.size() * (sizeof(std::map<Char,Node>::value_type) + 4 * sizeof(void*));
+      for (std::map<Char,Node>::const_iterator i = node.edges.begin(); i != node.edges.end(); ++i)
+        bytes += Tree::bytes(i->second);
+      return bytes;
+    }
     Node *tree; ///< root of the tree or NULL
 #else
     struct Node {
@@ -791,6 +886,20 @@ class Pattern {
       }
       return &list.back()[next++];
     }
+    /// memory in bytes held by the tree.
+    size_t bytes() const
+    {
+      size_t bytes = list.size() * ALLOC * sizeof(Node);
+      for (List::const_iterator i = list.begin(); i != list.end(); ++i)
+      {
+        size_t n = *i == list.back() ? next : ALLOC;
+        for (size_t j = 0; j < n; ++j)
+          for (int k = 0; k < 16; ++k)
+            if ((*i)[j].edge[k] != NULL)
+              bytes += 16 * sizeof(Node*);
+      }
+      return bytes;
+    }
     Node    *tree; ///< root of the tree or NULL
     List     list; ///< block allocation list
     uint16_t next; ///< block allocation, next available slot in last block
@@ -955,6 +1064,9 @@ class Pattern {
     static const uint16_t ALLOC = 1024;           ///< allocate 1024 DFA states at a time, to improve performance
     static const uint16_t MAX_DEPTH = 256;        ///< analyze DFA up to states this deep to improve predict match
     static const Index MAX_STATES = Const::GMAX;  ///< maximum number of states
+    static const Index NFA_STATES = 16384;        ///< fall back to the bit-parallel NFA when the DFA grows to this many states
+    static const Index EST_STATES = 256;          ///< estimate the number of DFA states from the growth of the DFA levels after constructing this many states
+    static const size_t NFA_EST_STATES = 4 * NFA_STATES; ///< fall back to the bit-parallel NFA at once when the DFA is estimated to grow to this many states
     static const Index DEAD_PATH = 1;             ///< state marker "path always and only reaches backedges" (a dead end)
     static const Index KEEP_PATH = MAX_DEPTH;     ///< state marker "required path" (from a newline edge)
     static const Index LOOP_PATH = MAX_DEPTH + 1; ///< state marker "path reaches a backedge" (collect lookback chars)
@@ -974,6 +1086,23 @@ class Pattern {
       list.clear();
       next = ALLOC;
     }
+    /// memory in bytes held by the DFA states, their positions and edges.
+    size_t bytes() const
+    {
+      size_t bytes = list.size() * ALLOC * sizeof(State);
+      for (List::const_iterator i = list.begin(); i != list.end(); ++i)
+      {
+        size_t n = *i == list.back() ? next : ALLOC;
+        for (size_t j = 0; j < n; ++j)
+        {
+          const State& state = (*i)[j];
+          bytes += state.capacity() * sizeof(Position);
+          bytes += state.edges.size() * (sizeof(State::Edges::value_type) + 4 * sizeof(void*));
+          bytes += (state.heads.size() + state.tails.size()) * (sizeof(Lookahead) + 4 * sizeof(void*));
+        }
+      }
+      return bytes;
+    }
 #ifdef WITH_TREE_DFA
     /// new DFA state.
     State *state()
@@ -1058,15 +1187,165 @@ class Pattern {
     Hashes hashes[MAX_DEPTH];
     States states;
   };
+  /// Bit-parallel position automaton (Glushkov NFA) simulated with state sets of 64-bit words when the DFA grows too large.
+  struct NFA {
+    typedef uint64_t Word;
+    static const size_t MAX_POSITIONS =  4096; ///< max number of positions, a state set fits in MAX_POSITIONS/64 words
+    static const size_t MAX_TABLE     =   256; ///< max number of positions to tabulate the follow sets per byte of a state set
+    static const size_t MAX_EXPAND    = 65536; ///< max number of positions before collapsing repeats into counters
+    static const size_t MIN_REPEAT    =    64; ///< min number of repeats x{n,m} of a position x to collapse into a counter, fewer repeats are faster to match as positions
+    /// A counter position replaces the chain of positions of repeats x{n,m} of a position x, counting the repeats matched, counters are used by the NFA only and the DFA expands x{n,m} into m positions.
+    struct Counter {
+      size_t pos; ///< the counter position in a state set
+      size_t lo;  ///< min count to reach the follow set of the counter, n-1 or 0
+      size_t hi;  ///< max count, m-1
+      bool   inf; ///< unbounded repeats x{n,}
+      size_t off; ///< offset of the queue of the counter in Counts::que[]
+      /// the max number of distinct counts in the queue, an unbounded counter only needs its oldest count.
+      size_t capacity() const
+      {
+        return inf ? 1 : hi + 1;
+      }
+    };
+    /// The sets of counts of the counters when matching, per counter a queue of the steps when its counts started.
+    struct Counts {
+      Counts(const NFA& nfa);
+      size_t             *que;     ///< per counter its queue head and length followed by its ring buffer of steps, the count of step s is now - s
+      size_t              now;     ///< current step, the number of characters matched
+      size_t              buf[64]; ///< que[] of small counters
+      std::vector<size_t> mem;     ///< que[] of large counters
+     private:
+      Counts(const Counts&);
+      Counts& operator=(const Counts&);
+    };
+    NFA()
+      :
+        size(0),
+        words(0)
+    { }
+    /// delete the NFA.
+    void clear()
+    {
+      size = 0;
+      words = 0;
+      chr.clear();
+      fol.clear();
+      ini.clear();
+      acc.clear();
+      cnt.clear();
+    }
+    /// true if no NFA was constructed.
+    bool empty() const
+    {
+      return size == 0;
+    }
+    /// the index of the lowest 1 bit of a nonzero word.
+    static size_t lowest(Word w)
+    {
+#if defined(__GNUC__)
+      return __builtin_ctzll(w);
+#else
+      size_t k = 0;
+      while ((w & 1) == 0)
+      {
+        w >>= 1;
+        ++k;
+      }
+      return k;
+#endif
+    }
+    /// the lowest accept index of the accepting positions in a state set or 0, accepting positions are numbered first.
+    Accept accepting(const Word *set) const
+    {
+      size_t n = acc.size();
+      for (size_t i = 0; 64 * i < n; ++i)
+      {
+        Word w = set[i];
+        if (64 * (i + 1) > n)
+          w &= (1ULL << (n % 64)) - 1;
+        if (w != 0)
+          return acc[64 * i + lowest(w)];
+      }
+      return 0;
+    }
+    /// the next state set is the union of the follow sets of the positions in a state set that consume a char in chr, returns false if empty.
+    bool step(const Word *set, const Word *chr, Word *next) const
+    {
+      if (words == 1 && size <= MAX_TABLE)
+      {
+        // one word per state set, branchless with the zero follow sets of zero bytes
+        Word x = set[0] & chr[0];
+        Word y = 0;
+        for (const Word *f = &fol[0]; x != 0; f += 256, x >>= 8)
+          y |= f[x & 0xff];
+        next[0] = y;
+        return y != 0;
+      }
+      std::memset(next, 0, words * sizeof(Word));
+      for (size_t i = 0; i < words; ++i)
+      {
+        Word x = set[i] & chr[i];
+        if (size <= MAX_TABLE)
+        {
+          for (size_t j = 8 * i; x != 0; ++j, x >>= 8)
+          {
+            if ((x & 0xff) != 0)
+            {
+              const Word *f = &fol[(256 * j + (x & 0xff)) * words];
+              for (size_t k = 0; k < words; ++k)
+                next[k] |= f[k];
+            }
+          }
+        }
+        else
+        {
+          while (x != 0)
+          {
+            const Word *f = &fol[(64 * i + lowest(x)) * words];
+            for (size_t k = 0; k < words; ++k)
+              next[k] |= f[k];
+            x &= x - 1;
+          }
+        }
+      }
+      Word any = 0;
+      for (size_t k = 0; k < words; ++k)
+        any |= next[k];
+      return any != 0;
+    }
+    /// the next state set of a step with counters, a counter reaches its follow set when its highest count is at least lo, returns false if empty.
+    bool step(Counts& counts, const Word *set, const Word *chr, Word *next, Word *mask) const
+    {
+      if (cnt.empty())
+        return step(set, chr, next);
+      step(exits(counts, set, mask), chr, next);
+      return count(counts, set, chr, next);
+    }
+    /// the state set or its copy in mask without the counters that cannot reach their follow sets yet.
+    const Word *exits(const Counts& counts, const Word *set, Word *mask) const;
+    /// increment the counts of the counters that matched a char in chr and start new counts of the counters entered, returns false if next is empty.
+    bool count(Counts& counts, const Word *set, const Word *chr, Word *next) const;
+    size_t               size;  ///< number of positions, accepting positions first ordered by accept index
+    size_t               words; ///< number of words of a state set
+    std::vector<Word>    chr;   ///< 256 state sets of the positions that consume character c
+    std::vector<Word>    fol;   ///< follow sets of the positions, per byte of a state set (256 sets per byte) when size <= MAX_TABLE
+    std::vector<Word>    ini;   ///< start state set
+    std::vector<Accept>  acc;   ///< accept indexes of the accepting positions
+    std::vector<Counter> cnt;   ///< counter positions of repeats
+  };
+  /// Predictor tables allocated on demand, identical tables are shared among patterns by reference counting.
+  struct Tables;
   /// Global modifier modes, syntax flags, and compiler options.
   struct Option {
-    Option() : b(), h(), e(), f(), g(0), i(), m(), n(), o(), p(), q(), r(), s(), w(), x(), z() { }
+    Option() : b(), d(), h(), e(), f(), g(0), i(), l(), m(), n(), o(), p(), q(), r(), s(), v(), w(), x(), y(), z() { }
     bool                     b; ///< disable escapes in bracket lists
+    bool                     d; ///< always construct a DFA, never fall back to simulating the bit-parallel NFA of a pattern with a large DFA
     bool                     h; ///< construct indexing hash finite state automaton
     Char                     e; ///< escape character, or > 255 for none, a backslash by default
     std::vector<std::string> f; ///< output the patterns and/or DFA to files(s)
     int                      g; ///< debug level 0,1,2: output a cut DFA graphviz file with option f, predict match and HFA states
     bool                     i; ///< case insensitive mode, also `(?i:X)`
+    size_t                   l; ///< limit the DFA to an estimated number of states, simulate the NFA instead or throw regex_error::exceeds_limits, 0 for no limit
     bool                     m; ///< multi-line mode, also `(?m:X)`
     std::string              n; ///< pattern name (for use in generated code)
     bool                     o; ///< generate optimized FSM code with option f
@@ -1074,8 +1353,10 @@ class Pattern {
     bool                     q; ///< enable "X" quotation of verbatim content, also `(?q:X)`
     bool                     r; ///< raise syntax errors as exceptions
     bool                     s; ///< single-line mode (dotall mode), also `(?s:X)`
+    std::string              v; ///< with option f generate FSM code that counts state visits and appends the counts to file v on exit
     bool                     w; ///< write error message to stderr
     bool                     x; ///< free-spacing mode, also `(?x:X)`
+    std::string              y; ///< with option f generate hybrid FSM code with hot states as code and cold states as opcodes, using the visit counts in file y
     std::string              z; ///< namespace (NAME1.NAME2.NAME3)
   };
   /// Meta characters.
@@ -1107,6 +1388,14 @@ class Pattern {
       const char *options,
       const char *pred = NULL);
   void init_options(const char *options);
+  void init_pattern(const char *pred = NULL);
+  void copy_predictor(const Pattern& pattern);
+  void alloc_tables(bool tap, bool pma);
+  void trim_tables();
+  void share_tables();
+  void release_tables();
+  void rebuild(const std::string& regex);
+  Pattern *clone_dfa() const;
   void parse(
       Positions& startpos,
       Follow&    followpos,
@@ -1170,6 +1459,21 @@ class Pattern {
       const Lazypos& lazypos,
       const Mods  modifiers,
       const Map&  lookahead);
+  bool compile_nfa(
+      const DFA::State *start,
+      Follow&           followpos,
+      const Lazypos&    lazypos,
+      const Mods        modifiers,
+      const Map&        lookahead);
+  void analyze_nfa();
+  static void match_nfa(class Matcher& matcher);
+  void init_estimate(
+      const Positions& startpos,
+      const Follow&    followpos);
+  void update_estimate(
+      const std::vector<Index>& widths,
+      size_t                    states,
+      size_t                    sizes);
   void lazy(
       const Lazypos& lazypos,
       Positions&     pos) const;
@@ -1208,10 +1512,20 @@ class Pattern {
       int               nest,
       bool&             peek) const;
   void gencode_dfa_closure(
-      FILE             *fd,
-      const DFA::State *start,
-      int               nest,
-      bool              peek) const;
+      FILE                        *fd,
+      const DFA::State            *start,
+      int                          nest,
+      bool                         peek,
+      const std::map<Index,Index>& cold) const;
+  void gencode_dfa_goto(
+      FILE                        *fd,
+      Index                        index,
+      const std::map<Index,Index>& cold) const;
+  void gencode_dfa_hybrid(
+      const DFA::State            *start,
+      std::map<Index,Index>&       cold,
+      std::vector<Index>&          hot,
+      std::vector<Opcode>&         code) const;
   void graph_dfa(const DFA::State *start) const;
   void export_code() const;
   void analyze_dfa(DFA::State *start);
@@ -1445,6 +1759,9 @@ class Pattern {
   Tree                  tfa_; ///< tree DFA constructed from strings
 #endif
   DFA                   dfa_; ///< DFA constructed from regex with subset construction using firstpos/lastpos/followpos
+  NFA                   nfa_; ///< bit-parallel NFA simulated by FSM code match_nfa() when the DFA grows too large
+  Estimate              est_; ///< complexity estimate
+  size_t                dmu_; ///< memory in bytes held by the DFA and tree DFA when constructed, released after assembling the DFA
   std::string           rex_; ///< regular expression string
   std::vector<Location> end_; ///< entries point to the subpattern's ending '|' or '\0'
   std::vector<bool>     acc_; ///< true if subpattern n is accepting (state is reachable)
@@ -1462,13 +1779,14 @@ class Pattern {
   std::bitset<256>      fst_; ///< the beginning characters of the pattern
   char                  chr_[256]; ///< pattern prefix string or character needles for needle-based search
   Bitap                 bit_[256]; ///< bitsets of characters for the first positions (one position per bit)
-  Bitap                 tap_[Const::BTAP]; ///< bitap hashed character pairs array
+  Tables               *tbl_; ///< predictor tables allocated on demand and shared by reference counting, or NULL
+  Bitap                *tap_; ///< bitap hashed character pairs array of Const::BTAP entries in tbl_ when len_ == 0, or NULL
 #ifdef WITH_BITAP_AVX2 // in case vectorized bitap (hashed) is faster than serial version (typically not!)
 #if defined(HAVE_AVX512BW) || defined(HAVE_AVX2) || defined(HAVE_SSE2)
-  uint16_t              vtp_[Const::BTAP * 4]; ///< AVX2 vectorized bitap hashed character pairs array
+  uint16_t             *vtp_; ///< AVX2 vectorized bitap hashed character pairs array of Const::BTAP * 4 entries in tbl_ when len_ == 0, or NULL
 #endif
 #endif
-  Pred                  pma_[Const::HASH]; ///< predict-match array
+  Pred                 *pma_; ///< predict-match array of Const::HASH entries in tbl_ when len_ == 0 or min_ > 0, or NULL
   uint16_t              lbk_; ///< lookback distance or 0xffff unlimited lookback or 0 for no lookback (empty cbk_)
   uint16_t              lbm_; ///< loopback minimum distance when lbk_ > 0
   uint16_t              lcp_; ///< primary least common character position in the pattern or 0xffff
@@ -1482,7 +1800,98 @@ class Pattern {
   float                 ams_; ///< ms elapsed time to analyze DFA for predict match and HFA
   uint16_t              npy_; ///< entropy derived from the bitap array bit_[]
   bool                  one_; ///< true if matching one string stored in chr_[] without meta/anchors
+  bool                  icp_; ///< true if the prefix string chr_[] is case-insensitive, its ASCII letters are lower case and match both cases
   bool                  bol_; ///< true if matching all patterns at the begin of a line with anchor ^
+  bool                  lap_; ///< true if the pattern has lookaheads or when unknown for FSM code and opcode tables
+  bool                  idt_; ///< true if the pattern has indent anchors or when unknown for FSM code and opcode tables
+  bool                  mta_; ///< true if the pattern has anchors, word boundaries, or negative patterns, or when unknown for FSM code and opcode tables
+};
+
+/// A pattern shared by matchers in multiple threads that is updated by publishing a new pattern atomically.
+/**
+An update with add() or remove() compiles a new copy of the current pattern and
+then publishes it, the current pattern is never changed while matchers use it.
+A matcher switches to the latest pattern between matches with
+`reflex::Matcher::pattern(const SharedPattern&)`, which keeps the pattern alive
+until the matcher switches again or is deleted.
+
+Example:
+
+~~~{.cpp}
+    reflex::SharedPattern blocklist("foo|bar");
+    // updater thread
+    blocklist.add("evil\\.example\\.com");
+    blocklist.remove(2);
+    // matcher thread
+    reflex::Matcher matcher;
+    while (...)
+    {
+      matcher.pattern(blocklist).input(...);
+      while (matcher.find())
+        ...
+    }
+~~~
+*/
+class SharedPattern {
+ public:
+  /// Construct a shared pattern from a copy of the given pattern.
+  explicit SharedPattern(const Pattern& pattern)
+    :
+      ptr_(std::make_shared<const Pattern>(pattern))
+  { }
+  /// Construct a shared pattern from a regex string.
+  explicit SharedPattern(
+      const char *regex,         ///< regex string
+      const char *options = NULL) ///< options for the pattern
+    :
+      ptr_(std::make_shared<const Pattern>(regex, options))
+  { }
+  /// Get the latest pattern published.
+  std::shared_ptr<const Pattern> get() const
+    /// @returns shared pointer to the latest pattern
+  {
+    std::lock_guard<std::mutex> lock(ptr_mutex_);
+    return ptr_;
+  }
+  /// Add a regex as a new top-level alternative to a copy of the latest pattern and publish it, see Pattern::add().
+  Pattern::Accept add(const char *regex) ///< regex string to add as a new subpattern
+    /// @returns the subpattern index of the (first) subpattern added
+  {
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    std::shared_ptr<Pattern> pattern = std::make_shared<Pattern>(*get());
+    Pattern::Accept choice = pattern->add(regex);
+    publish(pattern);
+    return choice;
+  }
+  /// Add a regex as a new top-level alternative to a copy of the latest pattern and publish it, see Pattern::add().
+  Pattern::Accept add(const std::string& regex) ///< regex string to add as a new subpattern
+    /// @returns the subpattern index of the (first) subpattern added
+  {
+    return add(regex.c_str());
+  }
+  /// Remove a top-level alternative from a copy of the latest pattern and publish it, see Pattern::remove().
+  void remove(Pattern::Accept choice) ///< subpattern index of the subpattern to remove, 1 to size()
+  {
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    std::shared_ptr<Pattern> pattern = std::make_shared<Pattern>(*get());
+    pattern->remove(choice);
+    publish(pattern);
+  }
+ private:
+  /// Publish a new pattern, the previous pattern is released when no longer used.
+  void publish(const std::shared_ptr<const Pattern>& pattern)
+  {
+    std::shared_ptr<const Pattern> previous(pattern);
+    {
+      std::lock_guard<std::mutex> lock(ptr_mutex_);
+      ptr_.swap(previous);
+    }
+  }
+  SharedPattern(const SharedPattern&); // non-copyable
+  SharedPattern& operator=(const SharedPattern&); // non-copyable
+  mutable std::mutex             ptr_mutex_;    ///< guards ptr_
+  std::mutex                     update_mutex_; ///< serializes updates
+  std::shared_ptr<const Pattern> ptr_;          ///< latest pattern published
 };
 
 } // namespace reflex
@@ -149,6 +149,9 @@ extern size_t simd_nlcount_avx512bw(const char *& b, const char *e);
 // Partially check if valid UTF-8 encoding
 extern bool simd_isutf8_avx2(const char *& b, const char *e);
 
+// Partially skip bytes in the set of n (1 to 8) bytes, updates b to the first byte not in the set and returns true, or updates b close to e and returns false
+extern bool simd_skipbytes_avx2(const char *& b, const char *e, const char *set, size_t n);
+
 } // namespace reflex
 
 #elif defined(HAVE_NEON)
@@ -175,6 +178,9 @@ extern size_t nlcount(const char *s, const char *e);
 /// Check if valid UTF-8 encoding and does not include a NUL, but accept surrogates and 3/4 byte overlongs
 extern bool isutf8(const char *s, const char *e);
 
+/// Skip bytes in string s up to position e in the string that are in the 0-terminated set of bytes, vectorized for sets of up to 8 bytes
+extern const char *skipbytes(const char *s, const char *e, const char *set);
+
 } // namespace reflex
 
 #endif
@@ -0,0 +1,797 @@
+/******************************************************************************\
+* Copyright (c) 2016, Robert van Engelen, Genivia Inc. All rights reserved.    *
+*                                                                              *
+* Redistribution and use in source and binary forms, with or without           *
+* modification, are permitted provided that the following conditions are met:  *
+*                                                                              *
+*   (1) Redistributions of source code must retain the above copyright notice, *
+*       this list of conditions and the following disclaimer.                  *
+*                                                                              *
+*   (2) Redistributions in binary form must reproduce the above copyright      *
+*       notice, this list of conditions and the following disclaimer in the    *
+*       documentation and/or other materials provided with the distribution.   *
+*                                                                              *
+*   (3) The name of the author may not be used to endorse or promote products  *
+*       derived from this software without specific prior written permission.  *
+*                                                                              *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED *
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF         *
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO   *
+* EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,       *
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, *
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;  *
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,     *
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR      *
+* OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF       *
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                                   *
+\******************************************************************************/
+
+/**
+@file      staticpattern.h
+@brief     RE/flex regex patterns compiled at compile time to constexpr opcode tables
+@author    Robert van Engelen - engelen@genivia.com
+@copyright (c) 2016-2023, Robert van Engelen, Genivia Inc. All rights reserved.
+@copyright (c) BSD-3 License - see LICENSE.txt
+*/
+
+#ifndef REFLEX_STATICPATTERN_H
+#define REFLEX_STATICPATTERN_H
+
+#include <reflex/error.h>
+#include <reflex/pattern.h>
+#include <array>
+#include <cstddef>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+
+namespace reflex {
+
+/// Compile-time regex compiler to construct a DFA and its opcode table for reflex::Matcher with constexpr evaluation.
+/**
+The compiler accepts a subset of the regex syntax of reflex::Pattern without
+Unicode and without anchors and lookaheads:
+
+- characters, escapes `\a \e \f \n \r \t \v \0 \xHH \x{HH}` and escaped punctuation
+- `.` and bracket lists `[...]` with ranges, negation, escapes, and `[:name:]` classes
+- `\d \D \h \H \s \S \w \W` character classes
+- groups `(...)` and `(?:...)`, alternations `|`, and `*`, `+`, `?`, `{n}`, `{n,}`, `{n,m}`
+- the `(?i)` and `(?s)` modifiers at the start of the regex
+
+The alternations at the top level of the regex are numbered 1, 2, 3, ... as
+capture indices returned by the matcher, like reflex::Pattern.  Any other regex
+syntax or exceeding the limits throws reflex::regex_error, which is a compile
+error in constexpr context.
+*/
+class StaticRegex {
+ public:
+  typedef Pattern::Opcode Opcode;
+  /// Common constants.
+  struct Const {
+    static const size_t POSN = 256;    ///< max number of positions (characters and classes in the regex)
+    static const size_t STATES = 256;  ///< max number of DFA states
+    static const size_t EDGES = 4096;  ///< max number of DFA edges
+    static const size_t CODES = 8192;  ///< max number of opcodes
+    static const size_t PREFIX = 255;  ///< max length of the prefix string of the predictor
+  };
+  /// Compile a regex to a DFA and opcode table.
+  constexpr StaticRegex(const char *regex) ///< regex to compile
+    :
+      rex_(regex)
+  {
+    parse();
+    compile();
+    assemble();
+    predict();
+  }
+  /// Returns the number of opcodes.
+  constexpr size_t nop() const
+  {
+    return nop_;
+  }
+  /// Returns the number of DFA states.
+  constexpr size_t states() const
+  {
+    return nst_;
+  }
+  /// Returns the opcode table of size N = nop().
+  template<size_t N>
+  constexpr std::array<Opcode,N> code() const
+  {
+    std::array<Opcode,N> table = { };
+    for (size_t i = 0; i < N && i < nop_; ++i)
+      table[i] = opc_[i];
+    return table;
+  }
+  /// Returns the size of the predictor table string with its terminating \0, one when there is no predictor.
+  constexpr size_t npred() const
+  {
+    return len_ > 0 ? 4 + 2 * len_ + 1 : 1;
+  }
+  /// Returns the predictor table string of size N = npred().
+  template<size_t N>
+  constexpr std::array<char,N> pred() const
+  {
+    std::array<char,N> table = { };
+    if (len_ > 0 && N == 4 + 2 * len_ + 1)
+    {
+      hex(table.data(), len_);
+      hex(table.data() + 2, one_ ? 0x10 : 0x00);
+      for (size_t i = 0; i < len_; ++i)
+        hex(table.data() + 4 + 2 * i, pfx_[i]);
+    }
+    return table;
+  }
+ protected:
+  /// A set of 256 positions or 256 characters.
+  struct Set {
+    constexpr void insert(size_t i)
+    {
+      bit[i >> 6] |= static_cast<uint64_t>(1) << (i & 63);
+    }
+    constexpr void insert(size_t lo, size_t hi)
+    {
+      for (size_t i = lo; i <= hi; ++i)
+        insert(i);
+    }
+    constexpr void insert(const Set& set)
+    {
+      for (int i = 0; i < 4; ++i)
+        bit[i] |= set.bit[i];
+    }
+    constexpr void flip()
+    {
+      for (int i = 0; i < 4; ++i)
+        bit[i] = ~bit[i];
+    }
+    constexpr bool contains(size_t i) const
+    {
+      return (bit[i >> 6] & (static_cast<uint64_t>(1) << (i & 63))) != 0;
+    }
+    constexpr bool empty() const
+    {
+      return (bit[0] | bit[1] | bit[2] | bit[3]) == 0;
+    }
+    constexpr bool operator==(const Set& set) const
+    {
+      return bit[0] == set.bit[0] && bit[1] == set.bit[1] && bit[2] == set.bit[2] && bit[3] == set.bit[3];
+    }
+    uint64_t bit[4] = { 0, 0, 0, 0 };
+  };
+  /// A regex subexpression with the Glushkov first and last positions and nullability.
+  struct Node {
+    Set  first;           ///< positions that start the subexpression
+    Set  last;            ///< positions that end the subexpression
+    bool nullable = true; ///< true if the subexpression matches the empty string
+  };
+  /// A DFA edge on the characters lo to hi.
+  struct Edge {
+    uint8_t  lo = 0;     ///< first character
+    uint8_t  hi = 0;     ///< last character
+    uint16_t target = 0; ///< target state
+  };
+  /// Returns the current regex character or \0 at the end.
+  constexpr char at() const
+  {
+    return rex_[loc_];
+  }
+  /// Parse the regex alternations at the top level, each with an accepting position.
+  constexpr void parse()
+  {
+    while (at() == '(' && rex_[loc_ + 1] == '?' && (rex_[loc_ + 2] == 'i' || rex_[loc_ + 2] == 's'))
+    {
+      size_t k = loc_ + 2;
+      for (; rex_[k] == 'i' || rex_[k] == 's'; ++k)
+      {
+        if (rex_[k] == 'i')
+          icase_ = true;
+        else
+          dotall_ = true;
+      }
+      if (rex_[k] != ')')
+        throw regex_error(regex_error::invalid_modifier, rex_, k);
+      loc_ = k + 1;
+    }
+    uint32_t accept = 1;
+    while (true)
+    {
+      Node node = parse_seq();
+      size_t pos = position();
+      acc_[pos] = accept;
+      link(node.last, pos);
+      start_.insert(node.first);
+      if (node.nullable)
+        start_.insert(pos);
+      if (at() == '\0')
+        break;
+      if (at() != '|')
+        throw regex_error(regex_error::mismatched_parens, rex_, loc_);
+      ++loc_;
+      ++accept;
+    }
+  }
+  /// Parse alternations.
+  constexpr Node parse_alt()
+  {
+    Node node = parse_seq();
+    while (at() == '|')
+    {
+      ++loc_;
+      Node next = parse_seq();
+      node.first.insert(next.first);
+      node.last.insert(next.last);
+      node.nullable = node.nullable || next.nullable;
+    }
+    return node;
+  }
+  /// Parse a sequence of quantified atoms.
+  constexpr Node parse_seq()
+  {
+    Node node;
+    while (at() != '\0' && at() != '|' && at() != ')')
+      node = concat(node, parse_quant());
+    return node;
+  }
+  /// Parse an atom with quantifiers, repeats are expanded by parsing the atom again.
+  constexpr Node parse_quant()
+  {
+    size_t from = loc_;
+    Node node = parse_atom();
+    while (true)
+    {
+      char c = at();
+      if (c == '*' || c == '+')
+      {
+        link(node.last, node.first);
+        node.nullable = node.nullable || c == '*';
+        ++loc_;
+      }
+      else if (c == '?')
+      {
+        node.nullable = true;
+        ++loc_;
+      }
+      else if (c == '{')
+      {
+        size_t k = loc_;
+        size_t n = parse_num(k);
+        size_t m = n;
+        bool unbounded = false;
+        if (rex_[k] == ',')
+        {
+          if (rex_[k + 1] == '}')
+          {
+            unbounded = true;
+            ++k;
+          }
+          else
+          {
+            m = parse_num(k);
+          }
+        }
+        if (rex_[k] != '}')
+          throw regex_error(regex_error::mismatched_braces, rex_, k);
+        if (m < n)
+          throw regex_error(regex_error::invalid_repeat, rex_, k);
+        size_t to = k + 1;
+        if (!unbounded && m == 0)
+        {
+          node = Node();
+        }
+        else
+        {
+          size_t copies = unbounded ? (n > 0 ? n : 1) : m;
+          Node repeat;
+          for (size_t i = 1; i <= copies; ++i)
+          {
+            Node copy = node;
+            if (i > 1)
+            {
+              loc_ = from;
+              copy = parse_atom();
+            }
+            if (unbounded && i == copies)
+            {
+              link(copy.last, copy.first);
+              copy.nullable = copy.nullable || n == 0;
+            }
+            else if (i > n)
+            {
+              copy.nullable = true;
+            }
+            repeat = i == 1 ? copy : concat(repeat, copy);
+          }
+          node = repeat;
+        }
+        loc_ = to;
+      }
+      else
+      {
+        break;
+      }
+      if (at() == '?' || at() == '+')
+        throw regex_error(regex_error::invalid_quantifier, rex_, loc_);
+    }
+    return node;
+  }
+  /// Parse a decimal number of a repeat {n,m} after the { or the comma at k.
+  constexpr size_t parse_num(size_t& k) const
+  {
+    ++k;
+    if (rex_[k] < '0' || rex_[k] > '9')
+      throw regex_error(regex_error::invalid_repeat, rex_, k);
+    size_t n = 0;
+    while (rex_[k] >= '0' && rex_[k] <= '9')
+    {
+      n = 10 * n + (rex_[k++] - '0');
+      if (n > Const::POSN)
+        throw regex_error(regex_error::exceeds_limits, rex_, k);
+    }
+    return n;
+  }
+  /// Parse an atom.
+  constexpr Node parse_atom()
+  {
+    char c = at();
+    if (c == '(')
+    {
+      ++loc_;
+      if (at() == '?')
+      {
+        if (rex_[loc_ + 1] != ':')
+          throw regex_error(regex_error::invalid_modifier, rex_, loc_);
+        loc_ += 2;
+      }
+      Node node = parse_alt();
+      if (at() != ')')
+        throw regex_error(regex_error::mismatched_parens, rex_, loc_);
+      ++loc_;
+      return node;
+    }
+    Set chars;
+    if (c == '[')
+    {
+      parse_list(chars);
+    }
+    else if (c == '.')
+    {
+      chars.insert(0, 255);
+      if (!dotall_)
+        chars.bit[0] &= ~(static_cast<uint64_t>(1) << '\n');
+      ++loc_;
+    }
+    else if (c == '\\')
+    {
+      int ch = parse_esc(chars);
+      if (ch >= 0)
+        chars.insert(static_cast<uint8_t>(ch));
+    }
+    else if (c == '^' || c == '$')
+    {
+      throw regex_error(regex_error::invalid_anchor, rex_, loc_);
+    }
+    else if (c == '*' || c == '+' || c == '?' || c == '{')
+    {
+      throw regex_error(regex_error::invalid_syntax, rex_, loc_);
+    }
+    else
+    {
+      chars.insert(static_cast<uint8_t>(c));
+      ++loc_;
+    }
+    if (c != '[')
+      fold(chars);
+    size_t pos = position();
+    chr_[pos] = chars;
+    Node node;
+    node.first.insert(pos);
+    node.last.insert(pos);
+    node.nullable = false;
+    return node;
+  }
+  /// Parse a bracket list.
+  constexpr void parse_list(Set& chars)
+  {
+    size_t from = loc_++;
+    bool negate = false;
+    if (at() == '^')
+    {
+      negate = true;
+      ++loc_;
+    }
+    bool first = true;
+    while (at() != ']' || first)
+    {
+      first = false;
+      if (at() == '\0')
+        throw regex_error(regex_error::mismatched_brackets, rex_, from);
+      int lo = -1;
+      if (at() == '[' && rex_[loc_ + 1] == ':')
+      {
+        parse_name(chars);
+      }
+      else if (at() == '\\')
+      {
+        lo = parse_esc(chars);
+      }
+      else
+      {
+        lo = static_cast<uint8_t>(at());
+        ++loc_;
+      }
+      if (lo >= 0)
+      {
+        int hi = lo;
+        if (at() == '-' && rex_[loc_ + 1] != ']' && rex_[loc_ + 1] != '\0')
+        {
+          ++loc_;
+          if (at() == '\\')
+          {
+            Set none;
+            hi = parse_esc(none);
+            if (hi < 0)
+              throw regex_error(regex_error::invalid_class_range, rex_, loc_);
+          }
+          else
+          {
+            hi = static_cast<uint8_t>(at());
+            ++loc_;
+          }
+          if (hi < lo)
+            throw regex_error(regex_error::invalid_class_range, rex_, loc_);
+        }
+        chars.insert(static_cast<size_t>(lo), static_cast<size_t>(hi));
+      }
+    }
+    ++loc_;
+    // fold case before negating the list, so (?i)[^a] matches neither a nor A
+    fold(chars);
+    if (negate)
+      chars.flip();
+  }
+  /// Add the other case of the ASCII letters in the set when case-insensitive.
+  constexpr void fold(Set& chars) const
+  {
+    if (!icase_)
+      return;
+    for (size_t i = 'A'; i <= 'Z'; ++i)
+    {
+      if (chars.contains(i) || chars.contains(i + 32))
+      {
+        chars.insert(i);
+        chars.insert(i + 32);
+      }
+    }
+  }
+  /// Parse a [:name:] class in a bracket list.
+  constexpr void parse_name(Set& chars)
+  {
+    size_t k = loc_ + 2;
+    size_t n = 0;
+    while (rex_[k + n] >= 'a' && rex_[k + n] <= 'z')
+      ++n;
+    if (rex_[k + n] != ':' || rex_[k + n + 1] != ']')
+      throw regex_error(regex_error::invalid_class, rex_, loc_);
+    const char *names[] = { "alnum", "alpha", "blank", "cntrl", "digit", "graph", "lower", "print", "punct", "space", "upper", "word", "xdigit" };
+    int id = -1;
+    for (int i = 0; i < 13 && id < 0; ++i)
+    {
+      size_t j = 0;
+      while (j < n && names[i][j] == rex_[k + j])
+        ++j;
+      if (j == n && names[i][j] == '\0')
+        id = i;
+    }
+    switch (id)
+    {
+      case 0:  chars.insert('0', '9'); chars.insert('A', 'Z'); chars.insert('a', 'z'); break;
+      case 1:  chars.insert('A', 'Z'); chars.insert('a', 'z'); break;
+      case 2:  chars.insert('\t'); chars.insert(' '); break;
+      case 3:  chars.insert(0, 31); chars.insert(127); break;
+      case 4:  chars.insert('0', '9'); break;
+      case 5:  chars.insert(33, 126); break;
+      case 6:  chars.insert('a', 'z'); break;
+      case 7:  chars.insert(32, 126); break;
+      case 8:  chars.insert(33, 47); chars.insert(58, 64); chars.insert(91, 96); chars.insert(123, 126); break;
+      case 9:  chars.insert(9, 13); chars.insert(' '); break;
+      case 10: chars.insert('A', 'Z'); break;
+      case 11: chars.insert('0', '9'); chars.insert('A', 'Z'); chars.insert('a', 'z'); chars.insert('_'); break;
+      case 12: chars.insert('0', '9'); chars.insert('A', 'F'); chars.insert('a', 'f'); break;
+      default: throw regex_error(regex_error::invalid_class, rex_, loc_);
+    }
+    loc_ = k + n + 2;
+  }
+  /// Parse an escape, returns the character or -1 when a class was added to chars.
+  constexpr int parse_esc(Set& chars)
+  {
+    size_t from = loc_++;
+    char c = rex_[loc_++];
+    Set set;
+    switch (c)
+    {
+      case 'a': return '\a';
+      case 'e': return 0x1b;
+      case 'f': return '\f';
+      case 'n': return '\n';
+      case 'r': return '\r';
+      case 't': return '\t';
+      case 'v': return '\v';
+      case '0': return '\0';
+      case 'x':
+        {
+          bool brace = at() == '{';
+          if (brace)
+            ++loc_;
+          int ch = 0;
+          size_t n = 0;
+          for (; n < 2; ++n, ++loc_)
+          {
+            char h = at();
+            if (h >= '0' && h <= '9')
+              ch = 16 * ch + (h - '0');
+            else if (h >= 'A' && h <= 'F')
+              ch = 16 * ch + (h - 'A' + 10);
+            else if (h >= 'a' && h <= 'f')
+              ch = 16 * ch + (h - 'a' + 10);
+            else
+              break;
+          }
+          if (n == 0 || (brace && at() != '}'))
+            throw regex_error(regex_error::invalid_escape, rex_, from);
+          if (brace)
+            ++loc_;
+          return ch;
+        }
+      case 'd': case 'D':
+        set.insert('0', '9');
+        break;
+      case 'h': case 'H':
+        set.insert('\t');
+        set.insert(' ');
+        break;
+      case 's': case 'S':
+        set.insert(9, 13);
+        set.insert(' ');
+        break;
+      case 'w': case 'W':
+        set.insert('0', '9');
+        set.insert('A', 'Z');
+        set.insert('a', 'z');
+        set.insert('_');
+        break;
+      case 'A': case 'b': case 'B': case 'i': case 'j': case 'k': case 'z': case 'Z': case '<': case '>':
+        throw regex_error(regex_error::invalid_anchor, rex_, from);
+      default:
+        if (c == '\0' || (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c & 0x80) != 0)
+          throw regex_error(regex_error::invalid_escape, rex_, from);
+        return static_cast<uint8_t>(c);
+    }
+    if (c >= 'A' && c <= 'Z')
+      set.flip();
+    chars.insert(set);
+    return -1;
+  }
+  /// Returns the concatenation of two subexpressions.
+  constexpr Node concat(const Node& node, const Node& next)
+  {
+    Node cat;
+    link(node.last, next.first);
+    cat.first = node.first;
+    if (node.nullable)
+      cat.first.insert(next.first);
+    cat.last = next.last;
+    if (next.nullable)
+      cat.last.insert(node.last);
+    cat.nullable = node.nullable && next.nullable;
+    return cat;
+  }
+  /// Add the positions to the followpos sets of the last positions.
+  constexpr void link(const Set& last, const Set& positions)
+  {
+    for (size_t i = 0; i < npos_; ++i)
+      if (last.contains(i))
+        flw_[i].insert(positions);
+  }
+  /// Add a single position to the followpos sets of the last positions.
+  constexpr void link(const Set& last, size_t pos)
+  {
+    Set set;
+    set.insert(pos);
+    link(last, set);
+  }
+  /// Returns a new position.
+  constexpr size_t position()
+  {
+    if (npos_ >= Const::POSN)
+      throw regex_error(regex_error::exceeds_limits, rex_, loc_);
+    return npos_++;
+  }
+  /// Construct the DFA from the followpos NFA with subset construction.
+  constexpr void compile()
+  {
+    dfa_[0] = start_;
+    nst_ = 1;
+    for (size_t state = 0; state < nst_; ++state)
+    {
+      size_t pos[Const::POSN] = { };
+      size_t num = 0;
+      uint32_t accept = 0;
+      for (size_t i = 0; i < npos_; ++i)
+      {
+        if (dfa_[state].contains(i))
+        {
+          if (acc_[i] == 0)
+            pos[num++] = i;
+          else if (accept == 0 || acc_[i] < accept)
+            accept = acc_[i];
+        }
+      }
+      sac_[state] = accept;
+      sed_[state] = ned_;
+      Set prev;
+      size_t target = 0;
+      for (size_t c = 0; c < 256; ++c)
+      {
+        Set next;
+        for (size_t j = 0; j < num; ++j)
+          if (chr_[pos[j]].contains(c))
+            next.insert(flw_[pos[j]]);
+        if (next.empty())
+          continue;
+        if (c > 0 && ned_ > sed_[state] && edg_[ned_ - 1].hi == c - 1 && next == prev)
+        {
+          edg_[ned_ - 1].hi = static_cast<uint8_t>(c);
+          continue;
+        }
+        if (!(next == prev))
+        {
+          target = 0;
+          while (target < nst_ && !(dfa_[target] == next))
+            ++target;
+          if (target == nst_)
+          {
+            if (nst_ >= Const::STATES)
+              throw regex_error(regex_error::exceeds_limits, rex_, 0);
+            dfa_[nst_++] = next;
+          }
+          prev = next;
+        }
+        if (ned_ >= Const::EDGES)
+          throw regex_error(regex_error::exceeds_limits, rex_, 0);
+        edg_[ned_].lo = static_cast<uint8_t>(c);
+        edg_[ned_].hi = static_cast<uint8_t>(c);
+        edg_[ned_].target = static_cast<uint16_t>(target);
+        ++ned_;
+      }
+    }
+    sed_[nst_] = ned_;
+  }
+  /// Assemble the DFA into an opcode table with a TAKE for accepting states, GOTO edges and HALT per state.
+  constexpr void assemble()
+  {
+    size_t adr[Const::STATES] = { };
+    size_t pc = 0;
+    for (size_t state = 0; state < nst_; ++state)
+    {
+      adr[state] = pc;
+      pc += (sac_[state] > 0) + (sed_[state + 1] - sed_[state]) + 1;
+    }
+    if (pc > Const::CODES || pc >= Pattern::Const::LONG)
+      throw regex_error(regex_error::exceeds_limits, rex_, 0);
+    nop_ = 0;
+    for (size_t state = 0; state < nst_; ++state)
+    {
+      if (sac_[state] > 0)
+        opc_[nop_++] = 0xfe000000 | sac_[state]; // TAKE
+      for (size_t e = sed_[state]; e < sed_[state + 1]; ++e)
+        opc_[nop_++] = (static_cast<Opcode>(edg_[e].lo) << 24) | (static_cast<Opcode>(edg_[e].hi) << 16) | static_cast<Opcode>(adr[edg_[e].target]); // GOTO
+      opc_[nop_++] = 0x00ffffff; // HALT
+    }
+  }
+  /// Compute the predictor with the string prefix of all matches, if any.
+  constexpr void predict()
+  {
+    size_t state = 0;
+    len_ = 0;
+    while (len_ < Const::PREFIX && sac_[state] == 0 && sed_[state + 1] - sed_[state] == 1 && edg_[sed_[state]].lo == edg_[sed_[state]].hi)
+    {
+      pfx_[len_++] = edg_[sed_[state]].lo;
+      state = edg_[sed_[state]].target;
+    }
+    // one string when the prefix is the only match
+    one_ = len_ > 0 && sac_[state] == 1 && sed_[state + 1] == sed_[state];
+  }
+  /// Write a byte as two hex digits.
+  static constexpr void hex(char *s, size_t byte)
+  {
+    s[0] = "0123456789abcdef"[(byte >> 4) & 0xf];
+    s[1] = "0123456789abcdef"[byte & 0xf];
+  }
+  const char *rex_;                        ///< regex string
+  size_t      loc_ = 0;                    ///< current location in the regex
+  bool        icase_ = false;              ///< (?i) case insensitive
+  bool        dotall_ = false;             ///< (?s) dot matches newline
+  size_t      npos_ = 0;                   ///< number of positions
+  Set         chr_[Const::POSN] = { };     ///< characters matched at each position
+  Set         flw_[Const::POSN] = { };     ///< followpos of each position
+  uint32_t    acc_[Const::POSN] = { };     ///< accept index of accepting positions, zero otherwise
+  Set         start_;                      ///< start positions
+  Set         dfa_[Const::STATES] = { };   ///< DFA states as sets of positions
+  uint32_t    sac_[Const::STATES] = { };   ///< accept index of each DFA state
+  size_t      sed_[Const::STATES + 1] = { }; ///< first edge of each DFA state in edg_[]
+  size_t      nst_ = 0;                    ///< number of DFA states
+  Edge        edg_[Const::EDGES] = { };    ///< DFA edges
+  size_t      ned_ = 0;                    ///< number of DFA edges
+  Opcode      opc_[Const::CODES] = { };    ///< opcode table
+  size_t      nop_ = 0;                    ///< number of opcodes
+  uint8_t     pfx_[Const::PREFIX] = { };   ///< prefix string of the predictor
+  size_t      len_ = 0;                    ///< length of the prefix string
+  bool        one_ = false;                ///< true if the prefix string is the only match
+};
+
+/// Regex pattern compiled at compile time to a constexpr opcode table and predictor for the reflex::Matcher engine.
+/**
+The regex is specified by a type R with a static constexpr member `regex`:
+
+```
+struct Number { static constexpr const char *regex = "[0-9]+(\\.[0-9]+)?"; };
+reflex::Matcher matcher(reflex::StaticPattern<Number>::pattern(), input);
+```
+
+With C++20 the regex can be specified directly with reflex::static_pattern:
+
+```
+reflex::Matcher matcher(reflex::static_pattern<"[0-9]+(\\.[0-9]+)?">::pattern(), input);
+```
+
+The opcode table and predictor are constexpr arrays in read-only data, the
+pattern() is a reflex::Pattern constructed from these tables without compiling.
+See reflex::StaticRegex for the regex syntax supported.
+*/
+template<typename R>
+class StaticPattern {
+  static constexpr StaticRegex fsm_ = StaticRegex(R::regex); ///< compile-time only, not used at run time
+ public:
+  typedef Pattern::Opcode Opcode;
+  static constexpr size_t nop = fsm_.nop();                               ///< number of opcodes
+  static constexpr size_t npred = fsm_.npred();                           ///< size of the predictor string
+  static constexpr std::array<Opcode,nop> code = fsm_.template code<nop>(); ///< opcode table
+  static constexpr std::array<char,npred> pred = fsm_.template pred<npred>(); ///< predictor string
+  /// Returns the reflex::Pattern with the opcode table and predictor.
+  static const Pattern& pattern()
+    /// @returns reference to reflex::Pattern
+  {
+    static const Pattern pat(code.data(), npred > 1 ? pred.data() : NULL);
+    return pat;
+  }
+};
+
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+
+/// A regex string literal as a C++20 template argument of reflex::static_pattern.
+template<size_t N>
+struct StaticString {
+  constexpr StaticString(const char (&s)[N])
+  {
+    for (size_t i = 0; i < N; ++i)
+      regex[i] = s[i];
+  }
+  char regex[N] = { };
+};
+
+/// A regex string literal as a type R of reflex::StaticPattern<R>.
+template<StaticString S>
+struct StaticLiteral {
+  static constexpr const char *regex = S.regex;
+};
+
+/// Regex pattern compiled at compile time specified with a string literal, e.g. `reflex::static_pattern<"[0-9]+">::pattern()`.
+template<StaticString S>
+using static_pattern = StaticPattern<StaticLiteral<S> >;
+
+#endif
+
+} // namespace reflex
+
+#endif
+
+#endif
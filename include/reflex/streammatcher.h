@@ -0,0 +1,416 @@
+/******************************************************************************\
+* Copyright (c) 2016, Robert van Engelen, Genivia Inc. All rights reserved.    *
+*                                                                              *
+* Redistribution and use in source and binary forms, with or without           *
+* modification, are permitted provided that the following conditions are met:  *
+*                                                                              *
+*   (1) Redistributions of source code must retain the above copyright notice, *
+*       this list of conditions and the following disclaimer.                  *
+*                                                                              *
+*   (2) Redistributions in binary form must reproduce the above copyright      *
+*       notice, this list of conditions and the following disclaimer in the    *
+*       documentation and/or other materials provided with the distribution.   *
+*                                                                              *
+*   (3) The name of the author may not be used to endorse or promote products  *
+*       derived from this software without specific prior written permission.  *
+*                                                                              *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR IMPLIED *
+* WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF         *
+* MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO   *
+* EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,       *
+* SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, *
+* PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;  *
+* OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,     *
+* WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR      *
+* OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF       *
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                                   *
+\******************************************************************************/
+
+/**
+@file      streammatcher.h
+@brief     RE/flex push-mode streaming matcher that keeps its DFA state across input chunks
+@author    Robert van Engelen - engelen@genivia.com
+@copyright (c) 2016-2023, Robert van Engelen, Genivia Inc. All rights reserved.
+@copyright (c) BSD-3 License - see LICENSE.txt
+*/
+
+#ifndef REFLEX_STREAMMATCHER_H
+#define REFLEX_STREAMMATCHER_H
+
+#include <reflex/pattern.h>
+#include <reflex/absmatcher.h>
+#include <stdexcept>
+#include <vector>
+
+namespace reflex {
+
+/// RE/flex push-mode streaming matcher engine that reports the end of all matches of a pattern in chunks of input fed to the matcher.
+/**
+Input is pushed to the matcher in chunks of any size with feed(), which never
+blocks and does not retain chunks.  The matcher keeps the set of active DFA
+states of all partial matches between chunks and invokes handle() for each
+match found, possibly overlapping, with the accept index and the exclusive end
+position of the match in the stream.  A match is reported when the next byte is
+fed or when the end of the stream is signalled with finish(), because anchors
+and word boundaries at the end of a match depend on the next byte.
+
+The start of a match is reported when a history size in bytes is specified
+and the match is not longer than the history.  Otherwise the start of a match
+is reported as StreamMatcher::Const::NPOS.  No input is retained to find the
+start: each partial match in progress records the position of its leftmost
+start, which adds no cost per match.
+
+A pattern with a large DFA that is matched with the bit-parallel NFA has no
+opcode table, the matcher constructs and owns the DFA of the pattern instead.
+A pattern of FSM code generated by reflex has no opcode table to walk and
+throws std::invalid_argument.
+
+Empty matches are not reported.  Indent and dedent anchors never match and
+lookaheads are not supported, meaning that the lookahead is included in the
+match.  A `\r` before a `\n` is not recognized as the end of a line.
+
+Example:
+
+```
+struct Report : public reflex::StreamMatcher::Handler {
+  void operator()(reflex::StreamMatcher&, size_t accept, size_t first, size_t last)
+  {
+    std::cout << accept << " at " << first << ".." << last << std::endl;
+  }
+} report;
+reflex::Pattern pattern("\\bGET /\\S*");
+reflex::StreamMatcher matcher(pattern, &report, 256);
+while (receive(packet, size))
+  matcher.feed(packet, size);
+matcher.finish();
+```
+*/
+class StreamMatcher {
+ public:
+  /// Common constants.
+  struct Const {
+    static const size_t NPOS = static_cast<size_t>(-1); ///< start of match position when unknown
+  };
+  /// Event handler functor base class to invoke for each match found.
+  struct Handler {
+    virtual void operator()(StreamMatcher&, size_t, size_t, size_t) = 0;
+    virtual ~Handler() { };
+  };
+  /// Construct a streaming matcher engine from a persistent pattern, throws std::invalid_argument when the pattern has no opcode table or NFA.
+  StreamMatcher(
+      const Pattern& pattern,        ///< a reflex::Pattern
+      Handler       *handler = NULL, ///< event handler functor to invoke with (matcher, accept, first, last) for each match
+      size_t         history = 0)    ///< max length of a match in bytes to report its start, zero for none
+    :
+      pat_(opcodes(pattern)),
+      dfa_(pat_ != &pattern ? pat_ : NULL),
+      evh_(handler),
+      max_(history)
+  {
+    reset();
+  }
+  /// Delete streaming matcher.
+  virtual ~StreamMatcher()
+  {
+    DBGLOG("StreamMatcher::~StreamMatcher()");
+    if (dfa_ != NULL)
+      delete dfa_;
+  }
+  /// Reset this matcher to start matching a new stream.
+  void reset()
+  {
+    DBGLOG("StreamMatcher::reset()");
+    cur_.clear();
+    nxt_.clear();
+    acc_.clear();
+    fst_.clear();
+    num_ = 0;
+    cnt_ = 0;
+    got_ = Const::NPOS;
+  }
+  /// Feed a chunk of input to this matcher, invokes handle() for each match found.
+  void feed(
+      const char *data, ///< chunk of input
+      size_t      size) ///< size of the chunk of input in bytes
+  {
+    DBGLOG("StreamMatcher::feed(%zu)", size);
+    for (const char *end = data + size; data < end; ++data)
+      step(static_cast<unsigned char>(*data));
+  }
+  /// Signal the end of the stream to report the last matches, use reset() to match a new stream.
+  void finish()
+  {
+    DBGLOG("StreamMatcher::finish()");
+    step(EOF);
+    cur_.clear();
+  }
+  /// Returns the number of bytes fed to this matcher since the start of the stream.
+  size_t offset() const
+    /// @returns number of bytes
+  {
+    return num_;
+  }
+  /// Returns the number of matches reported since the start of the stream.
+  size_t matches() const
+    /// @returns number of matches
+  {
+    return cnt_;
+  }
+  /// Returns the number of partial matches in progress, i.e. the number of active DFA states.
+  size_t states() const
+    /// @returns number of states
+  {
+    return cur_.size();
+  }
+  /// Set event handler functor to invoke for each match found.
+  void set_handler(Handler *handler)
+  {
+    evh_ = handler;
+  }
+  /// Set the pattern to use with this matcher (the given pattern is shared and must be persistent), resets the matcher, throws std::invalid_argument when the pattern has no opcode table or NFA.
+  void pattern(const Pattern& pattern)
+  {
+    if (&pattern != dfa_)
+    {
+      const Pattern *pat = opcodes(pattern);
+      if (dfa_ != NULL)
+        delete dfa_;
+      pat_ = pat;
+      dfa_ = pat != &pattern ? pat : NULL;
+    }
+    reset();
+  }
+  /// Returns a reference to the pattern associated with this matcher.
+  const Pattern& pattern() const
+    /// @returns reference to pattern
+  {
+    return *pat_;
+  }
+ protected:
+  /// Returns the given pattern when it has an opcode table, or a new DFA constructed from a pattern matched with the bit-parallel NFA.
+  static const Pattern *opcodes(const Pattern& pattern)
+    /// @returns pointer to a pattern with an opcode table
+  {
+    if (pattern.opc_ != NULL)
+      return &pattern;
+    if (pattern.nfa_.empty())
+      throw std::invalid_argument("reflex::StreamMatcher requires a pattern with an opcode table");
+    return pattern.clone_dfa();
+  }
+  /// Context of the start of a partial match to check anchors and word boundaries at the begin of a match.
+  enum Context {
+    BOB = 1, ///< match starts at the begin of the stream
+    BOL = 2, ///< match starts at the begin of a line
+    WB  = 4, ///< match starts after a non-word character
+    BW  = 8  ///< match starts with a word character
+  };
+  /// A DFA state of a partial match in progress.
+  struct State {
+    State(Pattern::Index index, int context, bool empty, size_t first) : index(index), context(context), empty(empty), first(first) { }
+    Pattern::Index index;   ///< index of the DFA state in the opcode table
+    int            context; ///< context of the start of the partial match
+    bool           empty;   ///< true if the partial match is empty
+    size_t         first;   ///< position in the stream of the leftmost start of the partial match
+  };
+  /// Invoked for each match found with the accept index and the match position [first,last) in the stream, first is Const::NPOS when unknown.
+  virtual void handle(
+      size_t accept, ///< accept index of the match
+      size_t first,  ///< position of the start of the match in the stream or Const::NPOS
+      size_t last)   ///< position of the exclusive end of the match in the stream
+  {
+    if (evh_ != NULL)
+      (*evh_)(*this, accept, first, last);
+  }
+  /// Add a DFA state to the set of states when not already in the set, partial matches in the same state and context match the same from here on, so the leftmost start is kept.
+  void add(
+      std::vector<State>& set,     ///< set of states
+      Pattern::Index      index,   ///< index of the DFA state
+      int                 context, ///< context of the start of the partial match
+      bool                empty,   ///< true if the partial match is empty
+      size_t              first)   ///< position in the stream of the start of the partial match
+  {
+    for (std::vector<State>::iterator i = set.begin(); i != set.end(); ++i)
+    {
+      if (i->index == index && i->context == context)
+      {
+        i->empty = i->empty && empty;
+        if (first < i->first)
+          i->first = first;
+        return;
+      }
+    }
+    set.push_back(State(index, context, empty, first));
+  }
+  /// Returns the context of the start of a match after the previous character got and before the next character c.
+  static int context(
+      size_t got, ///< previous character or Const::NPOS at the begin of the stream
+      int    c)   ///< next character or EOF
+    /// @returns context bits
+  {
+    int ctx = 0;
+    if (got == Const::NPOS)
+      ctx = BOB | BOL | WB;
+    else if (got == '\n')
+      ctx = BOL | WB;
+    else if (!isword(static_cast<int>(got)))
+      ctx = WB;
+    if (c != EOF && isword(c))
+      ctx |= BW;
+    return ctx;
+  }
+  /// Returns true if the meta anchor or boundary holds for a match that started in the given context and ends between the previous character got and the next character c.
+  static bool meta(
+      Pattern::Char meta, ///< meta char
+      int           ctx,  ///< context of the start of the match
+      size_t        got,  ///< previous character or Const::NPOS at the begin of the stream
+      int           c)    ///< next character or EOF
+    /// @returns true if the meta anchor or boundary holds
+  {
+    bool ew = got != Const::NPOS && isword(static_cast<int>(got)) != 0; // match ends with a word character
+    bool we = c == EOF || isword(c) == 0;                               // match ends before a non-word character
+    switch (meta)
+    {
+      case Pattern::META_WBB:
+        return ((ctx & BW) != 0) == ((ctx & WB) != 0);
+      case Pattern::META_NWB:
+        return ((ctx & BW) != 0) != ((ctx & WB) != 0);
+      case Pattern::META_BWB:
+        return (ctx & BW) != 0 && (ctx & WB) != 0;
+      case Pattern::META_EWB:
+        return (ctx & BW) == 0 && (ctx & WB) == 0;
+      case Pattern::META_WBE:
+        return we == ew;
+      case Pattern::META_NWE:
+        return we != ew;
+      case Pattern::META_BWE:
+        return !we && !ew;
+      case Pattern::META_EWE:
+        return we && ew;
+      case Pattern::META_BOL:
+        return (ctx & BOL) != 0;
+      case Pattern::META_EOL:
+        return c == EOF || c == '\n';
+      case Pattern::META_BOB:
+        return (ctx & BOB) != 0;
+      case Pattern::META_EOB:
+        return c == EOF;
+    }
+    return false; // indent and dedent anchors never match
+  }
+  /// Take the meta edges of the states in the set that hold between the previous character got and the next character c, and collect the accept indexes and leftmost starts of non-empty matches.
+  void closure(
+      std::vector<State>&  set, ///< set of states to extend
+      std::vector<size_t>& acc, ///< sorted accept indexes of the matches found
+      std::vector<size_t>& fst, ///< positions in the stream of the leftmost starts of the matches found, in the order of acc
+      size_t               got, ///< previous character or Const::NPOS at the begin of the stream
+      int                  c)   ///< next character or EOF
+  {
+    acc.clear();
+    fst.clear();
+    for (size_t i = 0; i < set.size(); ++i)
+    {
+      const Pattern::Opcode *pc = pat_->opc_ + set[i].index;
+      int ctx = set[i].context;
+      bool empty = set[i].empty;
+      size_t first = set[i].first;
+      size_t take = 0;
+      bool redo = false;
+      Pattern::Opcode opcode = *pc;
+      while (!Pattern::is_opcode_goto(opcode))
+      {
+        if (Pattern::is_opcode_long(opcode) || Pattern::is_opcode_head(opcode) || Pattern::is_opcode_tail(opcode))
+        {
+          // skip LONG, HEAD, and TAIL
+        }
+        else if (Pattern::is_opcode_take(opcode))
+        {
+          take = Pattern::long_index_of(opcode);
+        }
+        else if (Pattern::is_opcode_redo(opcode))
+        {
+          redo = true;
+        }
+        else
+        {
+          Pattern::Index jump = Pattern::index_of(opcode);
+          if (jump == Pattern::Const::LONG)
+            jump = Pattern::long_index_of(*++pc);
+          if (meta(Pattern::meta_of(opcode), ctx, got, c))
+            add(set, jump, ctx, empty, first);
+        }
+        opcode = *++pc;
+      }
+      if (take > 0 && !redo && !empty)
+      {
+        size_t j = 0;
+        while (j < acc.size() && acc[j] < take)
+          ++j;
+        if (j == acc.size() || acc[j] != take)
+        {
+          acc.insert(acc.begin() + j, take);
+          fst.insert(fst.begin() + j, first);
+        }
+        else if (first < fst[j])
+        {
+          fst[j] = first;
+        }
+      }
+    }
+  }
+  /// Advance the states in the set on character c to the next set of states.
+  void advance(
+      const std::vector<State>& set,  ///< set of states
+      std::vector<State>&       next, ///< next set of states
+      int                       c)    ///< next character
+  {
+    next.clear();
+    for (std::vector<State>::const_iterator i = set.begin(); i != set.end(); ++i)
+    {
+      const Pattern::Opcode *pc = pat_->opc_ + i->index;
+      while (!Pattern::is_opcode_goto(*pc, static_cast<unsigned char>(c)))
+        ++pc;
+      Pattern::Index jump = Pattern::index_of(*pc);
+      if (jump == Pattern::Const::HALT)
+        continue;
+      if (jump == Pattern::Const::LONG)
+        jump = Pattern::long_index_of(pc[1]);
+      add(next, jump, i->context, false, i->first);
+    }
+  }
+  /// Advance all DFA states on the next character c or EOF, reports matches that end before c.
+  void step(int c) ///< next character or EOF
+  {
+    // start a new match at the current position
+    add(cur_, 0, context(got_, c), true, num_);
+    closure(cur_, acc_, fst_, got_, c);
+    for (size_t j = 0; j < acc_.size(); ++j)
+    {
+      ++cnt_;
+      handle(acc_[j], num_ - fst_[j] <= max_ ? fst_[j] : Const::NPOS, num_);
+    }
+    if (c == EOF)
+      return;
+    advance(cur_, nxt_, c);
+    cur_.swap(nxt_);
+    got_ = static_cast<size_t>(c);
+    ++num_;
+  }
+  const Pattern      *pat_; ///< points to the pattern
+  const Pattern      *dfa_; ///< the DFA constructed and owned by this matcher when the pattern is matched with the bit-parallel NFA, or NULL
+  Handler            *evh_; ///< event handler functor to invoke for each match found
+  size_t              max_; ///< max length of a match in bytes to report its start
+  std::vector<State>  cur_; ///< DFA states of the partial matches in progress
+  std::vector<State>  nxt_; ///< DFA states after advancing on the next character
+  std::vector<size_t> acc_; ///< accept indexes of the matches found at the current position
+  std::vector<size_t> fst_; ///< positions in the stream of the leftmost starts of the matches found at the current position
+  size_t              num_; ///< number of bytes fed to this matcher
+  size_t              cnt_; ///< number of matches reported
+  size_t              got_; ///< previous character or Const::NPOS at the begin of the stream
+ private:
+  StreamMatcher(const StreamMatcher&);
+  StreamMatcher& operator=(const StreamMatcher&);
+};
+
+} // namespace reflex
+
+#endif
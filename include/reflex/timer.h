@@ -28,7 +28,7 @@
 
 /**
 @file      timer.h
-@brief     Measure elapsed wall-clock time in milliseconds
+@brief     Measure elapsed wall-clock time in milliseconds and short intervals in cycles
 @author    Robert van Engelen - engelen@genivia.com
 @copyright (c) 2016-2020, Robert van Engelen, Genivia Inc. All rights reserved.
 @copyright (c) BSD-3 License - see LICENSE.txt
@@ -43,6 +43,14 @@
 #define NOMINMAX
 
 #include <windows.h>
+#include <cstdint>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
 
 namespace reflex {
 
@@ -69,12 +77,29 @@ inline float timer_elapsed(timer_type& t) ///< timer to be updated
   return ms;
 }
 
+/// Return the value of a fine-grained counter to time short intervals with low overhead, counts time-stamp counter cycles on x86 or performance counter ticks
+inline uint64_t timer_cycles()
+{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  LARGE_INTEGER t;
+  QueryPerformanceCounter(&t);
+  return t.QuadPart;
+#endif
+}
+
 } // namespace reflex
 
 #else
 
 #include <cstddef>
+#include <cstdint>
 #include <sys/time.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 namespace reflex {
 
@@ -101,6 +126,22 @@ inline float timer_elapsed(timer_type& t) ///< timer to be updated
   return ms;
 }
 
+/// Return the value of a fine-grained counter to time short intervals with low overhead, counts time-stamp counter cycles on x86, virtual counter ticks on ARM64, or nanoseconds
+inline uint64_t timer_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t t;
+  __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (t));
+  return t;
+#else
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return static_cast<uint64_t>(t.tv_sec) * 1000000000 + t.tv_nsec;
+#endif
+}
+
 } // namespace reflex
 
 #endif
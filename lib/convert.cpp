@@ -42,6 +42,9 @@
 #include <cctype>
 #include <cstdlib>
 #include <cstring>
+#include <map>
+#include <mutex>
+#include <vector>
 
 namespace reflex {
 
@@ -108,78 +111,213 @@ static std::string posix_class(const char *s, int esc, convert_flag_type flags)
   return regex;
 }
 
-static std::string unicode_class(const char *s, int esc, convert_flag_type flags, const char *par)
+/// UTF-8 byte range trie edges of a node, each edge a byte range [lo,hi] to a child node or to zero for the last byte.
+struct UTF8Edge {
+  UTF8Edge(int lo, int hi, size_t node) : lo(lo), hi(hi), node(node) { }
+  int    lo;
+  int    hi;
+  size_t node;
+};
+
+typedef std::vector<UTF8Edge> UTF8Edges;
+
+/// Insert the UTF-8 byte range sequences of the Unicode range [a,b] into the trie, increasing a and b are inserted in order.
+static void convert_utf8_trie(std::vector<UTF8Edges>& trie, int a, int b)
 {
-  std::string regex;
-  const int *wc = Unicode::range(s + (s[0] == '^'));
-  if (wc != NULL)
+  static const int max[3] = { 0x7F, 0x7FF, 0xFFFF };
+  // split [a,b] into ranges with the same UTF-8 length
+  for (int i = 0; i < 3; ++i)
   {
-    if (s[0] == '^') // inverted class \P{C} or \p{^C}
+    if (a <= max[i] && b > max[i])
     {
-      if (wc[0] > 0x00)
-      {
-        if (wc[0] > 0xDFFF)
-        {
-          // exclude surrogates U+D800 to U+DFFF
-          regex.assign(utf8(0x00, 0xD7FF, esc, par, !(flags & convert_flag::permissive))).push_back('|');
-          if (wc[0] > 0xE000)
-            regex.append(utf8(0xE000, wc[0] - 1, esc, par, !(flags & convert_flag::permissive))).push_back('|');
-        }
-        else
-        {
-          regex.assign(utf8(0x00, wc[0] - 1, esc, par, !(flags & convert_flag::permissive))).push_back('|');
-        }
-      }
-      int last = wc[1] + 1;
-      wc += 2;
-      for (; wc[1] != 0; wc += 2)
+      convert_utf8_trie(trie, a, max[i]);
+      convert_utf8_trie(trie, max[i] + 1, b);
+      return;
+    }
+  }
+  char at[8];
+  char bt[8];
+  size_t n = utf8(a, at);
+  utf8(b, bt);
+  // split [a,b] until each byte of the UTF-8 sequences ranges independently
+  for (size_t i = 1; i < n; ++i)
+  {
+    int m = (1 << (6 * i)) - 1;
+    if ((a & ~m) != (b & ~m))
+    {
+      if ((a & m) != 0)
       {
-        if (last <= 0xD800 && wc[0] > 0xDFFF)
-        {
-          // exclude surrogates U+D800 to U+DFFF
-          if (last < 0xD800)
-            regex.append(utf8(last, 0xD7FF, esc, par, !(flags & convert_flag::permissive))).push_back('|');
-          if (wc[0] > 0xE000)
-            regex.append(utf8(0xE000, wc[0] - 1, esc, par, !(flags & convert_flag::permissive))).push_back('|');
-        }
-        else
-        {
-          regex.append(utf8(last, wc[0] - 1, esc, par, !(flags & convert_flag::permissive))).push_back('|');
-        }
-        last = wc[1] + 1;
+        convert_utf8_trie(trie, a, a | m);
+        convert_utf8_trie(trie, (a | m) + 1, b);
+        return;
       }
-      if (last <= 0x10FFFF)
+      if ((b & m) != m)
       {
-        if (last <= 0xD800)
-        {
-          // exclude surrogates U+D800 to U+DFFF
-          if (last < 0xD800)
-            regex.append(utf8(last, 0xD7FF, esc, par, !(flags & convert_flag::permissive))).push_back('|');
-          regex.append(utf8(0xE000, 0x10FFFF, esc, par, !(flags & convert_flag::permissive))).push_back('|');
-        }
-        else
-        {
-          regex.append(utf8(last, 0x10FFFF, esc, par, !(flags & convert_flag::permissive))).push_back('|');
-        }
+        convert_utf8_trie(trie, a, (b & ~m) - 1);
+        convert_utf8_trie(trie, b & ~m, b);
+        return;
       }
     }
+  }
+  // add the byte ranges, sharing the prefix with the last sequence inserted
+  size_t node = 0;
+  for (size_t i = 0; i < n; ++i)
+  {
+    int lo = static_cast<unsigned char>(at[i]);
+    int hi = static_cast<unsigned char>(bt[i]);
+    if (i + 1 == n)
+    {
+      trie[node].push_back(UTF8Edge(lo, hi, 0));
+    }
+    else if (!trie[node].empty() && trie[node].back().lo == lo && trie[node].back().hi == hi && trie[node].back().node != 0)
+    {
+      node = trie[node].back().node;
+    }
     else
     {
-      if (wc[0] <= '\n' && wc[1] >= '\n' && (flags & convert_flag::notnewline))
-      {
-        if (wc[0] != '\n')
-          regex.append(utf8(wc[0], '\n' - 1, esc, par, !(flags & convert_flag::permissive))).push_back('|');
-        if (wc[1] != '\n')
-          regex.append(utf8('\n' + 1, wc[1], esc, par, !(flags & convert_flag::permissive))).push_back('|');
-        wc += 2;
-      }
-      for (; wc[1] != 0; wc += 2)
-        regex.append(utf8(wc[0], wc[1], esc, par, !(flags & convert_flag::permissive))).push_back('|');
+      size_t next = trie.size();
+      trie.push_back(UTF8Edges());
+      trie[node].push_back(UTF8Edge(lo, hi, next));
+      node = next;
     }
-    if (!regex.empty())
-      regex.resize(regex.size() - 1);
+  }
+}
+
+/// Convert a UTF-8 trie node to a regex, the edges to the same suffix regex are merged into one bracket list.
+static std::string convert_utf8_trie_regex(const std::vector<UTF8Edges>& trie, size_t node, int esc, const char *par)
+{
+  std::vector<std::string> suffixes;
+  std::vector<ORanges<int> > bytes;
+  for (UTF8Edges::const_iterator i = trie[node].begin(); i != trie[node].end(); ++i)
+  {
+    std::string suffix;
+    if (i->node != 0)
+      suffix = convert_utf8_trie_regex(trie, i->node, esc, par);
+    size_t k = 0;
+    while (k < suffixes.size() && suffixes[k] != suffix)
+      ++k;
+    if (k == suffixes.size())
+    {
+      suffixes.push_back(suffix);
+      bytes.push_back(ORanges<int>());
+    }
+    bytes[k].insert(i->lo, i->hi);
+  }
+  std::string regex;
+  for (size_t k = 0; k < suffixes.size(); ++k)
+  {
+    if (k > 0)
+      regex.push_back('|');
+    if (bytes[k].size() == 1)
+    {
+      regex.append(latin1(bytes[k].begin()->first, bytes[k].begin()->second - 1, esc));
+    }
+    else
+    {
+      regex.push_back('[');
+      for (ORanges<int>::const_iterator i = bytes[k].begin(); i != bytes[k].end(); ++i)
+        regex.append(latin1(i->first, i->second - 1, esc, false));
+      regex.push_back(']');
+    }
+    regex.append(suffixes[k]);
+  }
+  if (node != 0 && suffixes.size() > 1)
+    regex.insert(0, par).push_back(')');
+  return regex;
+}
+
+/// Cache of UTF-8 regex conversions of Unicode classes, e.g. \p{L} is typically used in several patterns.
+class UTF8Cache {
+ public:
+  /// Lookup the regex cached under the given key, returns true when found.
+  static bool find(const std::string& key, std::string& regex)
+  {
+    std::lock_guard<std::mutex> lock(mutex());
+    std::map<std::string,std::string>::const_iterator i = cache().find(key);
+    if (i == cache().end())
+      return false;
+    regex = i->second;
+    return true;
+  }
+  /// Save the regex under the given key, the cache is cleared when full.
+  static void save(const std::string& key, const std::string& regex)
+  {
+    std::lock_guard<std::mutex> lock(mutex());
+    if (cache().size() >= 256)
+      cache().clear();
+    cache()[key] = regex;
+  }
+  /// Return a key for the conversion settings.
+  static std::string key(int esc, convert_flag_type flags, const char *par)
+  {
+    std::string key(par);
+    key.push_back(static_cast<char>(esc));
+    key.push_back((flags & convert_flag::permissive) ? 'p' : 's');
+    key.push_back((flags & convert_flag::notnewline) ? 'n' : 'a');
+    return key;
+  }
+ private:
+  static std::map<std::string,std::string>& cache()
+  {
+    static std::map<std::string,std::string> cache;
+    return cache;
+  }
+  static std::mutex& mutex()
+  {
+    static std::mutex mutex;
+    return mutex;
+  }
+};
+
+/// Convert Unicode ranges to a UTF-8 regex without enclosing parenthesis.
+static std::string convert_utf8_ranges(const ORanges<int>& ranges, int esc, convert_flag_type flags, const char *par)
+{
+  std::string regex;
+  if (flags & convert_flag::permissive)
+  {
+    for (ORanges<int>::const_iterator i = ranges.begin(); i != ranges.end(); ++i)
+      regex.append(utf8(i->first, i->second - 1, esc, par, false)).push_back('|');
+    regex.resize(regex.size() - 1);
+  }
+  else
+  {
+    // construct a trie of UTF-8 byte ranges with shared prefixes, then merge shared suffixes to produce a compact regex
+    std::vector<UTF8Edges> trie(1);
+    for (ORanges<int>::const_iterator i = ranges.begin(); i != ranges.end(); ++i)
+      convert_utf8_trie(trie, i->first, i->second - 1);
+    regex = convert_utf8_trie_regex(trie, 0, esc, par);
+  }
+  return regex;
+}
+
+static std::string unicode_class(const char *s, int esc, convert_flag_type flags, const char *par)
+{
+  std::string regex;
+  std::string key = UTF8Cache::key(esc, flags, par).append(s);
+  if (UTF8Cache::find(key, regex))
+    return regex;
+  const int *wc = Unicode::range(s + (s[0] == '^'));
+  if (wc != NULL)
+  {
+    ORanges<int> ranges;
+    for (; wc[1] != 0; wc += 2)
+      ranges.insert(wc[0], wc[1]);
+    if (s[0] == '^') // inverted class \P{C} or \p{^C}
+    {
+      ORanges<int> inverse(0x00, 0x10FFFF);
+      inverse -= ranges;
+      // exclude surrogates U+D800 to U+DFFF
+      inverse.erase(0xD800, 0xDFFF);
+      ranges.swap(inverse);
+    }
+    else if (flags & convert_flag::notnewline)
+    {
+      ranges.erase('\n');
+    }
+    regex = convert_utf8_ranges(ranges, esc, flags, par);
     if (regex.find('|') != std::string::npos)
       regex.insert(0, par).push_back(')');
+    UTF8Cache::save(key, regex);
   }
   return regex;
 }
@@ -354,14 +492,20 @@ static const std::string& expand(const std::map<std::string,std::string> *macros
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
+
 static std::string convert_unicode_ranges(const ORanges<int>& ranges, convert_flag_type flags, const char *signature, const char *par)
 {
-  std::string regex;
   int esc = hex_or_octal_escape(signature);
+  std::string key = UTF8Cache::key(esc, flags, par).append(1, '[');
   for (ORanges<int>::const_iterator i = ranges.begin(); i != ranges.end(); ++i)
-    regex.append(utf8(i->first, i->second - 1, esc, par, !(flags & convert_flag::permissive))).push_back('|');
-  regex.resize(regex.size() - 1);
-  regex.insert(0, par).push_back(')');
+    key.append(reinterpret_cast<const char*>(&i->first), sizeof(int)).append(reinterpret_cast<const char*>(&i->second), sizeof(int));
+  std::string regex;
+  if (!UTF8Cache::find(key, regex))
+  {
+    regex = convert_utf8_ranges(ranges, esc, flags, par);
+    regex.insert(0, par).push_back(')');
+    UTF8Cache::save(key, regex);
+  }
   return regex;
 }
 
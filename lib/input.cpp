@@ -51,8 +51,10 @@
 # define off_t __int64
 # define ftello _ftelli64
 # define fseeko _fseeki64
+# define lseek _lseeki64
 #else
-# include <unistd.h> // off_t, fstat()
+# include <unistd.h> // off_t, fstat(), read(), lseek()
+# include <fcntl.h>  // posix_fadvise()
 # include <sys/select.h>
 #endif
 
@@ -657,10 +659,10 @@ void Input::file_init()
 #if !defined(HAVE_CONFIG_H) || defined(HAVE_FSTAT)
 #if REFLEX_WINDOWS_FILE_IO
   struct _stat st;
-  if (_fstat(_fileno(file_), &st) == 0 && ((st.st_mode & S_IFMT) == S_IFREG) && st.st_size <= 4294967295LL)
+  if (_fstat(file_ != NULL ? _fileno(file_) : fd_, &st) == 0 && ((st.st_mode & S_IFMT) == S_IFREG) && st.st_size <= 4294967295LL)
 #else
   struct stat st;
-  if (::fstat(::fileno(file_), &st) == 0 && S_ISREG(st.st_mode) && st.st_size <= 4294967295LL)
+  if (::fstat(file_ != NULL ? ::fileno(file_) : fd_, &st) == 0 && S_ISREG(st.st_mode) && st.st_size <= 4294967295LL)
 #endif
     size_ = static_cast<size_t>(st.st_size);
 #endif
@@ -751,6 +753,91 @@ void Input::file_init()
   }
 }
 
+size_t Input::file_fread(void *s, size_t size, size_t n)
+{
+  if (file_ != NULL)
+    return ::fread(s, size, n, file_);
+  if (fd_ < 0 || size == 0)
+    return 0;
+  char *t = static_cast<char*>(s);
+  size_t len = size * n;
+  size_t k = 0;
+  // take the bytes left in the block read buffer first
+  if (fdpos_ < fdlen_)
+  {
+    k = static_cast<size_t>(fdlen_ - fdpos_) < len ? static_cast<size_t>(fdlen_ - fdpos_) : len;
+    std::memcpy(t, fdbuf_ + fdpos_, k);
+    fdpos_ += static_cast<unsigned short>(k);
+    if (k == len || (k % size == 0 && fdpos_ == fdlen_))
+      return k / size;
+  }
+  if (fdeof_)
+    return k / size;
+  // read large requests directly into the given buffer and small requests, such as the items decoded by file_get() and file_size(), in blocks into fdbuf_[], continue until a whole number of items is read
+  size_t got = 0;
+  while (k < len)
+  {
+    bool block = len - k < FDBUF;
+    if (block && fdbuf_ == NULL)
+      fdbuf_ = new char[FDBUF];
+    char *b = block ? fdbuf_ : t + k;
+    size_t m = block ? FDBUF : len - k;
+#if REFLEX_WINDOWS_FILE_IO
+    int r = ::_read(fd_, b, static_cast<unsigned int>(m < 0x40000000 ? m : 0x40000000));
+#else
+    ssize_t r = ::read(fd_, b, m);
+#endif
+    if (r > 0)
+    {
+      got += static_cast<size_t>(r);
+      if (block)
+      {
+        fdlen_ = static_cast<unsigned short>(r);
+        fdpos_ = static_cast<unsigned short>(len - k < fdlen_ ? len - k : fdlen_);
+        std::memcpy(t + k, fdbuf_, fdpos_);
+        k += fdpos_;
+      }
+      else
+      {
+        k += static_cast<size_t>(r);
+      }
+      if (k % size == 0)
+        break;
+    }
+    else if (r == 0)
+    {
+      fdeof_ = true;
+      break;
+    }
+    else if (errno != EINTR)
+    {
+      // a non-blocking read raised EAGAIN, or a read error occurred
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        fdeof_ = true;
+      break;
+    }
+  }
+#if !REFLEX_WINDOWS_FILE_IO && defined(POSIX_FADV_DONTNEED)
+  // drop the pages read from the page cache for cold scans
+  if ((hint_ & file_hint::noreuse) && got > 0)
+  {
+    off_t off = ::lseek(fd_, 0, SEEK_CUR);
+    if (off >= static_cast<off_t>(got))
+      (void)::posix_fadvise(fd_, off - static_cast<off_t>(got), static_cast<off_t>(got), POSIX_FADV_DONTNEED);
+  }
+#endif
+  return k / size;
+}
+
+void Input::file_hint(file_hint_type hint)
+{
+  hint_ = hint;
+#if !REFLEX_WINDOWS_FILE_IO && defined(POSIX_FADV_SEQUENTIAL)
+  if (fd_ >= 0 && (hint & file_hint::sequential))
+    (void)::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
 size_t Input::file_get(char *s, size_t n)
 {
   char *t = s;
@@ -774,7 +861,7 @@ size_t Input::file_get(char *s, size_t n)
   switch (utfx_)
   {
     case file_encoding::utf16be:
-      while (n > 0 && ::fread(buf, 1, 1, file_) == 1 && file_read(reinterpret_cast<char*>(buf) + 1, 1))
+      while (n > 0 && file_fread(buf, 1, 1) == 1 && file_read(reinterpret_cast<char*>(buf) + 1, 1))
       {
         int c = buf[0] << 8 | buf[1];
         if (c < 0x80)
@@ -797,7 +884,7 @@ size_t Input::file_get(char *s, size_t n)
           {
             std::memcpy(t, utf8_, n);
             uidx_ = static_cast<unsigned short>(n);
-            ulen_ = static_cast<unsigned short>(l);
+            ulen_ = static_cast<unsigned short>(l - n);
             t += n;
             n = 0;
           }
@@ -813,7 +900,7 @@ size_t Input::file_get(char *s, size_t n)
         size_ -= t - s;
       return t - s;
     case file_encoding::utf16le:
-      while (n > 0 && ::fread(buf, 1, 1, file_) == 1 && file_read(reinterpret_cast<char*>(buf) + 1, 1))
+      while (n > 0 && file_fread(buf, 1, 1) == 1 && file_read(reinterpret_cast<char*>(buf) + 1, 1))
       {
         int c = buf[0] | buf[1] << 8;
         if (c < 0x80)
@@ -836,7 +923,7 @@ size_t Input::file_get(char *s, size_t n)
           {
             std::memcpy(t, utf8_, n);
             uidx_ = static_cast<unsigned short>(n);
-            ulen_ = static_cast<unsigned short>(l);
+            ulen_ = static_cast<unsigned short>(l - n);
             t += n;
             n = 0;
           }
@@ -852,7 +939,7 @@ size_t Input::file_get(char *s, size_t n)
         size_ -= t - s;
       return t - s;
     case file_encoding::utf32be:
-      while (n > 0 && ::fread(buf, 1, 1, file_) == 1 && file_read(reinterpret_cast<char*>(buf) + 1, 3))
+      while (n > 0 && file_fread(buf, 1, 1) == 1 && file_read(reinterpret_cast<char*>(buf) + 1, 3))
       {
         int c = buf[0] << 24 | buf[1] << 16 | buf[2] << 8 | buf[3];
         if (c < 0x80)
@@ -867,7 +954,7 @@ size_t Input::file_get(char *s, size_t n)
           {
             std::memcpy(t, utf8_, n);
             uidx_ = static_cast<unsigned short>(n);
-            ulen_ = static_cast<unsigned short>(l);
+            ulen_ = static_cast<unsigned short>(l - n);
             t += n;
             n = 0;
           }
@@ -883,7 +970,7 @@ size_t Input::file_get(char *s, size_t n)
         size_ -= t - s;
       return t - s;
     case file_encoding::utf32le:
-      while (n > 0 && ::fread(buf, 1, 1, file_) == 1 && file_read(reinterpret_cast<char*>(buf) + 1, 3))
+      while (n > 0 && file_fread(buf, 1, 1) == 1 && file_read(reinterpret_cast<char*>(buf) + 1, 3))
       {
         int c = buf[0] | buf[1] << 8 | buf[2] << 16 | buf[3] << 24;
         if (c < 0x80)
@@ -898,7 +985,7 @@ size_t Input::file_get(char *s, size_t n)
           {
             std::memcpy(t, utf8_, n);
             uidx_ = static_cast<unsigned short>(n);
-            ulen_ = static_cast<unsigned short>(l);
+            ulen_ = static_cast<unsigned short>(l - n);
             t += n;
             n = 0;
           }
@@ -914,7 +1001,7 @@ size_t Input::file_get(char *s, size_t n)
         size_ -= t - s;
       return t - s;
     case file_encoding::latin:
-      while (n > 0 && ::fread(t, 1, 1, file_) == 1)
+      while (n > 0 && file_fread(t, 1, 1) == 1)
       {
         int c = static_cast<unsigned char>(*t);
         if (c < 0x80)
@@ -935,7 +1022,7 @@ size_t Input::file_get(char *s, size_t n)
           else
           {
             uidx_ = 1;
-            ulen_ = 2;
+            ulen_ = 1;
           }
         }
       }
@@ -974,7 +1061,7 @@ size_t Input::file_get(char *s, size_t n)
     case file_encoding::koi8_u:
     case file_encoding::koi8_ru:
     case file_encoding::custom:
-      while (n > 0 && ::fread(t, 1, 1, file_) == 1)
+      while (n > 0 && file_fread(t, 1, 1) == 1)
       {
         int c = page_[static_cast<unsigned char>(*t)];
         if (c < 0x80)
@@ -989,7 +1076,7 @@ size_t Input::file_get(char *s, size_t n)
           {
             std::memcpy(t, utf8_, n);
             uidx_ = static_cast<unsigned short>(n);
-            ulen_ = static_cast<unsigned short>(l);
+            ulen_ = static_cast<unsigned short>(l - n);
             t += n;
             n = 0;
           }
@@ -1007,7 +1094,7 @@ size_t Input::file_get(char *s, size_t n)
     case file_encoding::null_data:
     {
       char *r = t;
-      t += ::fread(t, 1, n, file_);
+      t += file_fread(t, 1, n);
       while (r < t)
       {
         if (*r == '\0')
@@ -1021,7 +1108,7 @@ size_t Input::file_get(char *s, size_t n)
       return t - s;
     }
     default:
-      t += ::fread(t, 1, n, file_);
+      t += file_fread(t, 1, n);
       if (size_ + s >= t)
         size_ -= t - s;
       return t - s;
@@ -1030,13 +1117,15 @@ size_t Input::file_get(char *s, size_t n)
 
 bool Input::file_ready()
 {
-  if (file_ == NULL || feof(file_))
+  if (file_ == NULL && fd_ >= 0 && fdpos_ < fdlen_)
+    return true;
+  if (file_ != NULL ? feof(file_) != 0 : fd_ < 0 || fdeof_)
     return false;
 #if REFLEX_WINDOWS_FILE_IO
-  return !ferror(file_);
+  return file_ == NULL || !ferror(file_);
 #else
-  int fd = fileno(file_);
-  if (ferror(file_))
+  int fd = file_ != NULL ? fileno(file_) : fd_;
+  if (file_ != NULL && ferror(file_))
   {
     if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
       return false;
@@ -1060,7 +1149,8 @@ bool Input::file_ready()
     FD_SET(fd, &efds);
     tv.tv_sec = 0;
     tv.tv_usec = 10000; // 10ms timeout
-    clearerr(file_);    // unset EAGAIN etc
+    if (file_ != NULL)
+      clearerr(file_);  // unset EAGAIN etc
     if (::select(fd + 1, &rfds, NULL, &efds, &tv) >= 0)
       return FD_ISSET(fd, &efds) == 0;
     if (errno != EINTR)
@@ -1099,14 +1189,22 @@ void Input::wstring_size()
 
 void Input::file_size()
 {
-  off_t k = ftello(file_);
+  off_t k = file_ != NULL ? ftello(file_) : lseek(fd_, 0, SEEK_CUR);
   if (k >= 0)
   {
+    if (file_ == NULL && fdpos_ < fdlen_)
+    {
+      // the bytes left in the block read buffer are not read yet, restart from the first of them
+      k -= fdlen_ - fdpos_;
+      lseek(fd_, k, SEEK_SET);
+    }
+    fdpos_ = 0;
+    fdlen_ = 0;
     unsigned char buf[4];
     switch (utfx_)
     {
       case file_encoding::latin:
-        while (::fread(buf, 1, 1, file_) == 1)
+        while (file_fread(buf, 1, 1) == 1)
           size_ += 1 + (buf[0] >= 0x80);
         break;
       case file_encoding::cp437:
@@ -1141,20 +1239,20 @@ void Input::file_size()
       case file_encoding::koi8_u:
       case file_encoding::koi8_ru:
       case file_encoding::custom:
-        while (::fread(buf, 1, 1, file_) == 1)
+        while (file_fread(buf, 1, 1) == 1)
         {
           int c = page_[buf[0]];
           size_ += 1 + (c >= 0x80) + (c >= 0x0800); // + (c >= 0x010000); NOTE: page_[] value range < Unicode range
         }
         break;
       case file_encoding::utf16be:
-        while (::fread(buf, 2, 1, file_) == 1)
+        while (file_fread(buf, 2, 1) == 1)
         {
           int c = buf[0] << 8 | buf[1];
           if (c >= 0xD800 && c < 0xE000)
           {
             // UTF-16 surrogate pair
-            if (c < 0xDC00 && ::fread(buf + 2, 2, 1, file_) == 1 && (buf[2] & 0xFC) == 0xDC)
+            if (c < 0xDC00 && file_fread(buf + 2, 2, 1) == 1 && (buf[2] & 0xFC) == 0xDC)
               c = 0x010000 - 0xDC00 + ((c - 0xD800) << 10) + (buf[2] << 8 | buf[3]);
             else
               c = REFLEX_NONCHAR;
@@ -1169,13 +1267,13 @@ void Input::file_size()
         }
         break;
       case file_encoding::utf16le:
-        while (::fread(buf, 2, 1, file_) == 1)
+        while (file_fread(buf, 2, 1) == 1)
         {
           int c = buf[0] | buf[1] << 8;
           if (c >= 0xD800 && c < 0xE000)
           {
             // UTF-16 surrogate pair
-            if (c < 0xDC00 && ::fread(buf + 2, 2, 1, file_) == 1 && (buf[2] & 0xFC) == 0xDC)
+            if (c < 0xDC00 && file_fread(buf + 2, 2, 1) == 1 && (buf[2] & 0xFC) == 0xDC)
               c = 0x010000 - 0xDC00 + ((c - 0xD800) << 10) + (buf[2] << 8 | buf[3]);
             else
               c = REFLEX_NONCHAR;
@@ -1190,7 +1288,7 @@ void Input::file_size()
         }
         break;
       case file_encoding::utf32be:
-        while (::fread(buf, 4, 1, file_) == 1)
+        while (file_fread(buf, 4, 1) == 1)
         {
           int c = buf[0] << 24 | buf[1] << 16 | buf[2] << 8 | buf[3];
 #ifndef WITH_UTF8_UNRESTRICTED
@@ -1201,7 +1299,7 @@ void Input::file_size()
         }
         break;
       case file_encoding::utf32le:
-        while (::fread(buf, 4, 1, file_) == 1)
+        while (file_fread(buf, 4, 1) == 1)
         {
           int c = buf[0] | buf[1] << 8 | buf[2] << 16 | buf[3] << 24;
 #ifndef WITH_UTF8_UNRESTRICTED
@@ -1212,15 +1310,35 @@ void Input::file_size()
         }
         break;
       default:
-        fseeko(file_, k, SEEK_END);
-        off_t n = ftello(file_);
-        if (n >= k)
-          size_ = static_cast<size_t>(n - k);
+        if (file_ != NULL)
+        {
+          fseeko(file_, k, SEEK_END);
+          off_t n = ftello(file_);
+          if (n >= k)
+            size_ = static_cast<size_t>(n - k);
+        }
+        else
+        {
+          off_t n = lseek(fd_, 0, SEEK_END);
+          if (n >= k)
+            size_ = static_cast<size_t>(n - k);
+        }
+    }
+    if (file_ != NULL)
+    {
+      ::clearerr(file_);
+      fseeko(file_, k, SEEK_SET);
+    }
+    else
+    {
+      fdeof_ = false;
+      fdpos_ = 0;
+      fdlen_ = 0;
+      lseek(fd_, k, SEEK_SET);
     }
-    ::clearerr(file_);
-    fseeko(file_, k, SEEK_SET);
   }
-  ::clearerr(file_);
+  if (file_ != NULL)
+    ::clearerr(file_);
 }
 
 void Input::istream_size()
@@ -1238,7 +1356,7 @@ void Input::istream_size()
 
 void Input::file_encoding(unsigned short enc, const unsigned short *page)
 {
-  if (file_ && utfx_ != enc)
+  if ((file_ || fd_ >= 0) && utfx_ != enc)
   {
     if (utfx_ == file_encoding::plain && ulen_ > 0)
     {
@@ -1327,10 +1445,10 @@ void Input::file_encoding(unsigned short enc, const unsigned short *page)
           break;
         case file_encoding::utf16be:
           // enforcing non-BOM UTF-16: translate utf8_[] to UTF-16 then to UTF-8
-          if (b[1] == '\0' && ::fread(b + 1, 1, 1, file_) == 1)
+          if (b[1] == '\0' && file_fread(b + 1, 1, 1) == 1)
           {
-            if (b[2] == '\0' ? ::fread(b + 2, 2, 1, file_) == 1 :
-                b[3] == '\0' ? ::fread(b + 3, 1, 1, file_) == 1 :
+            if (b[2] == '\0' ? file_fread(b + 2, 2, 1) == 1 :
+                b[3] == '\0' ? file_fread(b + 3, 1, 1) == 1 :
                 false
                )
             {
@@ -1357,10 +1475,10 @@ void Input::file_encoding(unsigned short enc, const unsigned short *page)
           break;
         case file_encoding::utf16le:
           // enforcing non-BOM UTF-16: translate utf8_[] to UTF-16 then to UTF-8
-          if (b[1] == '\0' && ::fread(b + 1, 1, 1, file_) == 1)
+          if (b[1] == '\0' && file_fread(b + 1, 1, 1) == 1)
           {
-            if (b[2] == '\0' ? ::fread(b + 2, 2, 1, file_) == 1 :
-                b[3] == '\0' ? ::fread(b + 3, 1, 1, file_) == 1 :
+            if (b[2] == '\0' ? file_fread(b + 2, 2, 1) == 1 :
+                b[3] == '\0' ? file_fread(b + 3, 1, 1) == 1 :
                 false
                )
             {
@@ -1387,9 +1505,9 @@ void Input::file_encoding(unsigned short enc, const unsigned short *page)
           break;
         case file_encoding::utf32be:
           // enforcing non-BOM UTF-32: translate utf8_[] to UTF-32 then to UTF-8
-          if (b[1] == '\0' ? ::fread(b + 1, 3, 1, file_) == 1 :
-              b[2] == '\0' ? ::fread(b + 2, 2, 1, file_) == 1 :
-              b[3] == '\0' ? ::fread(b + 3, 1, 1, file_) == 1 :
+          if (b[1] == '\0' ? file_fread(b + 1, 3, 1) == 1 :
+              b[2] == '\0' ? file_fread(b + 2, 2, 1) == 1 :
+              b[3] == '\0' ? file_fread(b + 3, 1, 1) == 1 :
               false
              )
           {
@@ -1401,9 +1519,9 @@ void Input::file_encoding(unsigned short enc, const unsigned short *page)
           break;
         case file_encoding::utf32le:
           // enforcing non-BOM UTF-32: translate utf8_[] to UTF-32 then to UTF-8
-          if (b[1] == '\0' ? ::fread(b + 1, 3, 1, file_) == 1 :
-              b[2] == '\0' ? ::fread(b + 2, 2, 1, file_) == 1 :
-              b[3] == '\0' ? ::fread(b + 3, 1, 1, file_) == 1 :
+          if (b[1] == '\0' ? file_fread(b + 1, 3, 1) == 1 :
+              b[2] == '\0' ? file_fread(b + 2, 2, 1) == 1 :
+              b[3] == '\0' ? file_fread(b + 3, 1, 1) == 1 :
               false
              )
           {
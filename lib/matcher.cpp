@@ -40,6 +40,13 @@ namespace reflex {
 
 /// Returns true if input matched the pattern using method Const::SCAN, Const::FIND, Const::SPLIT, or Const::MATCH.
 size_t Matcher::match(Method method)
+{
+  return (this->*pol_)(method);
+}
+
+/// match() specialized at compile time by policy P to omit the checks for pattern properties and options that P excludes, see init_match().
+template<int P>
+size_t Matcher::match_policy(Method method)
 {
   DBGLOG("BEGIN Matcher::match()");
   reset_text();
@@ -51,7 +58,7 @@ size_t Matcher::match(Method method)
     txt_ = buf_ + cur_;
     if ((this->*adv_)(cur_))
     {
-      if (pat_->lbk_ > 0)
+      if ((P & Policy::PRED) && pat_->lbk_ > 0)
       {
         // go back over lookback chars (never includes \n) from cur-1 back to txt (at most)
         const char *s = buf_ + cur_;
@@ -68,12 +75,12 @@ size_t Matcher::match(Method method)
             retry = 0;
         }
       }
-      else if (pat_->one_)
+      else if ((P & Policy::PRED) && pat_->one_)
       {
         // one string match, no need to perform a regex match
         size_t k = cur_ + pat_->len_;
         int ch = k < end_ ? static_cast<unsigned char>(buf_[k]) : EOF;
-        if (!opt_.W || (at_wb() && (at_end() || at_we(ch, k))))
+        if (!(P & Policy::WORD) || !opt_.W || (at_wb() && (at_end() || at_we(ch, k))))
         {
           txt_ = buf_ + cur_;
           len_ = pat_->len_;
@@ -87,31 +94,35 @@ size_t Matcher::match(Method method)
 scan:
   txt_ = buf_ + cur_;
 #if !defined(WITH_NO_INDENT)
-  mrk_ = false;
-  ind_ = pos_; // ind scans input in buf[] in newline() up to pos - 1
-  col_ = 0; // count columns for indent matching
+  if (P & Policy::DENT)
+  {
+    mrk_ = false;
+    ind_ = pos_; // ind scans input in buf[] in newline() up to pos - 1
+    col_ = 0; // count columns for indent matching
+  }
 #endif
 find:
   int ch = got_;
   bool bol = at_bol(); // at begin of line?
 #if !defined(WITH_NO_CODEGEN)
-  if (pat_->fsm_ != NULL)
+  if (P & Policy::FSM)
     fsm_.ch = ch;
 #endif
 #if !defined(WITH_NO_INDENT)
 redo:
 #endif
-  lap_.resize(0);
+  if (P & Policy::LOOK)
+    lap_.resize(0);
   cap_ = 0;
   bool nul = method == Const::MATCH;
-  if (!opt_.W || at_wb())
+  if (!(P & Policy::WORD) || !opt_.W || at_wb())
   {
     // skip to next line and keep searching if matching on anchor ^ and not at begin of line
-    if (method == Const::FIND && pat_->bol_ && !bol)
+    if (method == Const::FIND && (P & Policy::PRED) && pat_->bol_ && !bol)
       if (skip('\n'))
         goto scan;
 #if !defined(WITH_NO_CODEGEN)
-    if (pat_->fsm_ != NULL)
+    if (P & Policy::FSM)
     {
       DBGLOG("FSM code %p", pat_->fsm_);
       fsm_.bol = bol;
@@ -139,7 +150,7 @@ redo:
             case 0xfe: // TAKE
               {
                 int c;
-                if (!opt_.W || (c = peek(), at_we(c, pos_)))
+                if (!(P & Policy::WORD) || !opt_.W || (c = peek(), at_we(c, pos_)))
                 {
                   cap_ = Pattern::long_index_of(opcode);
                   DBGLOG("Take: cap = %zu", cap_);
@@ -205,7 +216,7 @@ redo:
                 switch (opcode >> 24)
                 {
                   case 0xfe: // TAKE
-                    if (!opt_.W || at_we(ch, pos_ - 1))
+                    if (!(P & Policy::WORD) || !opt_.W || at_we(ch, pos_ - 1))
                     {
                       cap_ = Pattern::long_index_of(opcode);
                       DBGLOG("Take: cap = %zu", cap_);
@@ -546,7 +557,7 @@ redo:
     }
   }
 #if !defined(WITH_NO_INDENT)
-  if (mrk_ && cap_ != Const::REDO)
+  if ((P & Policy::DENT) && mrk_ && cap_ != Const::REDO)
   {
     if (col_ > 0 && (tab_.empty() || tab_.back() < col_))
     {
@@ -567,7 +578,7 @@ redo:
         tab_.back() = col_;
     }
   }
-  if (ded_ > 0)
+  if ((P & Policy::DENT) && ded_ > 0)
   {
     DBGLOG("Dedents: ded = %zu", ded_);
     if (col_ == 0 && bol)
@@ -636,7 +647,7 @@ redo:
         {
           if ((this->*adv_)(cur_ + 1))
           {
-            if (pat_->lbk_ > 0)
+            if ((P & Policy::PRED) && pat_->lbk_ > 0)
             {
               // go back and retry matching over lookback chars (never includes \n) from cur-1 to txt+1 (at most)
               const char *s = buf_ + cur_;
@@ -657,11 +668,11 @@ redo:
               goto scan;
             }
             // if not one string match then perform a regex match, else we're done
-            if (!pat_->one_)
+            if (!(P & Policy::PRED) || !pat_->one_)
               goto scan;
             size_t k = cur_ + pat_->len_;
             ch = k < end_ ? static_cast<unsigned char>(buf_[k]) : EOF;
-            if (opt_.W && (!at_wb() || !(at_end() || at_we(ch, k))))
+            if ((P & Policy::WORD) && opt_.W && (!at_wb() || !(at_end() || at_we(ch, k))))
               goto scan;
             txt_ = buf_ + cur_;
             len_ = pat_->len_;
@@ -749,6 +760,235 @@ redo:
   return cap_;
 }
 
+/// Search for a match that stops at the first accepting state reached, optionally without matching across a newline.
+bool Matcher::find_any(bool line)
+{
+  DBGLOG("BEGIN Matcher::find_any(%d)", line);
+  // anchors, word boundaries, negative patterns, lookback, and FSM code require a full FIND match
+  if (pat_ == NULL || pat_->opc_ == NULL || pat_->mta_ || pat_->lbk_ > 0 || opt_.W || opt_.N || ded_ > 0)
+  {
+    while (true)
+    {
+      int got = got_;
+      if (match(Const::FIND) == 0)
+        break;
+      if (!line)
+        return true;
+      const char *eol = static_cast<const char*>(std::memchr(txt_, '\n', len_));
+      if (eol == NULL)
+        return true;
+      // the match crosses a newline: search again bounded to the rest of this line, then continue at the next line
+      size_t loc = eol - buf_;
+      size_t end = end_;
+      bool eof = eof_;
+      end_ = loc;
+      eof_ = true;
+      if (txt_ > buf_)
+        got = static_cast<unsigned char>(txt_[-1]);
+      set_current(txt_ - buf_);
+      got_ = got;
+      size_t cap = match(Const::FIND);
+      end_ = end;
+      eof_ = eof;
+      if (cap != 0)
+        return true;
+      set_current(loc + 1);
+    }
+    return false;
+  }
+  reset_text();
+  len_ = 0;
+  const Pattern::Opcode *opc = pat_->opc_;
+  while (true)
+  {
+    // advance to the next position where a match may start
+    txt_ = buf_ + cur_;
+    if (adv_ != &Matcher::advance_none && (this->*adv_)(cur_) && pat_->one_)
+    {
+      txt_ = buf_ + cur_;
+      len_ = pat_->len_;
+      set_current(cur_ + len_);
+      DBGLOG("END Matcher::find_any() one string at %zu", txt_ - buf_);
+      return true;
+    }
+    // the advance may also give up on the last bytes buffered or stop at the end, run the DFA from here unless at the end of the input
+    set_current(cur_);
+    if (peek() == EOF)
+      break;
+    txt_ = buf_ + cur_;
+    // run the DFA from this position until it halts or reaches an accepting state after consuming a char
+    const Pattern::Opcode *pc = opc;
+    while (true)
+    {
+      Pattern::Opcode opcode = *pc;
+      if (!Pattern::is_opcode_goto(opcode))
+      {
+        if (Pattern::is_opcode_take(opcode) && pos_ > cur_)
+        {
+          len_ = pos_ - cur_;
+          set_current(pos_);
+          DBGLOG("END Matcher::find_any() at %zu", txt_ - buf_);
+          return true;
+        }
+        ++pc;
+        continue;
+      }
+      if (Pattern::is_opcode_halt(opcode))
+        break;
+      int c = get();
+      if (c == EOF || (line && c == '\n'))
+        break;
+      while (!Pattern::is_opcode_goto(*pc, static_cast<unsigned char>(c)))
+        pc += 1 + (Pattern::index_of(*pc) == Pattern::Const::LONG);
+      Pattern::Index jump = Pattern::index_of(*pc);
+      if (jump == Pattern::Const::HALT)
+        break;
+      if (jump == Pattern::Const::LONG)
+        jump = Pattern::long_index_of(pc[1]);
+      pc = opc + jump;
+    }
+    // no match at this position, try the next position
+    set_current(++cur_);
+  }
+  txt_ = buf_ + cur_;
+  DBGLOG("END Matcher::find_any() no match");
+  return false;
+}
+
+/// Match a batch of strings entirely against a pattern, advancing several strings in lock-step through the pattern's opcode table to hide memory latency.
+void Matcher::match_batch(const Pattern& pattern, const char *const *data, const size_t *size, size_t n, size_t *accept)
+{
+  DBGLOG("BEGIN Matcher::match_batch(%zu)", n);
+  const Pattern::Opcode *opc = pattern.opc_;
+  if (opc == NULL)
+  {
+    // no opcode table, e.g. FSM code or empty pattern
+    for (size_t i = 0; i < n; ++i)
+      accept[i] = reflex::match(pattern, data[i], size[i]);
+    return;
+  }
+  // number of strings advanced in lock-step, each string is matched in its own lane
+  const size_t LANES = 8;
+  const Pattern::Opcode *pc[LANES];
+  const char *s[LANES];
+  const char *e[LANES];
+  size_t id[LANES];
+  size_t next = 0;
+  size_t active = 0;
+  for (size_t k = 0; k < LANES; ++k)
+  {
+    if (next < n)
+    {
+      pc[k] = opc;
+      s[k] = data[next];
+      e[k] = data[next] + size[next];
+      id[k] = next++;
+      ++active;
+    }
+    else
+    {
+      id[k] = n;
+    }
+  }
+  while (active > 0)
+  {
+    for (size_t k = 0; k < LANES; ++k)
+    {
+      if (id[k] == n)
+        continue;
+      const Pattern::Opcode *p = pc[k];
+      Pattern::Opcode opcode = *p;
+      size_t cap = 0;
+      bool done = false;
+      // pass TAKE and LONG opcodes at the start of the state, lanes with lookaheads and anchors etc. are matched with a SpanMatcher
+      while (REFLEX_UNLIKELY(!Pattern::is_opcode_goto(opcode)))
+      {
+        if (Pattern::is_opcode_long(opcode))
+        {
+          opcode = *++p;
+        }
+        else if (Pattern::is_opcode_take(opcode))
+        {
+          cap = Pattern::long_index_of(opcode);
+          opcode = *++p;
+        }
+        else
+        {
+          DBGLOG("Lane %zu string %zu: not a plain DFA state", k, id[k]);
+          cap = reflex::match(pattern, data[id[k]], size[id[k]]);
+          s[k] = e[k];
+          break;
+        }
+      }
+      if (s[k] == e[k])
+      {
+        done = true;
+      }
+      else
+      {
+        uint8_t c = static_cast<uint8_t>(*s[k]++);
+        while (!Pattern::is_opcode_goto(opcode, c))
+          opcode = *++p;
+        Pattern::Index jump = Pattern::index_of(opcode);
+        if (jump == Pattern::Const::HALT)
+        {
+          cap = 0;
+          done = true;
+        }
+        else
+        {
+          if (jump == Pattern::Const::LONG)
+            jump = Pattern::long_index_of(p[1]);
+          pc[k] = opc + jump;
+        }
+      }
+      if (done)
+      {
+        accept[id[k]] = cap;
+        if (next < n)
+        {
+          pc[k] = opc;
+          s[k] = data[next];
+          e[k] = data[next] + size[next];
+          id[k] = next++;
+        }
+        else
+        {
+          id[k] = n;
+          --active;
+        }
+      }
+    }
+  }
+  DBGLOG("END Matcher::match_batch()");
+}
+
+#if !defined(WITH_NO_CODEGEN)
+/// FSM code to match a pattern with its bit-parallel NFA, the state set is advanced by the follow sets of its positions that consume the next char.
+void Pattern::match_nfa(Matcher& m)
+{
+  const NFA& nfa = m.pattern().nfa_;
+  NFA::Word sets[3][NFA::MAX_POSITIONS / 64];
+  NFA::Word *set = sets[0];
+  NFA::Word *next = sets[1];
+  NFA::Counts counts(nfa);
+  std::memcpy(set, &nfa.ini[0], nfa.words * sizeof(NFA::Word));
+  int c = 0;
+  m.FSM_INIT(c);
+  m.FSM_FIND();
+  while (true)
+  {
+    Accept accept = nfa.accepting(set);
+    if (accept > 0)
+      m.FSM_TAKE(accept);
+    c = m.FSM_CHAR();
+    if (c == EOF || !nfa.step(counts, set, &nfa.chr[static_cast<size_t>(c) * nfa.words], next, sets[2]))
+      return m.FSM_HALT(c);
+    std::swap(set, next);
+  }
+}
+#endif
+
 // expand code for all pin minimal cases
 #define INIT_ADV_PAT_PIN_CASE(PIN) \
   if (pat_->min_ <= 1) \
@@ -757,8 +997,30 @@ redo:
     adv_ = &Matcher::advance_pattern_pin##PIN##_pma;
 
 /// Initialize specialized pattern search methods to advance the engine to a possible match
+void Matcher::init_match()
+{
+  pol_ = &Matcher::match_policy<Policy::ALL>;
+  if (pat_ == NULL)
+    return;
+#if !defined(WITH_NO_CODEGEN)
+  if (pat_->fsm_ != NULL)
+  {
+    pol_ = &Matcher::match_policy<Policy::FSM | Policy::ALL>;
+    return;
+  }
+#endif
+  // pending dedents are matched by the general match(), even when the new pattern has no indent anchors
+  if (opt_.W || pat_->lap_ || pat_->idt_ || ded_ > 0)
+    return;
+  if (pat_->bol_ || pat_->lbk_ > 0 || pat_->one_)
+    pol_ = &Matcher::match_policy<Policy::PRED>;
+  else
+    pol_ = &Matcher::match_policy<0>;
+}
+
 void Matcher::init_advance()
 {
+  init_match();
   adv_ = &Matcher::advance_none;
   if (pat_ == NULL)
     return;
@@ -817,6 +1079,13 @@ void Matcher::init_advance()
         }
     }
   }
+  else if (pat_->icp_)
+  {
+    if (pat_->min_ == 0)
+      adv_ = &Matcher::advance_string_icase;
+    else
+      adv_ = &Matcher::advance_string_icase_pma;
+  }
   else if (pat_->len_ == 1)
   {
     if (pat_->min_ == 0)
@@ -1909,7 +2178,7 @@ bool Matcher::advance_pattern_min1(size_t loc)
   {
     const char *s = buf_ + loc;
     const char *e = buf_ + end_ - (Pattern::Const::PM_M + 2);
-    uint8_t c0 = static_cast<uint8_t>(buf_[loc]);
+    uint8_t c0 = loc < end_ ? static_cast<uint8_t>(buf_[loc]) : 0;
     while (s < e)
     {
       uint8_t c1 = static_cast<uint8_t>(s[1]);
@@ -1946,7 +2215,7 @@ bool Matcher::advance_pattern_min1(size_t loc)
       {
         s = buf_ + loc;
         e = buf_ + end_;
-        c0 = static_cast<uint8_t>(s[0]);
+        c0 = s < e ? static_cast<uint8_t>(s[0]) : 0;
         while (s < e)
         {
           uint8_t c1 = s + 1 < e ? static_cast<uint8_t>(s[1]) : 0;
@@ -1976,7 +2245,7 @@ bool Matcher::advance_pattern_min2(size_t loc)
   {
     const char *s = buf_ + loc;
     const char *e = buf_ + end_ - (Pattern::Const::PM_M - 1);
-    uint8_t c0 = static_cast<uint8_t>(*s);
+    uint8_t c0 = loc < end_ ? static_cast<uint8_t>(*s) : 0;
     while (s < e)
     {
       uint8_t c1 = static_cast<uint8_t>(*++s);
@@ -1998,7 +2267,7 @@ bool Matcher::advance_pattern_min2(size_t loc)
       // keep going, we may have matches in the last bytes
       s = buf_ + loc;
       e = buf_ + end_ - 1;
-      c0 = static_cast<uint8_t>(s[0]);
+      c0 = loc < end_ ? static_cast<uint8_t>(s[0]) : 0;
       while (s < e)
       {
         uint8_t c1 = static_cast<uint8_t>(*++s);
@@ -2036,7 +2305,7 @@ bool Matcher::advance_pattern_min3(size_t loc)
   {
     const char *s = buf_ + loc;
     const char *e = buf_ + end_ - (Pattern::Const::PM_M - 2);
-    uint8_t c0 = static_cast<uint8_t>(*s);
+    uint8_t c0 = loc < end_ ? static_cast<uint8_t>(*s) : 0;
     while (s < e)
     {
       uint8_t c1 = static_cast<uint8_t>(*++s);
@@ -2058,7 +2327,7 @@ bool Matcher::advance_pattern_min3(size_t loc)
       // keep going, we may have matches in the last bytes
       s = buf_ + loc;
       e = buf_ + end_ - 1;
-      c0 = static_cast<uint8_t>(s[0]);
+      c0 = loc < end_ ? static_cast<uint8_t>(s[0]) : 0;
       while (s < e)
       {
         uint8_t c1 = static_cast<uint8_t>(*++s);
@@ -2100,7 +2369,7 @@ bool Matcher::advance_pattern_mink(size_t loc)
   {
     const char *s = buf_ + loc;
     const char *e = buf_ + end_ - sub;
-    uint8_t c0 = static_cast<uint8_t>(*s);
+    uint8_t c0 = loc < end_ ? static_cast<uint8_t>(*s) : 0;
     while (s < e)
     {
       uint8_t c1 = static_cast<uint8_t>(*++s);
@@ -2129,7 +2398,7 @@ bool Matcher::advance_pattern_mink(size_t loc)
       // keep going, we may have a match in the last bytes
       s = buf_ + loc;
       e = buf_ + end_ - 2;
-      c0 = static_cast<uint8_t>(s[0]);
+      c0 = loc < end_ ? static_cast<uint8_t>(s[0]) : 0;
       while (s < e)
       {
         uint8_t c1 = static_cast<uint8_t>(*++s);
@@ -2880,4 +3149,226 @@ bool Matcher::advance_string_bm_pma(size_t loc)
   }
 }
 
+/// Case-insensitive string, ASCII letters of the string in chr_[] are lower case and compared with OR 0x20 case folding
+bool Matcher::advance_string_icase(size_t loc)
+{
+  const char *chr = pat_->chr_;
+  const uint16_t len = pat_->len_;
+  const uint16_t lcp = pat_->lcp_;
+  const uint16_t lcs = pat_->lcs_;
+  const char chlcp = chr[lcp];
+  const char chlcs = chr[lcs];
+  const char mklcp = icase_mask(chlcp);
+  const char mklcs = icase_mask(chlcs);
+  while (true)
+  {
+    const char *s = buf_ + loc + lcp;
+    const char *e = buf_ + end_ + lcp - len + 1;
+#if defined(HAVE_AVX512BW) || defined(HAVE_AVX2) || defined(HAVE_SSE2)
+    // SSE2 string search scheme based on http://0x80.pl/articles/simd-friendly-karp-rabin.html with case folding
+    __m128i vlcp = _mm_set1_epi8(chlcp);
+    __m128i vlcs = _mm_set1_epi8(chlcs);
+    __m128i vmklcp = _mm_set1_epi8(mklcp);
+    __m128i vmklcs = _mm_set1_epi8(mklcs);
+    while (s <= e - 16)
+    {
+      __m128i vlcpm = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s)), vmklcp);
+      __m128i vlcsm = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + lcs - lcp)), vmklcs);
+      __m128i vlcpeq = _mm_cmpeq_epi8(vlcp, vlcpm);
+      __m128i vlcseq = _mm_cmpeq_epi8(vlcs, vlcsm);
+      uint32_t mask = _mm_movemask_epi8(_mm_and_si128(vlcpeq, vlcseq));
+      while (REFLEX_UNLIKELY(mask != 0))
+      {
+        uint32_t offset = ctz(mask);
+        if (icase_equal(s - lcp + offset, chr, len))
+        {
+          size_t k = s - lcp + offset - buf_;
+          set_current(k);
+          return true;
+        }
+        mask &= mask - 1;
+      }
+      s += 16;
+    }
+#elif defined(HAVE_NEON)
+    if (simd_advance_string_icase_neon(s, e))
+      return true;
+#endif
+    while (s < e)
+    {
+      if ((*s | mklcp) == chlcp && (s[lcs - lcp] | mklcs) == chlcs && icase_equal(s - lcp, chr, len))
+      {
+        size_t k = s - lcp - buf_;
+        set_current(k);
+        return true;
+      }
+      ++s;
+    }
+    loc = s - lcp - buf_;
+    set_current_and_peek_more(loc);
+    loc = cur_;
+    if (loc + len > end_ && eof_)
+      return false;
+  }
+}
+
+/// Case-insensitive string followed by 1 to 4 characters
+bool Matcher::advance_string_icase_pma(size_t loc)
+{
+  const char *chr = pat_->chr_;
+  const uint16_t len = pat_->len_;
+  const uint16_t min = pat_->min_;
+  const uint16_t lcp = pat_->lcp_;
+  const uint16_t lcs = pat_->lcs_;
+  const char chlcp = chr[lcp];
+  const char chlcs = chr[lcs];
+  const char mklcp = icase_mask(chlcp);
+  const char mklcs = icase_mask(chlcs);
+  while (true)
+  {
+    const char *s = buf_ + loc + lcp;
+    const char *e = buf_ + end_ + lcp - len - min + 1;
+#if defined(HAVE_AVX512BW) || defined(HAVE_AVX2) || defined(HAVE_SSE2)
+    // SSE2 string search scheme based on http://0x80.pl/articles/simd-friendly-karp-rabin.html with case folding
+    __m128i vlcp = _mm_set1_epi8(chlcp);
+    __m128i vlcs = _mm_set1_epi8(chlcs);
+    __m128i vmklcp = _mm_set1_epi8(mklcp);
+    __m128i vmklcs = _mm_set1_epi8(mklcs);
+    while (s <= e - 16)
+    {
+      __m128i vlcpm = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s)), vmklcp);
+      __m128i vlcsm = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + lcs - lcp)), vmklcs);
+      __m128i vlcpeq = _mm_cmpeq_epi8(vlcp, vlcpm);
+      __m128i vlcseq = _mm_cmpeq_epi8(vlcs, vlcsm);
+      uint32_t mask = _mm_movemask_epi8(_mm_and_si128(vlcpeq, vlcseq));
+      while (REFLEX_UNLIKELY(mask != 0))
+      {
+        uint32_t offset = ctz(mask);
+        if (icase_equal(s - lcp + offset, chr, len))
+        {
+          size_t k = s - lcp + offset - buf_;
+          if (REFLEX_UNLIKELY(k + len + Pattern::Const::PM_M > end_) || pat_->predict_match(&buf_[k + len]))
+          {
+            set_current(k);
+            return true;
+          }
+        }
+        mask &= mask - 1;
+      }
+      s += 16;
+    }
+#elif defined(HAVE_NEON)
+    if (simd_advance_string_icase_pma_neon(s, e))
+      return true;
+#endif
+    while (s < e)
+    {
+      if ((*s | mklcp) == chlcp && (s[lcs - lcp] | mklcs) == chlcs && icase_equal(s - lcp, chr, len))
+      {
+        size_t k = s - lcp - buf_;
+        if (REFLEX_UNLIKELY(k + len + Pattern::Const::PM_M > end_) || pat_->predict_match(&buf_[k + len]))
+        {
+          set_current(k);
+          return true;
+        }
+      }
+      ++s;
+    }
+    loc = s - lcp - buf_;
+    set_current_and_peek_more(loc);
+    loc = cur_;
+    if (loc + len + min > end_ && eof_)
+      return false;
+  }
+}
+
+#if defined(HAVE_NEON)
+
+// Implements NEON/AArch64 string search scheme based on http://0x80.pl/articles/simd-friendly-karp-rabin.html with case folding
+bool Matcher::simd_advance_string_icase_neon(const char *& s, const char *e)
+{
+  const uint16_t lcp = pat_->lcp_;
+  const uint16_t lcs = pat_->lcs_;
+  const uint16_t len = pat_->len_;
+  const char *chr = pat_->chr_;
+  uint8_t chlcp = static_cast<uint8_t>(chr[lcp]);
+  uint8_t chlcs = static_cast<uint8_t>(chr[lcs]);
+  uint8x16_t vlcp = vdupq_n_u8(chlcp);
+  uint8x16_t vlcs = vdupq_n_u8(chlcs);
+  uint8x16_t vmklcp = vdupq_n_u8(static_cast<uint8_t>(icase_mask(chlcp)));
+  uint8x16_t vmklcs = vdupq_n_u8(static_cast<uint8_t>(icase_mask(chlcs)));
+  while (s <= e - 16)
+  {
+    uint8x16_t vlcpm = vorrq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(s)), vmklcp);
+    uint8x16_t vlcsm = vorrq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(s) + lcs - lcp), vmklcs);
+    uint8x16_t vlcpeq = vceqq_u8(vlcp, vlcpm);
+    uint8x16_t vlcseq = vceqq_u8(vlcs, vlcsm);
+    uint8x16_t vmask8 = vandq_u8(vlcpeq, vlcseq);
+    uint64x2_t vmask64 = vreinterpretq_u64_u8(vmask8);
+    for (int lane = 0; lane < 2; ++lane)
+    {
+      uint64_t mask = lane == 0 ? vgetq_lane_u64(vmask64, 0) : vgetq_lane_u64(vmask64, 1);
+      size_t k = s - lcp + 8 * lane - buf_;
+      while (REFLEX_UNLIKELY(mask != 0))
+      {
+        if ((mask & 0xff) && icase_equal(&buf_[k], chr, len))
+        {
+          set_current(k);
+          return true;
+        }
+        mask >>= 8;
+        ++k;
+      }
+    }
+    s += 16;
+  }
+  return false;
+}
+
+// Implements NEON/AArch64 string search scheme based on http://0x80.pl/articles/simd-friendly-karp-rabin.html with case folding
+bool Matcher::simd_advance_string_icase_pma_neon(const char *& s, const char *e)
+{
+  const uint16_t lcp = pat_->lcp_;
+  const uint16_t lcs = pat_->lcs_;
+  const uint16_t len = pat_->len_;
+  const char *chr = pat_->chr_;
+  uint8_t chlcp = static_cast<uint8_t>(chr[lcp]);
+  uint8_t chlcs = static_cast<uint8_t>(chr[lcs]);
+  uint8x16_t vlcp = vdupq_n_u8(chlcp);
+  uint8x16_t vlcs = vdupq_n_u8(chlcs);
+  uint8x16_t vmklcp = vdupq_n_u8(static_cast<uint8_t>(icase_mask(chlcp)));
+  uint8x16_t vmklcs = vdupq_n_u8(static_cast<uint8_t>(icase_mask(chlcs)));
+  while (s <= e - 16)
+  {
+    uint8x16_t vlcpm = vorrq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(s)), vmklcp);
+    uint8x16_t vlcsm = vorrq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(s) + lcs - lcp), vmklcs);
+    uint8x16_t vlcpeq = vceqq_u8(vlcp, vlcpm);
+    uint8x16_t vlcseq = vceqq_u8(vlcs, vlcsm);
+    uint8x16_t vmask8 = vandq_u8(vlcpeq, vlcseq);
+    uint64x2_t vmask64 = vreinterpretq_u64_u8(vmask8);
+    for (int lane = 0; lane < 2; ++lane)
+    {
+      uint64_t mask = lane == 0 ? vgetq_lane_u64(vmask64, 0) : vgetq_lane_u64(vmask64, 1);
+      size_t k = s - lcp + 8 * lane - buf_;
+      while (REFLEX_UNLIKELY(mask != 0))
+      {
+        if ((mask & 0xff) && icase_equal(&buf_[k], chr, len))
+        {
+          if (REFLEX_UNLIKELY(k + len + Pattern::Const::PM_M > end_) || pat_->predict_match(&buf_[k + len]))
+          {
+            set_current(k);
+            return true;
+          }
+        }
+        mask >>= 8;
+        ++k;
+      }
+    }
+    s += 16;
+  }
+  return false;
+}
+
+#endif // HAVE_NEON
+
 } // namespace reflex
@@ -110,6 +110,13 @@ void Matcher::simd_init_advance_avx2()
 #endif
     }
   }
+  else if (pat_->icp_)
+  {
+    if (pat_->min_ == 0)
+      adv_ = &Matcher::simd_advance_string_icase_avx2;
+    else
+      adv_ = &Matcher::simd_advance_string_icase_pma_avx2;
+  }
   else if (pat_->len_ == 1)
   {
     // no specialization
@@ -980,6 +987,127 @@ bool Matcher::simd_advance_string_pma_avx2(size_t loc)
   }
 }
 
+/// Implements AVX2 string search scheme based on http://0x80.pl/articles/simd-friendly-karp-rabin.html with case folding
+bool Matcher::simd_advance_string_icase_avx2(size_t loc)
+{
+  const char *chr = pat_->chr_;
+  const uint16_t len = pat_->len_;
+  const uint16_t lcp = pat_->lcp_;
+  const uint16_t lcs = pat_->lcs_;
+  const char chlcp = chr[lcp];
+  const char chlcs = chr[lcs];
+  const char mklcp = icase_mask(chlcp);
+  const char mklcs = icase_mask(chlcs);
+  while (true)
+  {
+    const char *s = buf_ + loc + lcp;
+    const char *e = buf_ + end_ + lcp - len + 1;
+    __m256i vlcp = _mm256_set1_epi8(chlcp);
+    __m256i vlcs = _mm256_set1_epi8(chlcs);
+    __m256i vmklcp = _mm256_set1_epi8(mklcp);
+    __m256i vmklcs = _mm256_set1_epi8(mklcs);
+    while (s <= e - 32)
+    {
+      __m256i vlcpm = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s)), vmklcp);
+      __m256i vlcsm = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + lcs - lcp)), vmklcs);
+      __m256i vlcpeq = _mm256_cmpeq_epi8(vlcp, vlcpm);
+      __m256i vlcseq = _mm256_cmpeq_epi8(vlcs, vlcsm);
+      uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(vlcpeq, vlcseq));
+      while (REFLEX_UNLIKELY(mask != 0))
+      {
+        uint32_t offset = ctz(mask);
+        if (icase_equal(s - lcp + offset, chr, len))
+        {
+          size_t k = s - lcp + offset - buf_;
+          set_current(k);
+          return true;
+        }
+        mask &= mask - 1;
+      }
+      s += 32;
+    }
+    while (s < e)
+    {
+      if ((*s | mklcp) == chlcp && (s[lcs - lcp] | mklcs) == chlcs && icase_equal(s - lcp, chr, len))
+      {
+        size_t k = s - lcp - buf_;
+        set_current(k);
+        return true;
+      }
+      ++s;
+    }
+    loc = s - lcp - buf_;
+    set_current_and_peek_more(loc);
+    loc = cur_;
+    if (loc + len > end_ && eof_)
+      return false;
+  }
+}
+
+/// Implements AVX2 string search scheme based on http://0x80.pl/articles/simd-friendly-karp-rabin.html with case folding
+bool Matcher::simd_advance_string_icase_pma_avx2(size_t loc)
+{
+  const char *chr = pat_->chr_;
+  const uint16_t len = pat_->len_;
+  const uint16_t min = pat_->min_;
+  const uint16_t lcp = pat_->lcp_;
+  const uint16_t lcs = pat_->lcs_;
+  const char chlcp = chr[lcp];
+  const char chlcs = chr[lcs];
+  const char mklcp = icase_mask(chlcp);
+  const char mklcs = icase_mask(chlcs);
+  while (true)
+  {
+    const char *s = buf_ + loc + lcp;
+    const char *e = buf_ + end_ + lcp - len - min + 1;
+    __m256i vlcp = _mm256_set1_epi8(chlcp);
+    __m256i vlcs = _mm256_set1_epi8(chlcs);
+    __m256i vmklcp = _mm256_set1_epi8(mklcp);
+    __m256i vmklcs = _mm256_set1_epi8(mklcs);
+    while (s <= e - 32)
+    {
+      __m256i vlcpm = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s)), vmklcp);
+      __m256i vlcsm = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + lcs - lcp)), vmklcs);
+      __m256i vlcpeq = _mm256_cmpeq_epi8(vlcp, vlcpm);
+      __m256i vlcseq = _mm256_cmpeq_epi8(vlcs, vlcsm);
+      uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(vlcpeq, vlcseq));
+      while (REFLEX_UNLIKELY(mask != 0))
+      {
+        uint32_t offset = ctz(mask);
+        if (icase_equal(s - lcp + offset, chr, len))
+        {
+          size_t k = s - lcp + offset - buf_;
+          if (REFLEX_UNLIKELY(k + len + Pattern::Const::PM_M > end_) || pat_->predict_match(&buf_[k + len]))
+          {
+            set_current(k);
+            return true;
+          }
+        }
+        mask &= mask - 1;
+      }
+      s += 32;
+    }
+    while (s < e)
+    {
+      if ((*s | mklcp) == chlcp && (s[lcs - lcp] | mklcs) == chlcs && icase_equal(s - lcp, chr, len))
+      {
+        size_t k = s - lcp - buf_;
+        if (REFLEX_UNLIKELY(k + len + Pattern::Const::PM_M > end_) || pat_->predict_match(&buf_[k + len]))
+        {
+          set_current(k);
+          return true;
+        }
+      }
+      ++s;
+    }
+    loc = s - lcp - buf_;
+    set_current_and_peek_more(loc);
+    loc = cur_;
+    if (loc + len + min > end_ && eof_)
+      return false;
+  }
+}
+
 #else
 
 // appease ranlib "has no symbols"
@@ -53,6 +53,13 @@ void Matcher::simd_init_advance_avx512bw()
   {
     // no specialization
   }
+  else if (pat_->icp_)
+  {
+    if (pat_->min_ == 0)
+      adv_ = &Matcher::simd_advance_string_icase_avx512bw;
+    else
+      adv_ = &Matcher::simd_advance_string_icase_pma_avx512bw;
+  }
   else if (pat_->len_ == 1)
   {
     // no specialization
@@ -326,6 +333,123 @@ bool Matcher::simd_advance_string_pma_avx512bw(size_t loc)
   }
 }
 
+/// Implements AVX512BW string search scheme based on http://0x80.pl/articles/simd-friendly-karp-rabin.html with case folding
+bool Matcher::simd_advance_string_icase_avx512bw(size_t loc)
+{
+  const char *chr = pat_->chr_;
+  const uint16_t len = pat_->len_;
+  const uint16_t lcp = pat_->lcp_;
+  const uint16_t lcs = pat_->lcs_;
+  const char chlcp = chr[lcp];
+  const char chlcs = chr[lcs];
+  const char mklcp = icase_mask(chlcp);
+  const char mklcs = icase_mask(chlcs);
+  while (true)
+  {
+    const char *s = buf_ + loc + lcp;
+    const char *e = buf_ + end_ + lcp - len + 1;
+    __m512i vlcp = _mm512_set1_epi8(chlcp);
+    __m512i vlcs = _mm512_set1_epi8(chlcs);
+    __m512i vmklcp = _mm512_set1_epi8(mklcp);
+    __m512i vmklcs = _mm512_set1_epi8(mklcs);
+    while (s <= e - 64)
+    {
+      __m512i vlcpm = _mm512_or_si512(_mm512_loadu_si512(reinterpret_cast<const __m512i*>(s)), vmklcp);
+      __m512i vlcsm = _mm512_or_si512(_mm512_loadu_si512(reinterpret_cast<const __m512i*>(s + lcs - lcp)), vmklcs);
+      uint64_t mask = _mm512_cmpeq_epi8_mask(vlcp, vlcpm) & _mm512_cmpeq_epi8_mask(vlcs, vlcsm);
+      while (REFLEX_UNLIKELY(mask != 0))
+      {
+        uint32_t offset = ctzl(mask);
+        if (icase_equal(s - lcp + offset, chr, len))
+        {
+          size_t k = s - lcp + offset - buf_;
+          set_current(k);
+          return true;
+        }
+        mask &= mask - 1;
+      }
+      s += 64;
+    }
+    while (s < e)
+    {
+      if ((*s | mklcp) == chlcp && (s[lcs - lcp] | mklcs) == chlcs && icase_equal(s - lcp, chr, len))
+      {
+        size_t k = s - lcp - buf_;
+        set_current(k);
+        return true;
+      }
+      ++s;
+    }
+    loc = s - lcp - buf_;
+    set_current_and_peek_more(loc);
+    loc = cur_;
+    if (loc + len > end_ && eof_)
+      return false;
+  }
+}
+
+/// Implements AVX512BW string search scheme based on http://0x80.pl/articles/simd-friendly-karp-rabin.html with case folding
+bool Matcher::simd_advance_string_icase_pma_avx512bw(size_t loc)
+{
+  const char *chr = pat_->chr_;
+  const uint16_t len = pat_->len_;
+  const uint16_t min = pat_->min_;
+  const uint16_t lcp = pat_->lcp_;
+  const uint16_t lcs = pat_->lcs_;
+  const char chlcp = chr[lcp];
+  const char chlcs = chr[lcs];
+  const char mklcp = icase_mask(chlcp);
+  const char mklcs = icase_mask(chlcs);
+  while (true)
+  {
+    const char *s = buf_ + loc + lcp;
+    const char *e = buf_ + end_ + lcp - len - min + 1;
+    __m512i vlcp = _mm512_set1_epi8(chlcp);
+    __m512i vlcs = _mm512_set1_epi8(chlcs);
+    __m512i vmklcp = _mm512_set1_epi8(mklcp);
+    __m512i vmklcs = _mm512_set1_epi8(mklcs);
+    while (s <= e - 64)
+    {
+      __m512i vlcpm = _mm512_or_si512(_mm512_loadu_si512(reinterpret_cast<const __m512i*>(s)), vmklcp);
+      __m512i vlcsm = _mm512_or_si512(_mm512_loadu_si512(reinterpret_cast<const __m512i*>(s + lcs - lcp)), vmklcs);
+      uint64_t mask = _mm512_cmpeq_epi8_mask(vlcp, vlcpm) & _mm512_cmpeq_epi8_mask(vlcs, vlcsm);
+      while (REFLEX_UNLIKELY(mask != 0))
+      {
+        uint32_t offset = ctzl(mask);
+        if (icase_equal(s - lcp + offset, chr, len))
+        {
+          size_t k = s - lcp + offset - buf_;
+          if (REFLEX_UNLIKELY(k + len + Pattern::Const::PM_M > end_) || pat_->predict_match(&buf_[k + len]))
+          {
+            set_current(k);
+            return true;
+          }
+        }
+        mask &= mask - 1;
+      }
+      s += 64;
+    }
+    while (s < e)
+    {
+      if ((*s | mklcp) == chlcp && (s[lcs - lcp] | mklcs) == chlcs && icase_equal(s - lcp, chr, len))
+      {
+        size_t k = s - lcp - buf_;
+        if (REFLEX_UNLIKELY(k + len + Pattern::Const::PM_M > end_) || pat_->predict_match(&buf_[k + len]))
+        {
+          set_current(k);
+          return true;
+        }
+      }
+      ++s;
+    }
+    loc = s - lcp - buf_;
+    set_current_and_peek_more(loc);
+    loc = cur_;
+    if (loc + len + min > end_ && eof_)
+      return false;
+  }
+}
+
 #else
 
 // appease ranlib "has no symbols"
@@ -38,9 +38,11 @@
 #include <reflex/simd.h>
 #include <reflex/timer.h>
 #include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cerrno>
 #include <cmath>
+#include <mutex>
 
 /// DFA compaction: -1 == reverse order edge compression (best); 1 == edge compression; 0 == no edge compression.
 /** Edge compression reorders edges to produce fewer tests when executed in the compacted order.
@@ -158,6 +160,51 @@ static uint8_t gethex(const char *& ptr)
 }
 #endif
 
+/// Predictor tables tap[] and pma[] allocated on demand, identical tables are shared among patterns by reference counting.
+struct Pattern::Tables {
+  typedef std::multimap<size_t,Tables*> Pool;
+  Tables(bool has_tap, bool has_pma)
+    :
+      ref(1),
+      key(0),
+      shared(false),
+      tap(has_tap ? Const::BTAP : 0),
+#ifdef WITH_BITAP_AVX2
+#if defined(HAVE_AVX512BW) || defined(HAVE_AVX2) || defined(HAVE_SSE2)
+      vtp(has_tap ? 4 * Const::BTAP : 0),
+#endif
+#endif
+      pma(has_pma ? Const::HASH : 0)
+  { }
+  /// pool of shared tables indexed by the hash key of their contents.
+  static Pool& pool()
+  {
+    static Pool pool;
+    return pool;
+  }
+  /// mutex to access the pool of shared tables and to release shared tables.
+  static std::mutex& mutex()
+  {
+    static std::mutex mutex;
+    return mutex;
+  }
+  /// return true if the contents of the tables are identical.
+  bool same(const Tables& tables) const
+  {
+    return tap == tables.tap && pma == tables.pma;
+  }
+  std::atomic<size_t>   ref;    ///< reference count
+  size_t                key;    ///< hash key of the contents when shared
+  bool                  shared; ///< true if added to the pool of shared tables
+  std::vector<Bitap>    tap;    ///< bitap hashed character pairs array or empty
+#ifdef WITH_BITAP_AVX2
+#if defined(HAVE_AVX512BW) || defined(HAVE_AVX2) || defined(HAVE_SSE2)
+  std::vector<uint16_t> vtp;    ///< AVX2 vectorized bitap hashed character pairs array or empty
+#endif
+#endif
+  std::vector<Pred>     pma;    ///< predict-match array or empty
+};
+
 const std::string Pattern::operator[](Accept choice) const
 {
   if (choice == 0)
@@ -185,6 +232,11 @@ void Pattern::error(regex_error_type code, size_t pos) const
 void Pattern::init(const char *options, const char *pred)
 {
   init_options(options);
+  init_pattern(pred);
+}
+
+void Pattern::init_pattern(const char *pred)
+{
   nop_ = 0;
   len_ = 0;
   min_ = 0;
@@ -194,7 +246,11 @@ void Pattern::init(const char *options, const char *pred)
   bmd_ = 0;
   npy_ = 0;
   one_ = false;
+  icp_ = false;
   bol_ = false;
+  lap_ = true;
+  idt_ = true;
+  mta_ = true;
   vno_ = 0;
   eno_ = 0;
   hno_ = 0;
@@ -208,6 +264,9 @@ void Pattern::init(const char *options, const char *pred)
   lbm_ = 0;
   cbk_.reset();
   fst_.reset();
+  est_ = Estimate();
+  dmu_ = 0;
+  release_tables();
   if (opc_ != NULL || fsm_ != NULL )
   {
     if (pred != NULL)
@@ -218,6 +277,9 @@ void Pattern::init(const char *options, const char *pred)
       min_ = mode & 0x0f;
       one_ = mode & 0x10;
       bol_ = mode & 0x40;
+      icp_ = mode & 0x80;
+      // allocate the predictor tables that are stored
+      alloc_tables(len_ == 0, len_ == 0 || min_ > 0);
       if (len_ == 0)
       {
         // load bit_[] parameters
@@ -317,6 +379,11 @@ void Pattern::init(const char *options, const char *pred)
       throw regex_error::load_tables;
 #endif
     }
+    else
+    {
+      // no predictor tables: predict a possible match at every position
+      std::memset(bit_, 0, sizeof(bit_));
+    }
   }
   else
   {
@@ -327,6 +394,8 @@ void Pattern::init(const char *options, const char *pred)
     Map       lookahead;
     // parse the regex pattern to construct the followpos NFA without epsilon transitions
     parse(startpos, followpos, lazypos, modifiers, lookahead);
+    // estimate the complexity of the pattern before constructing its DFA
+    init_estimate(startpos, followpos);
     // start state = startpos = firstpost of the followpos NFA, also merge the tree DFA root when non-NULL
 #ifdef WITH_TREE_DFA
     DFA::State *start;
@@ -366,9 +435,41 @@ void Pattern::init(const char *options, const char *pred)
     // compile the NFA into a DFA
     compile(start, followpos, lazypos, modifiers, lookahead);
 #endif
-    // assemble DFA opcode tables or direct code
-    assemble(start);
-    // delete the DFA
+    if (!nfa_.empty())
+    {
+      // the DFA grew too large and was abandoned, match with FSM code that simulates the bit-parallel NFA
+      fsm_ = match_nfa;
+      analyze_nfa();
+    }
+    else
+    {
+      // assemble DFA opcode tables or direct code
+      assemble(start);
+      // check for lookaheads, indent anchors, and other meta edges in the opcode table, to specialize the matcher when there are none
+      lap_ = false;
+      idt_ = false;
+      mta_ = false;
+    }
+    for (Index i = 0; i < nop_; ++i)
+    {
+      Opcode opcode = opc_[i];
+      if (is_opcode_head(opcode) || is_opcode_tail(opcode))
+      {
+        lap_ = true;
+      }
+      else if (is_opcode_redo(opcode))
+      {
+        mta_ = true;
+      }
+      else if (!is_opcode_goto(opcode) && !is_opcode_take(opcode) && !is_opcode_long(opcode) && is_opcode_meta(opcode))
+      {
+        mta_ = true;
+        if (meta_of(opcode) >= META_UND)
+          idt_ = true;
+      }
+    }
+    // delete the DFA, after recording the memory it held
+    dmu_ = dfa_.bytes() + tfa_.bytes();
     dfa_.clear();
     // delete the tree DFA
     tfa_.clear();
@@ -594,6 +695,9 @@ void Pattern::init(const char *options, const char *pred)
       score += bms_[static_cast<uint8_t>(chr_[i])];
     score /= n;
     uint8_t fch = frequency(static_cast<uint8_t>(chr_[lcp_]));
+    // a case-insensitive prefix string is never searched with B-M
+    if (icp_)
+      score = 0;
 #if defined(HAVE_AVX512BW) || defined(HAVE_AVX2) || defined(HAVE_SSE2)
     if (!have_HW_SSE2() && !have_HW_AVX2() && !have_HW_AVX512BW())
     {
@@ -641,14 +745,298 @@ void Pattern::init(const char *options, const char *pred)
     }
     DBGLOG("len=%hu min=%hu bmd=%hu lcp=%hu(%hu)", len_, min_, bmd_, lcp_, lcs_);
   }
+  // keep only the predictor tables used by the matcher and share them with patterns that have identical tables
+  trim_tables();
+}
+
+void Pattern::copy_predictor(const Pattern& pattern)
+{
+  cut_ = pattern.cut_;
+  len_ = pattern.len_;
+  min_ = pattern.min_;
+  pin_ = pattern.pin_;
+  cbk_ = pattern.cbk_;
+  fst_ = pattern.fst_;
+  std::memcpy(chr_, pattern.chr_, sizeof(chr_));
+  std::memcpy(bit_, pattern.bit_, sizeof(bit_));
+  if (pattern.tbl_ != tbl_)
+  {
+    release_tables();
+    if (pattern.tbl_ != NULL)
+    {
+      // share the predictor tables
+      ++pattern.tbl_->ref;
+      tbl_ = pattern.tbl_;
+      tap_ = pattern.tap_;
+#ifdef WITH_BITAP_AVX2
+#if defined(HAVE_AVX512BW) || defined(HAVE_AVX2) || defined(HAVE_SSE2)
+      vtp_ = pattern.vtp_;
+#endif
+#endif
+      pma_ = pattern.pma_;
+    }
+  }
+  lbk_ = pattern.lbk_;
+  lbm_ = pattern.lbm_;
+  lcp_ = pattern.lcp_;
+  lcs_ = pattern.lcs_;
+  bmd_ = pattern.bmd_;
+  std::memcpy(bms_, pattern.bms_, sizeof(bms_));
+  npy_ = pattern.npy_;
+  one_ = pattern.one_;
+  icp_ = pattern.icp_;
+  bol_ = pattern.bol_;
+  lap_ = pattern.lap_;
+  idt_ = pattern.idt_;
+  mta_ = pattern.mta_;
+}
+
+void Pattern::alloc_tables(bool tap, bool pma)
+{
+  release_tables();
+  if (!tap && !pma)
+    return;
+  tbl_ = new Tables(tap, pma);
+  if (tap)
+  {
+    tap_ = &tbl_->tap[0];
+#ifdef WITH_BITAP_AVX2
+#if defined(HAVE_AVX512BW) || defined(HAVE_AVX2) || defined(HAVE_SSE2)
+    vtp_ = &tbl_->vtp[0];
+#endif
+#endif
+  }
+  if (pma)
+    pma_ = &tbl_->pma[0];
+}
+
+void Pattern::trim_tables()
+{
+  if (tbl_ == NULL)
+  {
+    // no predictor tables were stored or produced, predict a possible match at every position
+    if (len_ == 0)
+      alloc_tables(true, true);
+  }
+  else if (!tbl_->shared)
+  {
+    // strings are matched without the bitap tables and without predict-match when min_ == 0
+    if (len_ > 0)
+    {
+      std::vector<Bitap>().swap(tbl_->tap);
+      tap_ = NULL;
+#ifdef WITH_BITAP_AVX2
+#if defined(HAVE_AVX512BW) || defined(HAVE_AVX2) || defined(HAVE_SSE2)
+      std::vector<uint16_t>().swap(tbl_->vtp);
+      vtp_ = NULL;
+#endif
+#endif
+      if (min_ == 0)
+      {
+        std::vector<Pred>().swap(tbl_->pma);
+        pma_ = NULL;
+      }
+    }
+  }
+  if (tbl_ != NULL && tbl_->tap.empty() && tbl_->pma.empty())
+    release_tables();
+  else
+    share_tables();
+}
+
+void Pattern::share_tables()
+{
+  if (tbl_ == NULL || tbl_->shared)
+    return;
+  // FNV-1a hash of the table contents
+  size_t key = 2166136261U;
+  const uint8_t *tap = tbl_->tap.empty() ? NULL : reinterpret_cast<const uint8_t*>(&tbl_->tap[0]);
+  for (size_t i = 0; i < tbl_->tap.size() * sizeof(Bitap); ++i)
+    key = (key ^ tap[i]) * 16777619U;
+  const uint8_t *pma = tbl_->pma.empty() ? NULL : reinterpret_cast<const uint8_t*>(&tbl_->pma[0]);
+  for (size_t i = 0; i < tbl_->pma.size() * sizeof(Pred); ++i)
+    key = (key ^ pma[i]) * 16777619U;
+  key ^= tbl_->tap.size() ^ (tbl_->pma.size() << 1);
+  std::lock_guard<std::mutex> lock(Tables::mutex());
+  std::pair<Tables::Pool::iterator,Tables::Pool::iterator> range = Tables::pool().equal_range(key);
+  for (Tables::Pool::iterator i = range.first; i != range.second; ++i)
+  {
+    if (i->second->same(*tbl_))
+    {
+      // share the identical tables, this pattern owns the only reference to its own tables
+      Tables *tables = i->second;
+      ++tables->ref;
+      delete tbl_;
+      tbl_ = tables;
+      tap_ = tables->tap.empty() ? NULL : &tables->tap[0];
+#ifdef WITH_BITAP_AVX2
+#if defined(HAVE_AVX512BW) || defined(HAVE_AVX2) || defined(HAVE_SSE2)
+      vtp_ = tables->vtp.empty() ? NULL : &tables->vtp[0];
+#endif
+#endif
+      pma_ = tables->pma.empty() ? NULL : &tables->pma[0];
+      return;
+    }
+  }
+  tbl_->key = key;
+  tbl_->shared = true;
+  Tables::pool().insert(Tables::Pool::value_type(key, tbl_));
+}
+
+void Pattern::release_tables()
+{
+  if (tbl_ != NULL)
+  {
+    if (tbl_->shared)
+    {
+      // shared tables are released while locked to prevent reuse from the pool when the last reference is released
+      std::lock_guard<std::mutex> lock(Tables::mutex());
+      if (--tbl_->ref == 0)
+      {
+        std::pair<Tables::Pool::iterator,Tables::Pool::iterator> range = Tables::pool().equal_range(tbl_->key);
+        for (Tables::Pool::iterator i = range.first; i != range.second; ++i)
+        {
+          if (i->second == tbl_)
+          {
+            Tables::pool().erase(i);
+            break;
+          }
+        }
+        delete tbl_;
+      }
+    }
+    else if (--tbl_->ref == 0)
+    {
+      delete tbl_;
+    }
+  }
+  tbl_ = NULL;
+  tap_ = NULL;
+#ifdef WITH_BITAP_AVX2
+#if defined(HAVE_AVX512BW) || defined(HAVE_AVX2) || defined(HAVE_SSE2)
+  vtp_ = NULL;
+#endif
+#endif
+  pma_ = NULL;
+}
+
+Pattern::Accept Pattern::add(const char *regex)
+{
+  if (nop_ == 0 && nfa_.empty() && !empty())
+    throw regex_error("cannot add to a pattern without a regex", rex_);
+  Accept choice = 1;
+  std::string rex(rex_);
+  if (!rex.empty())
+  {
+    choice = size() + 1;
+    rex.push_back('|');
+  }
+  rex.append(regex);
+  rebuild(rex);
+  return choice;
+}
+
+Pattern& Pattern::remove(Accept choice)
+{
+  if (choice < 1 || choice > size())
+    return *this;
+  if (nop_ == 0 && nfa_.empty() && !empty())
+    throw regex_error("cannot remove from a pattern without a regex", rex_);
+  if (opt_.b || opt_.e > 255)
+    throw regex_error("cannot remove from a pattern without bracket list escapes", rex_);
+  Location loc = 0;
+  if (choice >= 2)
+  {
+    loc = end_.at(choice - 2) + 1;
+  }
+  else
+  {
+    // keep the (?imsux) directives that apply to the pattern as a whole
+    while (at(loc) == '(' && at(loc + 1) == '?')
+    {
+      Location back = loc;
+      loc += 2;
+      while (at(loc) == '-' || std::isalnum(at(loc)))
+        ++loc;
+      if (at(loc) != ')')
+      {
+        loc = back;
+        break;
+      }
+      ++loc;
+    }
+  }
+  Location end = end_.at(choice - 1);
+  // replace the subpattern with an empty bracket list that never matches, to keep the subpattern indexes unchanged
+  std::string none("[^");
+  none.push_back(static_cast<char>(opt_.e));
+  none.append("x00-");
+  none.push_back(static_cast<char>(opt_.e));
+  none.append("xff]");
+  if (choice >= 2 && choice == size())
+  {
+    // no indexes follow the last subpattern: drop it with the placeholders of removed subpatterns before it
+    Accept last = choice - 1;
+    while (last >= 2 && rex_.compare(end_.at(last - 2) + 1, end_.at(last - 1) - end_.at(last - 2) - 1, none) == 0)
+      --last;
+    rebuild(std::string(rex_, 0, end_.at(last - 1)).append(rex_, end, std::string::npos));
+  }
+  else if (rex_.compare(loc, end - loc, none) != 0)
+  {
+    rebuild(std::string(rex_, 0, loc).append(none).append(rex_, end, std::string::npos));
+  }
+  return *this;
+}
+
+void Pattern::rebuild(const std::string& regex)
+{
+  std::string rex(rex_);
+  clear();
+  rex_ = regex;
+  try
+  {
+    init_pattern();
+  }
+  catch (...)
+  {
+    // restore this pattern before rethrowing the error
+    clear();
+    rex_ = rex;
+    init_pattern();
+    throw;
+  }
+}
+
+Pattern *Pattern::clone_dfa() const
+{
+  // construct the DFA of this pattern that is matched with the bit-parallel NFA, for matchers that walk the DFA opcode table
+  Pattern *pattern = new Pattern();
+  pattern->clear();
+  pattern->opt_ = opt_;
+  pattern->opt_.d = true;
+  pattern->opt_.l = 0;
+  pattern->opt_.f.clear();
+  pattern->rex_ = rex_;
+  try
+  {
+    pattern->init_pattern();
+  }
+  catch (...)
+  {
+    delete pattern;
+    throw;
+  }
+  return pattern;
 }
 
 void Pattern::init_options(const char *options)
 {
   opt_.b = false;
+  opt_.d = false;
   opt_.h = false;
   opt_.g = 0;
   opt_.i = false;
+  opt_.l = 0;
   opt_.m = false;
   opt_.o = false;
   opt_.p = false;
@@ -667,6 +1055,9 @@ void Pattern::init_options(const char *options)
         case 'b':
           opt_.b = true;
           break;
+        case 'd':
+          opt_.d = true;
+          break;
         case 'e':
           opt_.e = (*(s += (s[1] == '=') + 1) == ';' || *s == '\0' ? 256 : *s++);
           --s;
@@ -680,6 +1071,13 @@ void Pattern::init_options(const char *options)
         case 'i':
           opt_.i = true;
           break;
+        case 'l':
+          {
+            char *t;
+            opt_.l = std::strtoul(s + 1 + (s[1] == '='), &t, 10);
+            s = t - 1;
+          }
+          break;
         case 'm':
           opt_.m = true;
           break;
@@ -704,17 +1102,22 @@ void Pattern::init_options(const char *options)
         case 'x':
           opt_.x = true;
           break;
+        case 'v':
+        case 'y':
         case 'z':
-          for (const char *t = s += (s[1] == '='); *s != ';' && *s != '\0'; ++t)
           {
-            if (std::isspace(static_cast<unsigned char>(*t)) || *t == ';' || *t == '\0')
+            std::string& value = *s == 'v' ? opt_.v : *s == 'y' ? opt_.y : opt_.z;
+            for (const char *t = s += (s[1] == '='); *s != ';' && *s != '\0'; ++t)
             {
-              if (t > s + 1)
-                opt_.z = std::string(s + 1, t - s - 1);
-              s = t;
+              if (std::isspace(static_cast<unsigned char>(*t)) || *t == ';' || *t == '\0')
+              {
+                if (t > s + 1)
+                  value = std::string(s + 1, t - s - 1);
+                s = t;
+              }
             }
+            --s;
           }
-          --s;
           break;
         case 'f':
         case 'n':
@@ -1756,7 +2159,21 @@ void Pattern::compile(
     table[hash_pos(start)] = start;
   // last added state
   DFA::State *last_state = start;
-  for (DFA::State *state = start; state != NULL; state = state->next)
+  // number of states constructed and their total number of positions
+  Index states = 0;
+  size_t sizes = 0;
+  // the DFA is constructed breadth-first by levels, the last state of the current level and the number of states per level
+  DFA::State *level = start;
+  std::vector<Index> widths(1, 1);
+#ifndef WITH_NO_CODEGEN
+  // simulate the NFA instead of a DFA that grows too large when the pattern has no anchors, lookaheads, and lazy quantifiers
+  bool nfa = !opt_.d && !opt_.h && opt_.f.empty() && lazypos.empty();
+  for (Map::const_iterator i = lookahead.begin(); nfa && i != lookahead.end(); ++i)
+    nfa = i->second.empty();
+#endif
+  // the DFA is estimated to exceed the limit on the number of states
+  bool exceeds = opt_.l > 0 && est_.states > opt_.l;
+  for (DFA::State *state = start; state != NULL && !exceeds; state = state->next)
   {
     Moves moves;
     timer_start(et);
@@ -2257,12 +2674,588 @@ void Pattern::compile(
     ++vno_;
     if (vno_ > DFA::MAX_STATES)
       error(regex_error::exceeds_limits, rex_.size());
+    ++states;
+    sizes += state->size();
+    if (state == level)
+    {
+      // the next level is constructed, estimate the number of states from the growth of the levels
+      Index width = 0;
+      for (DFA::State *next = state; next != last_state; next = next->next)
+        ++width;
+      widths.push_back(width);
+      level = last_state;
+      if (states >= DFA::EST_STATES || width == 0)
+        update_estimate(widths, states, sizes);
+      exceeds = opt_.l > 0 && states >= DFA::EST_STATES && est_.states > opt_.l;
+#ifndef WITH_NO_CODEGEN
+      // the DFA is estimated to grow far beyond DFA::NFA_STATES: simulate the NFA instead without constructing DFA::NFA_STATES states first
+      if (states >= DFA::EST_STATES && est_.states >= DFA::NFA_EST_STATES && nfa && compile_nfa(start, followpos, lazypos, modifiers, lookahead))
+        break;
+#endif
+    }
+    if (opt_.l > 0 && states > opt_.l)
+      exceeds = true;
+#ifndef WITH_NO_CODEGEN
+    // the DFA grows too large: simulate the NFA instead
+    if (states == DFA::NFA_STATES && nfa && compile_nfa(start, followpos, lazypos, modifiers, lookahead))
+      break;
+#endif
+  }
+  if (exceeds && nfa_.empty())
+  {
+    // the DFA exceeds the limit: simulate the NFA instead when possible, otherwise fail early
+#ifndef WITH_NO_CODEGEN
+    if (!nfa || !compile_nfa(start, followpos, lazypos, modifiers, lookahead))
+#endif
+    {
+      delete[] table;
+      error(regex_error::exceeds_limits, rex_.size());
+    }
   }
   delete[] table;
   vms_ = timer_elapsed(vt) - ems_;
   DBGLOG("END compile()");
 }
 
+bool Pattern::compile_nfa(
+    const DFA::State *start,
+    Follow&           followpos,
+    const Lazypos&    lazypos,
+    const Mods        modifiers,
+    const Map&        lookahead)
+{
+  DBGLOG("BEGIN compile_nfa()");
+  // enumerate the positions reachable from the start state with the character class and follow set of each position
+  std::map<Position,size_t> index;
+  Positions positions;
+  std::vector<Chars> chars;
+  std::vector<std::vector<size_t> > follow;
+  std::vector<size_t> first;
+  size_t accepts = 0;
+  for (Positions::const_iterator p = start->begin(); p != start->end(); ++p)
+  {
+    std::pair<std::map<Position,size_t>::iterator,bool> i = index.insert(std::pair<Position,size_t>(*p, positions.size()));
+    if (i.second)
+      positions.push_back(*p);
+    first.push_back(i.first->second);
+  }
+  for (size_t i = 0; i < positions.size(); ++i)
+  {
+    if (positions.size() > NFA::MAX_EXPAND)
+      return false;
+    Position p = positions[i];
+    if (p.negate() || p.lazy())
+      return false;
+    chars.push_back(Chars());
+    follow.push_back(std::vector<size_t>());
+    if (p.accept())
+    {
+      ++accepts;
+      continue;
+    }
+    // a single position moves on one character class to its follow set, or the DFA is required after all
+    DFA::State state;
+    state.push_back(p);
+    Moves moves;
+    compile_transition(&state, followpos, lazypos, modifiers, lookahead, moves);
+    if (!state.heads.empty() || !state.tails.empty() || state.redo || moves.size() > 1)
+      return false;
+    if (moves.empty())
+      continue;
+    if (moves.front().first.b[4] != 0)
+      return false; // meta characters of anchors and word boundaries
+    chars[i] = moves.front().first;
+    const Positions& pos = moves.front().second;
+    for (Positions::const_iterator q = pos.begin(); q != pos.end(); ++q)
+    {
+      std::pair<std::map<Position,size_t>::iterator,bool> j = index.insert(std::pair<Position,size_t>(*q, positions.size()));
+      if (j.second)
+        positions.push_back(*q);
+      follow[i].push_back(j.first->second);
+    }
+  }
+  // collapse each chain of positions x.0 -> x.1 -> ... -> x.(m-1) of repeats x{n,m} of a position x into a counter position
+  size_t enumerated = positions.size();
+  std::vector<size_t> succ(enumerated, SIZE_MAX);
+  std::vector<size_t> pred(enumerated, SIZE_MAX);
+  for (size_t i = 0; i < enumerated; ++i)
+  {
+    Position p = positions[i];
+    if (p.accept() || !chars[i].any() || p.iter() == Position::MAXITER)
+      continue;
+    std::map<Position,size_t>::const_iterator j = index.find(p.iter(1));
+    if (j != index.end() && chars[j->second] == chars[i] && std::find(follow[i].begin(), follow[i].end(), j->second) != follow[i].end())
+    {
+      succ[i] = j->second;
+      pred[j->second] = i;
+    }
+  }
+  std::vector<std::vector<size_t> > chains;
+  std::vector<size_t> chain(enumerated, SIZE_MAX);
+  std::vector<size_t> rank(enumerated, 0);
+  for (size_t i = 0; i < enumerated; ++i)
+  {
+    if (pred[i] != SIZE_MAX || succ[i] == SIZE_MAX)
+      continue;
+    std::vector<size_t> links;
+    for (size_t j = i; j != SIZE_MAX; j = succ[j])
+      links.push_back(j);
+    if (links.size() < NFA::MIN_REPEAT)
+      continue;
+    for (size_t r = 0; r < links.size(); ++r)
+    {
+      chain[links[r]] = chains.size();
+      rank[links[r]] = r;
+    }
+    chains.push_back(links);
+  }
+  // a chain is counted when its positions after the first are only reached from their predecessor, or from itself at the end of x{n,}
+  std::vector<bool> counted(chains.size(), true);
+  for (std::vector<size_t>::const_iterator j = first.begin(); j != first.end(); ++j)
+    if (*j < enumerated && chain[*j] != SIZE_MAX && rank[*j] > 0)
+      counted[chain[*j]] = false;
+  for (size_t i = 0; i < enumerated; ++i)
+    for (std::vector<size_t>::const_iterator j = follow[i].begin(); j != follow[i].end(); ++j)
+      if (chain[*j] != SIZE_MAX && rank[*j] > 0 && (chain[i] != chain[*j] || (rank[i] + 1 != rank[*j] && (i != *j || rank[i] + 1 != chains[chain[i]].size()))))
+        counted[chain[*j]] = false;
+  std::vector<bool> removed(enumerated, false);
+  std::vector<NFA::Counter> counters;
+  for (size_t k = 0; k < chains.size(); ++k)
+  {
+    if (!counted[k])
+      continue;
+    const std::vector<size_t>& links = chains[k];
+    size_t m = links.size();
+    NFA::Counter counter;
+    counter.pos = links[0];
+    counter.lo = SIZE_MAX;
+    counter.hi = m - 1;
+    counter.inf = std::find(follow[links[m - 1]].begin(), follow[links[m - 1]].end(), links[m - 1]) != follow[links[m - 1]].end();
+    counter.off = 0;
+    // the follow sets of x.0 to x.(m-1) without the chain links are empty up to x.lo and then identical to the follow set of the counter
+    std::vector<size_t> exit;
+    for (size_t r = 0; r < m && counted[k]; ++r)
+    {
+      std::vector<size_t> rest;
+      for (std::vector<size_t>::const_iterator j = follow[links[r]].begin(); j != follow[links[r]].end(); ++j)
+        if (r + 1 < m ? *j != links[r + 1] : !counter.inf || *j != links[r])
+          rest.push_back(*j);
+      std::sort(rest.begin(), rest.end());
+      if (counter.lo == SIZE_MAX)
+      {
+        if (!rest.empty())
+        {
+          counter.lo = r;
+          exit.swap(rest);
+        }
+      }
+      else if (rest != exit)
+      {
+        counted[k] = false;
+      }
+    }
+    if (!counted[k] || counter.lo == SIZE_MAX)
+      continue;
+    follow[links[0]].swap(exit);
+    for (size_t r = 1; r < m; ++r)
+      removed[links[r]] = true;
+    counters.push_back(counter);
+  }
+#ifdef WITH_TREE_DFA
+  if (start->tnode != NULL)
+  {
+    // the tree DFA of the string patterns adds a position for each tree DFA edge, which moves on the edge char to the next edges
+    std::vector<std::pair<const DFA::State*,size_t> > stack(1, std::pair<const DFA::State*,size_t>(start->tnode, SIZE_MAX));
+    while (!stack.empty())
+    {
+      const DFA::State *node = stack.back().first;
+      size_t k = stack.back().second;
+      stack.pop_back();
+      if (node->accept > 0)
+      {
+        std::pair<std::map<Position,size_t>::iterator,bool> j = index.insert(std::pair<Position,size_t>(Position(node->accept).accept(true), positions.size()));
+        if (j.second)
+        {
+          positions.push_back(j.first->first);
+          chars.push_back(Chars());
+          follow.push_back(std::vector<size_t>());
+          ++accepts;
+        }
+        (k == SIZE_MAX ? first : follow[k]).push_back(j.first->second);
+      }
+      for (DFA::State::Edges::const_iterator t = node->edges.begin(); t != node->edges.end(); ++t)
+      {
+        if (positions.size() >= NFA::MAX_EXPAND)
+          return false;
+        Char c = t->first;
+        (k == SIZE_MAX ? first : follow[k]).push_back(positions.size());
+        stack.push_back(std::pair<const DFA::State*,size_t>(t->second.second, positions.size()));
+        positions.push_back(Position());
+        chars.push_back(Chars());
+        chars.back().add(c);
+        if (opt_.i && islowercase(c))
+          chars.back().add(uppercase(c));
+        follow.push_back(std::vector<size_t>());
+      }
+    }
+  }
+#else
+  if (start->tnode != NULL)
+    return false;
+#endif
+  // number the accepting positions first ordered by their accept index, then the other positions except for the collapsed chains
+  removed.resize(positions.size(), false);
+  std::vector<std::pair<Accept,size_t> > order;
+  order.reserve(positions.size());
+  for (size_t i = 0; i < positions.size(); ++i)
+    if (positions[i].accept())
+      order.push_back(std::pair<Accept,size_t>(positions[i].accepts(), i));
+  std::sort(order.begin(), order.end());
+  for (size_t i = 0; i < positions.size(); ++i)
+    if (!positions[i].accept() && !removed[i])
+      order.push_back(std::pair<Accept,size_t>(0, i));
+  size_t n = order.size();
+  if (n > NFA::MAX_POSITIONS)
+    return false;
+  std::vector<size_t> number(positions.size(), SIZE_MAX);
+  for (size_t i = 0; i < n; ++i)
+    number[order[i].second] = i;
+  size_t w = (n + 63) / 64;
+  nfa_.size = n;
+  nfa_.words = w;
+  nfa_.chr.assign(256 * w, 0);
+  nfa_.ini.assign(w, 0);
+  nfa_.acc.resize(accepts);
+  for (size_t i = 0; i < accepts; ++i)
+  {
+    nfa_.acc[i] = order[i].first;
+    if (nfa_.acc[i] > 0 && nfa_.acc[i] <= end_.size())
+      acc_[nfa_.acc[i] - 1] = true;
+  }
+  for (size_t k = 0; k < n; ++k)
+  {
+    const Chars& chr = chars[order[k].second];
+    if (chr.any())
+      for (Char c = chr.lo(); c <= chr.hi(); ++c)
+        if (chr.contains(c))
+          nfa_.chr[c * w + k / 64] |= 1ULL << (k % 64);
+  }
+  for (std::vector<size_t>::const_iterator i = first.begin(); i != first.end(); ++i)
+  {
+    size_t k = number[*i];
+    nfa_.ini[k / 64] |= 1ULL << (k % 64);
+  }
+  // the follow set of each position, tabulated per byte of a state set when the NFA is small
+  std::vector<NFA::Word> fol(n * w, 0);
+  for (size_t k = 0; k < n; ++k)
+  {
+    NFA::Word *set = &fol[k * w];
+    const std::vector<size_t>& pos = follow[order[k].second];
+    for (std::vector<size_t>::const_iterator j = pos.begin(); j != pos.end(); ++j)
+    {
+      size_t l = number[*j];
+      set[l / 64] |= 1ULL << (l % 64);
+    }
+  }
+  nfa_.cnt.swap(counters);
+  size_t off = 0;
+  for (std::vector<NFA::Counter>::iterator i = nfa_.cnt.begin(); i != nfa_.cnt.end(); ++i)
+  {
+    i->pos = number[i->pos];
+    i->off = off;
+    off += 2 + i->capacity();
+  }
+  if (n <= NFA::MAX_TABLE)
+  {
+    size_t bytes = (n + 7) / 8;
+    nfa_.fol.assign(bytes * 256 * w, 0);
+    for (size_t j = 0; j < bytes; ++j)
+    {
+      NFA::Word *table = &nfa_.fol[j * 256 * w];
+      for (size_t b = 1; b < 256; ++b)
+      {
+        // the union of the follow sets of the positions in byte b is the union for b without its lowest bit plus one follow set
+        size_t k = 8 * j;
+        size_t l = b;
+        while ((l & 1) == 0)
+        {
+          l >>= 1;
+          ++k;
+        }
+        if (k >= n)
+          continue;
+        const NFA::Word *rest = &table[(b & (b - 1)) * w];
+        const NFA::Word *set = &fol[k * w];
+        for (size_t i = 0; i < w; ++i)
+          table[b * w + i] = rest[i] | set[i];
+      }
+    }
+  }
+  else
+  {
+    nfa_.fol.swap(fol);
+  }
+  DBGLOG("END compile_nfa() %zu positions %zu counters", n, nfa_.cnt.size());
+  return true;
+}
+
+void Pattern::analyze_nfa()
+{
+  // the characters at the first Const::BITS levels of the NFA, the characters at level 0 are the first characters of a nonempty match
+  size_t w = nfa_.words;
+  std::vector<NFA::Word> set(nfa_.ini);
+  std::vector<NFA::Word> next(w);
+  std::vector<NFA::Word> mask(w);
+  NFA::Counts counts(nfa_);
+  std::vector<Chars> levels;
+  bool nullable = nfa_.accepting(&set[0]) > 0;
+  while (levels.size() < Const::BITS)
+  {
+    Chars chars;
+    for (Char c = 0; c < 256; ++c)
+    {
+      const NFA::Word *chr = &nfa_.chr[c * w];
+      for (size_t i = 0; i < w; ++i)
+      {
+        if ((chr[i] & set[i]) != 0)
+        {
+          chars.add(c);
+          break;
+        }
+      }
+    }
+    levels.push_back(chars);
+    // stop at the shortest match
+    if (!nfa_.step(counts, &set[0], &set[0], &next[0], &mask[0]) || nfa_.accepting(&next[0]) > 0)
+      break;
+    set.swap(next);
+  }
+  // predict matches with bit_[] and bitap tap_[] for the levels before the shortest match, no predict-match pma_[]
+  min_ = nullable ? 0 : static_cast<uint16_t>(levels.size());
+  alloc_tables(true, true);
+  for (Char c = 0; c < 256; ++c)
+    bit_[c] = ~static_cast<Bitap>(0);
+  for (Hash h = 0; h < Const::BTAP; ++h)
+    tap_[h] = ~static_cast<Bitap>(0);
+  fst_.reset();
+  for (size_t level = 0; level < levels.size(); ++level)
+  {
+    Bitap mask = ~static_cast<Bitap>(1 << level);
+    const Chars& chars = levels[level];
+    // the last level is hashed with all 256 possible next characters
+    Chars next_chars = level + 1 < levels.size() ? levels[level + 1] : Chars().add(0, 255);
+    for (Char c = 0; c < 256; ++c)
+    {
+      if (chars.contains(c))
+      {
+        bit_[c] &= mask;
+        if (level == 0)
+          fst_.set(c);
+        for (Char d = 0; d < 256; ++d)
+          if (next_chars.contains(d))
+            tap_[bihash(static_cast<uint8_t>(c), static_cast<uint8_t>(d))] &= mask;
+      }
+    }
+  }
+  lap_ = false;
+  idt_ = false;
+  mta_ = false;
+}
+
+void Pattern::init_estimate(
+    const Positions& startpos,
+    const Follow&    followpos)
+{
+  // the depth is the longest path of forward edges in the followpos graph, i.e. the number of BFS levels of the DFA without loops
+  std::map<Position,size_t> depths;
+  for (Follow::const_reverse_iterator i = followpos.rbegin(); i != followpos.rend(); ++i)
+  {
+    size_t size = i->second.size();
+    est_.follows += size;
+    if (size > est_.fanout)
+      est_.fanout = size;
+    if (static_cast<size_t>(i->first.iter()) + 1 > est_.repeats)
+      est_.repeats = i->first.iter() + 1;
+    size_t depth = 0;
+    for (Positions::const_iterator j = i->second.begin(); j != i->second.end(); ++j)
+    {
+      if (!j->accept() && j->pos() > i->first.pos())
+      {
+        std::map<Position,size_t>::const_iterator k = depths.find(j->pos());
+        if (k != depths.end() && k->second > depth)
+          depth = k->second;
+      }
+    }
+    depths[i->first.pos()] = ++depth;
+    if (depth > est_.depth)
+      est_.depth = depth;
+  }
+  est_.positions = followpos.size();
+  // the tree DFA of the strings is the DFA when all patterns are strings, otherwise at least one level per position of a subpattern
+  est_.exact = startpos.empty();
+  est_.states = vno_ + (est_.exact ? 0 : est_.depth + 1);
+  est_.bytes = est_.states * sizeof(DFA::State);
+}
+
+void Pattern::update_estimate(
+    const std::vector<Index>& widths,
+    size_t                    states,
+    size_t                    sizes)
+{
+  // the DFA is constructed when the last level is empty, otherwise extrapolate the growth of the last levels up to the depth
+  double total = 0.0;
+  for (std::vector<Index>::const_iterator i = widths.begin(); i != widths.end(); ++i)
+    total += *i;
+  size_t n = widths.size();
+  est_.exact = widths.back() == 0;
+  if (!est_.exact && n >= 2)
+  {
+    // the smallest growth of the last two levels avoids overestimating the initial fan out of many subpatterns
+    double growth = static_cast<double>(widths[n - 1]) / widths[n - 2];
+    if (n >= 3 && widths[n - 3] > 0 && static_cast<double>(widths[n - 2]) / widths[n - 3] < growth)
+      growth = static_cast<double>(widths[n - 2]) / widths[n - 3];
+    double width = widths[n - 1];
+    for (size_t k = n; k <= est_.depth && width >= 1.0 && total < 1e15; ++k)
+      total += width *= growth;
+  }
+  est_.states = total < 1e15 ? static_cast<size_t>(total) : static_cast<size_t>(1e15);
+  // memory per state for its positions and edges
+  size_t edges = eno_ / (vno_ > 0 ? vno_ : 1);
+  size_t bytes = sizeof(DFA::State) + sizes / (states > 0 ? states : 1) * sizeof(Position) + edges * (sizeof(DFA::State::Edges::value_type) + 4 * sizeof(void*));
+  est_.bytes = est_.states * bytes;
+}
+
+Pattern::Memory Pattern::memory_usage() const
+{
+  // the size of a node of a std::map and std::set is its value plus its color and three pointers
+  const size_t node = 4 * sizeof(void*);
+  Memory memory;
+  memory.pattern = sizeof(Pattern) + rex_.capacity() + end_.capacity() * sizeof(Location) + acc_.capacity() / 8;
+  if (nop_ > 0 && opc_ != NULL)
+    memory.opcodes = nop_ * sizeof(Opcode);
+  if (tbl_ != NULL)
+  {
+    memory.predictor = sizeof(Tables) + tbl_->tap.capacity() * sizeof(Bitap) + tbl_->pma.capacity() * sizeof(Pred);
+#ifdef WITH_BITAP_AVX2
+#if defined(HAVE_AVX512BW) || defined(HAVE_AVX2) || defined(HAVE_SSE2)
+    memory.predictor += tbl_->vtp.capacity() * sizeof(uint16_t);
+#endif
+#endif
+  }
+  for (size_t i = 0; i < HFA::MAX_DEPTH; ++i)
+  {
+    for (HFA::Hashes::const_iterator j = hfa_.hashes[i].begin(); j != hfa_.hashes[i].end(); ++j)
+    {
+      memory.hfa += sizeof(HFA::Hashes::value_type) + node;
+      for (size_t k = 0; k < HFA::MAX_DEPTH; ++k)
+        memory.hfa += j->second[k].size() * (sizeof(HFA::HashRange::value_type) + node);
+    }
+  }
+  for (HFA::States::const_iterator i = hfa_.states.begin(); i != hfa_.states.end(); ++i)
+    memory.hfa += sizeof(HFA::States::value_type) + node + i->second.size() * (sizeof(HFA::State) + node);
+  memory.nfa = (nfa_.chr.capacity() + nfa_.fol.capacity() + nfa_.ini.capacity()) * sizeof(NFA::Word) + nfa_.acc.capacity() * sizeof(Accept) + nfa_.cnt.capacity() * sizeof(NFA::Counter);
+  memory.total = memory.pattern + memory.opcodes + memory.predictor + memory.hfa + memory.nfa;
+  memory.peak = memory.total + dmu_;
+  return memory;
+}
+
+Pattern::NFA::Counts::Counts(const NFA& nfa)
+  :
+    que(buf),
+    now(0)
+{
+  if (nfa.cnt.empty())
+    return;
+  size_t size = nfa.cnt.back().off + 2 + nfa.cnt.back().capacity();
+  if (size > sizeof(buf) / sizeof(*buf))
+  {
+    mem.resize(size);
+    que = &mem[0];
+  }
+  // a counter in the start state set starts with count zero at step zero
+  for (std::vector<Counter>::const_iterator i = nfa.cnt.begin(); i != nfa.cnt.end(); ++i)
+  {
+    que[i->off] = 0;
+    que[i->off + 1] = 0;
+    if ((nfa.ini[i->pos / 64] & (1ULL << (i->pos % 64))) != 0)
+    {
+      que[i->off + 1] = 1;
+      que[i->off + 2] = 0;
+    }
+  }
+}
+
+const Pattern::NFA::Word *Pattern::NFA::exits(
+    const Counts& counts,
+    const Word   *set,
+    Word         *mask) const
+{
+  const Word *masked = set;
+  for (std::vector<Counter>::const_iterator i = cnt.begin(); i != cnt.end(); ++i)
+  {
+    Word bit = 1ULL << (i->pos % 64);
+    const size_t *que = &counts.que[i->off];
+    if ((set[i->pos / 64] & bit) != 0 && counts.now - que[2 + que[0]] < i->lo)
+    {
+      if (masked == set)
+      {
+        std::memcpy(mask, set, words * sizeof(Word));
+        masked = mask;
+      }
+      mask[i->pos / 64] &= ~bit;
+    }
+  }
+  return masked;
+}
+
+bool Pattern::NFA::count(
+    Counts&     counts,
+    const Word *set,
+    const Word *chr,
+    Word       *next) const
+{
+  size_t now = ++counts.now;
+  for (std::vector<Counter>::const_iterator i = cnt.begin(); i != cnt.end(); ++i)
+  {
+    size_t k = i->pos / 64;
+    Word bit = 1ULL << (i->pos % 64);
+    size_t cap = i->capacity();
+    size_t& beg = counts.que[i->off];
+    size_t& len = counts.que[i->off + 1];
+    size_t *ring = &counts.que[i->off + 2];
+    if ((set[k] & chr[k] & bit) == 0)
+    {
+      // no counts when the char does not match the repeated position
+      len = 0;
+    }
+    else if (!i->inf)
+    {
+      // counts incremented beyond hi expire
+      while (len > 0 && now - ring[beg] > i->hi)
+      {
+        if (++beg == cap)
+          beg = 0;
+        --len;
+      }
+    }
+    // the counter position in next is entered by the follow sets to start a new count zero
+    if ((next[k] & bit) != 0 && (len == 0 || !i->inf))
+    {
+      size_t j = beg + len;
+      ring[j < cap ? j : j - cap] = now;
+      ++len;
+    }
+    if (len > 0)
+      next[k] |= bit;
+    else
+      next[k] &= ~bit;
+  }
+  Word any = 0;
+  for (size_t k = 0; k < words; ++k)
+    any |= next[k];
+  return any != 0;
+}
+
 void Pattern::lazy(
     const Lazypos& lazypos,
     Positions&     pos) const
@@ -3110,6 +4103,12 @@ void Pattern::encode_dfa(DFA::State *start)
 void Pattern::gencode_dfa(const DFA::State *start) const
 {
 #ifndef WITH_NO_CODEGEN
+  std::map<Index,Index> cold;
+  std::vector<Index> hot;
+  std::vector<Opcode> code;
+  if (!opt_.y.empty())
+    gencode_dfa_hybrid(start, cold, hot, code);
+  const char *name = opt_.n.empty() ? "FSM" : opt_.n.c_str();
   for (std::vector<std::string>::const_iterator it = opt_.f.begin(); it != opt_.f.end(); ++it)
   {
     const std::string& filename = *it;
@@ -3144,14 +4143,51 @@ void Pattern::gencode_dfa(const DFA::State *start) const
           "#pragma clang diagnostic ignored \"-Wunused-label\"\n"
           "#endif\n\n");
       write_namespace_open(file);
+      if (!opt_.v.empty())
+      {
+        // count state visits and append the counts to the profile file on exit, to generate hybrid FSM code with option y
+        Index states = 0;
+        for (const DFA::State *state = start; state != NULL; state = state->next)
+          states = std::max(states, state->index + 1);
+        ::fprintf(file,
+            "static struct reflex_visits_%s_counts {\n"
+            "  size_t count[%u];\n"
+            "  ~reflex_visits_%s_counts()\n"
+            "  {\n"
+            "    FILE *file = ::fopen(\"%s\", \"a\");\n"
+            "    if (file == NULL)\n"
+            "      return;\n"
+            "    for (unsigned int i = 0; i < %u; ++i)\n"
+            "      if (count[i] > 0)\n"
+            "        ::fprintf(file, \"%%u %%lu\\n\", i, static_cast<unsigned long>(count[i]));\n"
+            "    ::fclose(file);\n"
+            "  }\n"
+            "} reflex_visits_%s;\n\n",
+            name, states, name, opt_.v.c_str(), states, name);
+      }
       ::fprintf(file,
           "void reflex_code_%s(reflex::Matcher& m)\n"
-          "{\n"
+          "{\n", name);
+      if (!code.empty())
+      {
+        // cold states are interpreted by FSM_CODE() from the opcode table, hot states are indexed after the opcodes
+        ::fprintf(file, "  static const reflex::Pattern::Opcode code[%zu] = {", code.size());
+        for (size_t i = 0; i < code.size(); ++i)
+          ::fprintf(file, "%s0x%08X,", i % 8 ? " " : "\n    ", code[i]);
+        ::fprintf(file,
+            "\n  };\n"
+            "  reflex::Pattern::Index s = 0;\n");
+      }
+      ::fprintf(file,
           "  int c = 0;\n"
-          "  m.FSM_INIT(c);\n", opt_.n.empty() ? "FSM" : opt_.n.c_str());
+          "  m.FSM_INIT(c);\n");
       for (const DFA::State *state = start; state != NULL; state = state->next)
       {
+        if (cold.find(state->index) != cold.end())
+          continue;
         ::fprintf(file, "\nS%u:\n", state->index);
+        if (!opt_.v.empty())
+          ::fprintf(file, "  ++reflex_visits_%s.count[%u];\n", name, state->index);
         if (state == start)
           ::fprintf(file, "  m.FSM_FIND();\n");
         if (state->redo)
@@ -3163,7 +4199,10 @@ void Pattern::gencode_dfa(const DFA::State *start) const
         for (Lookaheads::const_iterator i = state->heads.begin(); i != state->heads.end(); ++i)
           ::fprintf(file, "  m.FSM_HEAD(%u);\n", *i);
         if (state->edges.rbegin() != state->edges.rend() && state->edges.rbegin()->first == META_DED)
-          ::fprintf(file, "  if (m.FSM_DENT()) goto S%u;\n", state->edges.rbegin()->second.second->index);
+        {
+          ::fprintf(file, "  if (m.FSM_DENT())");
+          gencode_dfa_goto(file, state->edges.rbegin()->second.second->index, cold);
+        }
         bool peek = false; // if we need to read a character into c
         for (DFA::State::Edges::const_reverse_iterator i = state->edges.rbegin(); i != state->edges.rend(); ++i)
         {
@@ -3228,7 +4267,7 @@ void Pattern::gencode_dfa(const DFA::State *start) const
                   if (elif)
                     ::fprintf(file, "else ");
                   ::fprintf(file, "if (m.FSM_META_%s(c)) {\n", meta_label[lo - META_MIN]);
-                  gencode_dfa_closure(file, i->second.second, 2, peek);
+                  gencode_dfa_closure(file, i->second.second, 2, peek, cold);
                   ::fprintf(file, "  }\n");
                   elif = true;
                   break;
@@ -3237,7 +4276,7 @@ void Pattern::gencode_dfa(const DFA::State *start) const
                   if (elif)
                     ::fprintf(file, "else ");
                   ::fprintf(file, "if (m.FSM_META_%s()) {\n", meta_label[lo - META_MIN]);
-                  gencode_dfa_closure(file, i->second.second, 2, peek);
+                  gencode_dfa_closure(file, i->second.second, 2, peek, cold);
                   ::fprintf(file, "  }\n");
                   elif = true;
               }
@@ -3277,7 +4316,7 @@ void Pattern::gencode_dfa(const DFA::State *start) const
             }
             else
             {
-              ::fprintf(file, " goto S%u;\n", target_index);
+              gencode_dfa_goto(file, target_index, cold);
             }
           }
         }
@@ -3307,7 +4346,7 @@ void Pattern::gencode_dfa(const DFA::State *start) const
                   if (elif)
                     ::fprintf(file, "else ");
                   ::fprintf(file, "if (m.FSM_META_%s(c)) {\n", meta_label[lo - META_MIN]);
-                  gencode_dfa_closure(file, i->second.second, 2, peek);
+                  gencode_dfa_closure(file, i->second.second, 2, peek, cold);
                   ::fprintf(file, "  }\n");
                   elif = true;
                   break;
@@ -3316,7 +4355,7 @@ void Pattern::gencode_dfa(const DFA::State *start) const
                   if (elif)
                     ::fprintf(file, "else ");
                   ::fprintf(file, "if (m.FSM_META_%s()) {\n", meta_label[lo - META_MIN]);
-                  gencode_dfa_closure(file, i->second.second, 2, peek);
+                  gencode_dfa_closure(file, i->second.second, 2, peek, cold);
                   ::fprintf(file, "  }\n");
                   elif = true;
               }
@@ -3369,7 +4408,7 @@ void Pattern::gencode_dfa(const DFA::State *start) const
             }
             else
             {
-              ::fprintf(file, " goto S%u;\n", target_index);
+              gencode_dfa_goto(file, target_index, cold);
             }
           }
         }
@@ -3379,6 +4418,21 @@ void Pattern::gencode_dfa(const DFA::State *start) const
         else
           ::fprintf(file, "  return m.FSM_HALT();\n");
       }
+      if (!code.empty())
+      {
+        ::fprintf(file,
+            "\ncold:\n"
+            "  if (m.FSM_CODE(code, %zu, s, c))\n"
+            "  {\n"
+            "    switch (s)\n"
+            "    {\n", code.size());
+        for (size_t i = 0; i < hot.size(); ++i)
+          ::fprintf(file, "      case %zu: goto S%u;\n", code.size() + i, hot[i]);
+        ::fprintf(file,
+            "    }\n"
+            "  }\n"
+            "  return m.FSM_HALT(c);\n");
+      }
       ::fprintf(file, "}\n\n");
       if (opt_.p)
         write_predictor(file);
@@ -3423,7 +4477,7 @@ void Pattern::check_dfa_closure(const DFA::State *state, int nest, bool& peek) c
 #endif
 
 #ifndef WITH_NO_CODEGEN
-void Pattern::gencode_dfa_closure(FILE *file, const DFA::State *state, int nest, bool peek) const
+void Pattern::gencode_dfa_closure(FILE *file, const DFA::State *state, int nest, bool peek, const std::map<Index,Index>& cold) const
 {
   bool elif = false;
   if (state->redo)
@@ -3469,7 +4523,7 @@ void Pattern::gencode_dfa_closure(FILE *file, const DFA::State *state, int nest,
             if (elif)
               ::fprintf(file, "else ");
             ::fprintf(file, "if (m.FSM_META_%s(c)) {\n", meta_label[lo - META_MIN]);
-            gencode_dfa_closure(file, i->second.second, nest + 1, peek);
+            gencode_dfa_closure(file, i->second.second, nest + 1, peek, cold);
             ::fprintf(file, "%*s}\n", 2*nest, "");
             elif = true;
             break;
@@ -3478,7 +4532,7 @@ void Pattern::gencode_dfa_closure(FILE *file, const DFA::State *state, int nest,
             if (elif)
               ::fprintf(file, "else ");
             ::fprintf(file, "if (m.FSM_META_%s()) {\n", meta_label[lo - META_MIN]);
-            gencode_dfa_closure(file, i->second.second, nest + 1, peek);
+            gencode_dfa_closure(file, i->second.second, nest + 1, peek, cold);
             ::fprintf(file, "%*s}\n", 2*nest, "");
             elif = true;
         }
@@ -3523,7 +4577,7 @@ void Pattern::gencode_dfa_closure(FILE *file, const DFA::State *state, int nest,
       }
       else
       {
-        ::fprintf(file, " goto S%u;\n", target_index);
+        gencode_dfa_goto(file, target_index, cold);
       }
     }
   }
@@ -3571,7 +4625,7 @@ void Pattern::gencode_dfa_closure(FILE *file, const DFA::State *state, int nest,
       }
       else
       {
-        ::fprintf(file, " goto S%u;\n", target_index);
+        gencode_dfa_goto(file, target_index, cold);
       }
     }
   }
@@ -3579,6 +4633,133 @@ void Pattern::gencode_dfa_closure(FILE *file, const DFA::State *state, int nest,
 }
 #endif
 
+#ifndef WITH_NO_CODEGEN
+void Pattern::gencode_dfa_goto(FILE *file, Index index, const std::map<Index,Index>& cold) const
+{
+  std::map<Index,Index>::const_iterator i = cold.find(index);
+  if (i == cold.end())
+    ::fprintf(file, " goto S%u;\n", index);
+  else
+    ::fprintf(file, " { s = %u; goto cold; }\n", i->second);
+}
+#endif
+
+#ifndef WITH_NO_CODEGEN
+void Pattern::gencode_dfa_hybrid(const DFA::State *start, std::map<Index,Index>& cold, std::vector<Index>& hot, std::vector<Opcode>& code) const
+{
+  // load the state visit counts appended to the profile file by FSM code generated with option v
+  std::map<Index,size_t> visits;
+  size_t total = 0;
+  FILE *file = NULL;
+  if (reflex::fopen_s(&file, opt_.y.c_str(), "r") == 0 && file != NULL)
+  {
+    unsigned int index;
+    unsigned long count;
+    while (::fscanf(file, "%u %lu", &index, &count) == 2)
+    {
+      visits[index] += count;
+      total += count;
+    }
+    ::fclose(file);
+  }
+  if (total == 0)
+    return;
+  // the most visited states that account for 99% of all visits are hot
+  std::vector<std::pair<size_t,Index> > order;
+  for (std::map<Index,size_t>::const_iterator i = visits.begin(); i != visits.end(); ++i)
+    order.push_back(std::pair<size_t,Index>(i->second, i->first));
+  std::sort(order.rbegin(), order.rend());
+  std::set<Index> hottest;
+  size_t sum = 0;
+  for (std::vector<std::pair<size_t,Index> >::const_iterator i = order.begin(); i != order.end() && sum < total - total / 100; ++i)
+  {
+    hottest.insert(i->second);
+    sum += i->first;
+  }
+  // the start state and states with lookaheads and meta edges are always hot, because FSM_CODE() does not interpret these
+  std::vector<const DFA::State*> states;
+  size_t hots = 0;
+  for (const DFA::State *state = start; state != NULL; state = state->next)
+  {
+    bool meta = false;
+    for (DFA::State::Edges::const_iterator i = state->edges.begin(); i != state->edges.end() && !meta; ++i)
+#if WITH_COMPACT_DFA == -1
+      meta = is_meta(i->first);
+#else
+      meta = is_meta(i->second.first);
+#endif
+    if (state == start || meta || !state->heads.empty() || !state->tails.empty() || hottest.find(state->index) != hottest.end())
+      ++hots;
+    else
+      states.push_back(state);
+  }
+  if (states.empty())
+    return;
+  // hot states targeted by cold states are numbered in order of first use, starting at the opcode table size
+  std::map<Index,Index> hot_index;
+  // assign opcode table offsets to cold states, use LONG gotos when the offsets do not fit in 16 bits
+  bool wide = false;
+  Index size = 0;
+  for (int pass = 0; pass < 2; ++pass)
+  {
+    size = 0;
+    for (std::vector<const DFA::State*>::const_iterator i = states.begin(); i != states.end(); ++i)
+    {
+      cold[(*i)->index] = size;
+      size += ((*i)->redo || (*i)->accept > 0) + 1;
+      for (DFA::State::Edges::const_iterator j = (*i)->edges.begin(); j != (*i)->edges.end(); ++j)
+        if (j->second.second != NULL)
+          size += 1 + wide;
+    }
+    if (wide || size + hots < Const::LONG)
+      break;
+    wide = true;
+  }
+  for (std::vector<const DFA::State*>::const_iterator i = states.begin(); i != states.end(); ++i)
+  {
+    if ((*i)->redo)
+      code.push_back(opcode_redo());
+    else if ((*i)->accept > 0)
+      code.push_back(opcode_take((*i)->accept));
+    for (DFA::State::Edges::const_reverse_iterator j = (*i)->edges.rbegin(); j != (*i)->edges.rend(); ++j)
+    {
+      if (j->second.second == NULL)
+        continue;
+#if WITH_COMPACT_DFA == -1
+      Char lo = j->first;
+      Char hi = j->second.first;
+#else
+      Char hi = j->first;
+      Char lo = j->second.first;
+#endif
+      Index target = j->second.second->index;
+      std::map<Index,Index>::const_iterator k = cold.find(target);
+      if (k != cold.end())
+      {
+        target = k->second;
+      }
+      else
+      {
+        std::pair<std::map<Index,Index>::iterator,bool> h = hot_index.insert(std::pair<Index,Index>(target, static_cast<Index>(hot.size())));
+        if (h.second)
+          hot.push_back(target);
+        target = size + h.first->second;
+      }
+      if (wide)
+      {
+        code.push_back(opcode_goto(lo, hi, Const::LONG));
+        code.push_back(opcode_long(target));
+      }
+      else
+      {
+        code.push_back(opcode_goto(lo, hi, target));
+      }
+    }
+    code.push_back(opcode_halt());
+  }
+}
+#endif
+
 void Pattern::graph_dfa(const DFA::State *start) const
 {
 #ifndef WITH_NO_CODEGEN
@@ -4332,9 +5513,35 @@ void Pattern::analyze_dfa(DFA::State *start)
   if (lbk_ == 0)
   {
     DFA::State *state = start;
+    bool exact = false; // true if the prefix has a case-sensitive ASCII letter
     one_ = true;
     while (state->accept == 0)
     {
+      if (state->edges.size() == 2 && state->heads.empty())
+      {
+        // a case-insensitive ASCII letter has an upper and a lower case edge to the same state
+        DFA::State::Edges::const_iterator upper = state->edges.begin();
+        DFA::State::Edges::const_iterator lower = upper;
+        ++lower;
+        Char lo = lower->first;
+        if (exact ||
+            len_ >= 255 ||
+            lo < 'a' ||
+            lo > 'z' ||
+            lo != lower->second.first ||
+            upper->first != (lo & ~0x20) ||
+            upper->first != upper->second.first ||
+            upper->second.second != lower->second.second ||
+            lower->second.second == NULL)
+        {
+          one_ = false;
+          break;
+        }
+        icp_ = true;
+        chr_[len_++] = static_cast<uint8_t>(lo);
+        state = lower->second.second;
+        continue;
+      }
       if (state->edges.size() != 1 || !state->heads.empty())
       {
         one_ = false;
@@ -4345,11 +5552,13 @@ void Pattern::analyze_dfa(DFA::State *start)
       {
         if (!is_meta(lo))
         {
-          if (len_ >= 255)
+          bool letter = (lo >= 'a' && lo <= 'z') || (lo >= 'A' && lo <= 'Z');
+          if (len_ >= 255 || (letter && icp_))
           {
             one_ = false;
             break;
           }
+          exact |= letter;
           chr_[len_++] = static_cast<uint8_t>(lo);
         }
         else
@@ -4379,15 +5588,24 @@ void Pattern::analyze_dfa(DFA::State *start)
       state = start;
     }
 #endif
+    // a case-insensitive prefix of one letter is searched with needles or bitap instead
+    if (icp_ && len_ == 1)
+    {
+      len_ = 0;
+      one_ = false;
+      icp_ = false;
+      state = start;
+    }
     if (state != NULL && ((state->accept > 0 && !state->edges.empty()) || state->redo))
       one_ = false;
     if (state != NULL && (len_ == 0 || state->accept == 0))
       start_states.insert(state);
   }
   min_ = 0;
+  alloc_tables(true, true);
   std::memset(bit_, 0xff, sizeof(bit_));
-  std::memset(tap_, 0xff, sizeof(tap_));
-  std::memset(pma_, 0xff, sizeof(pma_));
+  std::memset(tap_, 0xff, Const::BTAP * sizeof(Bitap));
+  std::memset(pma_, 0xff, Const::HASH * sizeof(Pred));
   if (!start_states.empty())
   {
     gen_predict_match(start_states);
@@ -4841,7 +6059,7 @@ void Pattern::write_predictor(FILE *file) const
 {
   const char *nl = "\"\n  \"";
   ::fprintf(file, "// reflex::Pattern FSM C++ code or opcode constructor also takes a search pattern prediction table:\nextern const char reflex_pred_%s[] = {", opt_.n.empty() ? "FSM" : opt_.n.c_str());
-  ::fprintf(file, "\n  \"%02x%02x", static_cast<uint8_t>(len_), (static_cast<uint8_t>(min_ | (one_ << 4) | ((lbk_ > 0) << 5) | (bol_ << 6))));
+  ::fprintf(file, "\n  \"%02x%02x", static_cast<uint8_t>(len_), (static_cast<uint8_t>(min_ | (one_ << 4) | ((lbk_ > 0) << 5) | (bol_ << 6) | (icp_ << 7))));
   // save match characters chr_[0..len_-1]
   for (size_t i = 0; i < len_; ++i)
     ::fprintf(file, "%s%02x", ((i + 2) % 32) ? "" : nl, static_cast<uint8_t>(chr_[i]));
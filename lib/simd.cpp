@@ -35,6 +35,7 @@
 */
 
 #include <reflex/simd.h>
+#include <cstring>
 
 namespace reflex {
 
@@ -420,4 +421,66 @@ bool isutf8(const char *s, const char *e)
   return true;
 }
 
+// Skip bytes in the set of up to 8 non-NUL bytes, return pointer to the first byte not in the set or e
+const char *skipbytes(const char *s, const char *e, const char *set)
+{
+  size_t n = std::strlen(set);
+  if (n == 0 || n > 8)
+  {
+    while (s < e && *s != '\0' && std::strchr(set, *s) != NULL)
+      ++s;
+    return s;
+  }
+  // quick check: the first byte is usually not in the set, e.g. no white space between two tokens
+  if (s >= e || std::memchr(set, *s, n) == NULL)
+    return s;
+  if (s <= e - 16)
+  {
+#if defined(HAVE_AVX512BW) || defined(HAVE_AVX2)
+    if (s <= e - 32 && have_HW_AVX2())
+    {
+      if (simd_skipbytes_avx2(s, e, set, n))
+        return s;
+    }
+    else
+#endif
+#if defined(HAVE_AVX512BW) || defined(HAVE_AVX2) || defined(HAVE_SSE2)
+    {
+      __m128i vset[8];
+      for (size_t i = 0; i < n; ++i)
+        vset[i] = _mm_set1_epi8(set[i]);
+      while (s <= e - 16)
+      {
+        __m128i vc = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+        __m128i vm = _mm_cmpeq_epi8(vc, vset[0]);
+        for (size_t i = 1; i < n; ++i)
+          vm = _mm_or_si128(vm, _mm_cmpeq_epi8(vc, vset[i]));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(vm)) ^ 0xffff;
+        if (mask != 0)
+          return s + ctz(mask);
+        s += 16;
+      }
+    }
+#elif defined(HAVE_NEON) && defined(__aarch64__)
+    uint8x16_t vset[8];
+    for (size_t i = 0; i < n; ++i)
+      vset[i] = vdupq_n_u8(static_cast<uint8_t>(set[i]));
+    while (s <= e - 16)
+    {
+      uint8x16_t vc = vld1q_u8(reinterpret_cast<const uint8_t*>(s));
+      uint8x16_t vm = vceqq_u8(vc, vset[0]);
+      for (size_t i = 1; i < n; ++i)
+        vm = vorrq_u8(vm, vceqq_u8(vc, vset[i]));
+      // not all bytes are in the set, find the first byte not in the set with the scalar loop below
+      if (vminvq_u8(vm) == 0)
+        break;
+      s += 16;
+    }
+#endif
+  }
+  while (s < e && std::memchr(set, *s, n) != NULL)
+    ++s;
+  return s;
+}
+
 } // namespace reflex
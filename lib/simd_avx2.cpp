@@ -148,4 +148,36 @@ bool simd_isutf8_avx2(const char *& b, const char *e)
   return true;
 }
 
+// Partially skip bytes in the set of n (1 to 8) bytes, updates b to the first byte not in the set and returns true, or updates b close to e and returns false
+bool simd_skipbytes_avx2(const char *& b, const char *e, const char *set, size_t n)
+{
+#if defined(HAVE_AVX2) || defined(HAVE_AVX512BW)
+  const char *s = b;
+  __m256i vset[8];
+  for (size_t i = 0; i < n; ++i)
+    vset[i] = _mm256_set1_epi8(set[i]);
+  while (s <= e - 32)
+  {
+    __m256i vc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+    __m256i vm = _mm256_cmpeq_epi8(vc, vset[0]);
+    for (size_t i = 1; i < n; ++i)
+      vm = _mm256_or_si256(vm, _mm256_cmpeq_epi8(vc, vset[i]));
+    uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(vm));
+    if (mask != 0)
+    {
+      b = s + ctz(mask);
+      return true;
+    }
+    s += 32;
+  }
+  b = s;
+#else
+  (void)b;
+  (void)e;
+  (void)set;
+  (void)n;
+#endif
+  return false;
+}
+
 } // namespace reflex
@@ -81,10 +81,12 @@ static const char *options_table[] = {
   "full",
   "graphs_file",
   "header_file",
+  "hybrid_fsm",
   "include",
   "indent",
   "input",
   "interactive",
+  "keyword_hash",
   "lex",
   "lex_compat",
   "lexer",
@@ -121,8 +123,10 @@ static const char *options_table[] = {
   "perf_report",
   "posix_compat",
   "prefix",
+  "profile_fsm",
   "reentrant",
   "regexp_file",
+  "skip_ignorable",
   "stack",
   "stdinit",
   "stdout",
@@ -292,6 +296,199 @@ static std::string file_ext(std::string& name, const char *ext)
   return name;
 }
 
+/// Check if a converted regex matches a literal string only, such as a keyword, and return the literal string
+static bool regex_literal(const std::string& regex, std::string& literal)
+  /// @returns true if `regex` is a literal string assigned to `literal`
+{
+  literal.clear();
+  size_t nest = 0;
+  size_t pos = 0;
+  while (pos < regex.size())
+  {
+    char c = regex.at(pos);
+    if (regex.compare(pos, 3, "(?:") == 0)
+    {
+      ++nest;
+      pos += 3;
+    }
+    else if (c == ')' && nest > 0)
+    {
+      --nest;
+      ++pos;
+    }
+    else if (regex.compare(pos, 2, "\\Q") == 0)
+    {
+      size_t end = regex.find("\\E", pos + 2);
+      if (end == std::string::npos || regex.find('\\', pos + 2) < end)
+        return false;
+      literal.append(regex, pos + 2, end - pos - 2);
+      pos = end + 2;
+    }
+    else if (c == '\\')
+    {
+      if (pos + 1 >= regex.size() || std::isalnum(static_cast<unsigned char>(regex.at(pos + 1))))
+        return false;
+      literal.push_back(regex.at(pos + 1));
+      pos += 2;
+    }
+    else if (c == '\0' || std::strchr(".[]()|*+?{}^$", c) != NULL)
+    {
+      return false;
+    }
+    else
+    {
+      literal.push_back(c);
+      ++pos;
+    }
+  }
+  return nest == 0 && !literal.empty();
+}
+
+/// Check if a converted regex has no anchors, word boundaries, indent anchors, and lookaheads that depend on the context of a match
+static bool regex_context_free(const std::string& regex)
+  /// @returns true if `regex` has no anchors and no lookaheads
+{
+  for (size_t pos = 0; pos < regex.size(); ++pos)
+  {
+    char c = regex.at(pos);
+    if (c == '\\')
+    {
+      if (++pos >= regex.size())
+        break;
+      c = regex.at(pos);
+      if (c == 'Q')
+      {
+        pos = regex.find("\\E", pos);
+        if (pos == std::string::npos)
+          break;
+        ++pos;
+      }
+      else if (c != '\0' && std::strchr("AbBijkyYzZ<>`'", c) != NULL)
+      {
+        return false;
+      }
+    }
+    else if (c == '[')
+    {
+      // skip bracket list, conservatively rejects anchors in nested bracket lists
+      if (pos + 1 < regex.size() && regex.at(pos + 1) == '^')
+        ++pos;
+      if (pos + 1 < regex.size() && regex.at(pos + 1) == ']')
+        ++pos;
+      while (++pos < regex.size() && regex.at(pos) != ']')
+        if (regex.at(pos) == '\\')
+          ++pos;
+    }
+    else if (c == '^' || c == '$' || regex.compare(pos, 3, "(?=") == 0 || regex.compare(pos, 3, "(?!") == 0 || regex.compare(pos, 3, "(?^") == 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Keyword perfect hash first step, the same hash function is used by the generated scanner
+inline uint32_t keyword_hash(const std::string& word)
+  /// @returns hash value
+{
+  uint32_t h = 2166136261U;
+  for (size_t i = 0; i < word.size(); ++i)
+    h = (h ^ static_cast<uint8_t>(word.at(i))) * 16777619U;
+  return h;
+}
+
+/// Keyword perfect hash second step with displacement, the same hash function is used by the generated scanner
+inline uint32_t keyword_slot(uint32_t h, uint32_t d)
+  /// @returns hash value
+{
+  uint32_t x = (h ^ d) * 0x9E3779B1U;
+  return x ^ (x >> 15);
+}
+
+/// Return a regex that matches the given byte
+static std::string regex_byte(uint8_t c)
+  /// @returns regex \xHH
+{
+  static const char xdigits[] = "0123456789abcdef";
+  std::string regex("\\x");
+  regex.push_back(xdigits[c >> 4]);
+  regex.push_back(xdigits[c & 0xf]);
+  return regex;
+}
+
+/// Return a bracket list regex that matches the given set of bytes, which should not be empty
+static std::string regex_bracket(const std::bitset<256>& bytes)
+  /// @returns regex [...]
+{
+  std::string regex("[");
+  for (int lo = 0; lo < 256; ++lo)
+  {
+    if (!bytes.test(lo))
+      continue;
+    int hi = lo;
+    while (hi < 255 && bytes.test(hi + 1))
+      ++hi;
+    regex.append(regex_byte(static_cast<uint8_t>(lo)));
+    if (hi > lo)
+      regex.append("-").append(regex_byte(static_cast<uint8_t>(hi)));
+    lo = hi;
+  }
+  regex.push_back(']');
+  return regex;
+}
+
+/// Check if the action code of a rule is empty, i.e. has no code except white space, comments, and ; or {}
+static bool code_empty(const std::string& code)
+  /// @returns true if `code` is empty
+{
+  std::string rest;
+  for (size_t pos = 0; pos < code.size(); ++pos)
+  {
+    if (code.compare(pos, 2, "//") == 0)
+    {
+      pos = code.find('\n', pos);
+      if (pos == std::string::npos)
+        break;
+    }
+    else if (code.compare(pos, 2, "/*") == 0)
+    {
+      pos = code.find("*/", pos + 2);
+      if (pos == std::string::npos)
+        return false;
+      ++pos;
+    }
+    else if (!std::isspace(static_cast<unsigned char>(code.at(pos))))
+    {
+      rest.push_back(code.at(pos));
+    }
+  }
+  return rest.empty() || rest == ";" || rest == "{}" || rest == "{;}";
+}
+
+/// Returns the perf-report sampling interval, 1 to time every rule matched or N to time every Nth
+static size_t perf_report_interval(const std::string& value)
+{
+  size_t n = strtoul(value.c_str(), NULL, 10);
+  return n > 0 ? n : 1;
+}
+
+/// Write a string as a C++ string literal
+static void write_cstring(std::ostream& out, const std::string& s)
+{
+  out << '"';
+  for (size_t i = 0; i < s.size(); ++i)
+  {
+    uint8_t c = static_cast<uint8_t>(s.at(i));
+    if (c == '"' || c == '\\')
+      out << '\\' << c;
+    else if (c >= 0x20 && c < 0x7f && c != '?')
+      out << c;
+    else
+      out << '\\' << static_cast<char>('0' + (c >> 6)) << static_cast<char>('0' + ((c >> 3) & 7)) << static_cast<char>('0' + (c & 7));
+  }
+  out << '"';
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
 //  Main                                                                      //
@@ -571,6 +768,12 @@ void Reflex::help(const char *message, const char *arg)
                 generate full scanner with FSM opcode tables\n\
         -F, --fast\n\
                 generate fast scanner with FSM code\n\
+        --profile-fsm\n\
+                generate fast scanner that appends FSM state visit counts to\n\
+                reflex.NAME.prof files on exit, for option --hybrid-fsm\n\
+        --hybrid-fsm\n\
+                generate fast scanner with hot FSM states as code and cold\n\
+                states as opcode tables, using the reflex.NAME.prof counts\n\
         -i, --case-insensitive\n\
                 ignore case in patterns\n\
         -I, --interactive, --always-interactive\n\
@@ -586,6 +789,12 @@ void Reflex::help(const char *message, const char *arg)
                 include header FILE.h for custom matcher option -m\n\
         -S, --find\n\
                 generate search engine to find matches, ignores unmatched input\n\
+        --keyword-hash\n\
+                match keywords with a perfect hash instead of the FSM when an\n\
+                identifier rule also matches the keywords\n\
+        --skip-ignorable\n\
+                skip white space and line comments matched by rules without\n\
+                actions with SIMD instead of the FSM\n\
         -T N, --tabs=N\n\
                 set default tab size to N (1,2,4,8) for indent/dedent matching\n\
         -u, --unicode\n\
@@ -660,8 +869,9 @@ void Reflex::help(const char *message, const char *arg)
                 enable debug mode in scanner\n\
         -D, --do=[START:]FILE\n\
                 immediately test patterns on input FILE, start condition START\n\
-        -p, --perf-report\n\
-                scanner reports detailed performance statistics to stderr\n\
+        -p, --perf-report[=N]\n\
+                scanner reports detailed performance statistics to stderr, the\n\
+                time of every N-th rule matched is sampled, N=1 by default\n\
         -s, --nodefault\n\
                 disable the default rule that echoes unmatched text\n\
         -v, --verbose\n\
@@ -1743,6 +1953,10 @@ void Reflex::parse_section_2()
     else
       error("%% section ending encountered inside scope ", name);
   }
+  if (!options["keyword_hash"].empty())
+    find_keywords();
+  if (!options["skip_ignorable"].empty())
+    find_ignorable();
   patterns.resize(conditions.size());
   for (Start start = 0; start < conditions.size(); ++start)
   {
@@ -1763,7 +1977,7 @@ void Reflex::parse_section_2()
     const char *sep = "";
     for (Rules::const_iterator rule = rules[start].begin(); rule != rules[start].end(); ++rule)
     {
-      if (rule->regex != "<<EOF>>")
+      if (rule->regex != "<<EOF>>" && rule->keyword.empty())
       {
         pattern.append(sep).append("(").append(rule->regex).append(")");
         sep = "|";
@@ -1779,6 +1993,206 @@ void Reflex::parse_section_3()
     section_3.push_back(Code(line, infile, lineno));
 }
 
+/// Find keyword rules matched by a later rule, e.g. an identifier rule, to match keywords with a perfect hash instead of the FSM
+void Reflex::find_keywords()
+{
+  if (!options["matcher"].empty() && options["matcher"] != "reflex")
+  {
+    warning("option keyword-hash requires the reflex matcher and is ignored");
+    return;
+  }
+  if (!options["case_insensitive"].empty() || !options["freespace"].empty())
+  {
+    warning("option keyword-hash cannot be used with case-insensitive and freespace options and is ignored");
+    return;
+  }
+  std::string modifiers = options["dotall"].empty() ? "(?m)" : "(?ms)";
+  for (Start start = 0; start < conditions.size(); ++start)
+  {
+    Rules& list = rules[start];
+    Strings literals(list.size());
+    std::vector<bool> is_literal(list.size());
+    for (size_t i = 0; i < list.size(); ++i)
+      is_literal[i] = list[i].regex != "<<EOF>>" && regex_literal(list[i].regex, literals[i]);
+    std::map<size_t,reflex::Pattern*> compiled;
+    for (size_t i = 0; i < list.size(); ++i)
+    {
+      // a keyword rule and the rule before it should not share actions with |
+      if (!is_literal[i] || list[i].code.line == "|" || (i > 0 && list[i - 1].code.line == "|"))
+        continue;
+      // find the first rule that matches the keyword, such that the keyword rule is selected by the perfect hash after this rule matched
+      for (size_t j = i + 1; j < list.size(); ++j)
+      {
+        if (list[j].regex == "<<EOF>>")
+          continue;
+        if (is_literal[j])
+        {
+          // a duplicate keyword rule cannot be removed from the FSM, because it matches the keyword
+          if (literals[j] == literals[i])
+            break;
+          continue;
+        }
+        std::map<size_t,reflex::Pattern*>::iterator pattern = compiled.find(j);
+        if (pattern == compiled.end())
+        {
+          reflex::Pattern *compiled_pattern = NULL;
+          if (regex_context_free(list[j].regex))
+          {
+            try
+            {
+              compiled_pattern = new reflex::Pattern(modifiers + list[j].regex);
+            }
+            catch (reflex::regex_error&)
+            {
+              compiled_pattern = NULL;
+            }
+          }
+          pattern = compiled.insert(std::pair<size_t,reflex::Pattern*>(j, compiled_pattern)).first;
+        }
+        // a rule with anchors or lookaheads may match the keyword depending on the context, then keep the keyword rule
+        if (pattern->second == NULL)
+          break;
+        if (reflex::Matcher(*pattern->second, literals[i]).matches() != 0)
+        {
+          list[i].keyword = literals[i];
+          list[i].shadow = j;
+          break;
+        }
+      }
+    }
+    for (std::map<size_t,reflex::Pattern*>::iterator pattern = compiled.begin(); pattern != compiled.end(); ++pattern)
+      delete pattern->second;
+  }
+}
+
+/// Find ignorable rules with empty actions, such as white space and line comments, to skip input with SIMD instead of the FSM
+void Reflex::find_ignorable()
+{
+  if (!options["matcher"].empty() && options["matcher"] != "reflex")
+  {
+    warning("option skip-ignorable requires the reflex matcher and is ignored");
+    return;
+  }
+  if (!options["debug"].empty() || !options["perf_report"].empty())
+  {
+    warning("option skip-ignorable cannot be used with debug and perf-report options and is ignored");
+    return;
+  }
+  std::string modifiers = options["dotall"].empty() ? "(?m)" : "(?ms)";
+  if (!options["case_insensitive"].empty())
+    modifiers.insert(3, "i");
+  if (!options["freespace"].empty())
+    modifiers.insert(3, "x");
+  for (Start start = 0; start < conditions.size(); ++start)
+  {
+    Rules& list = rules[start];
+    // indent anchors depend on the white space matched and yymore() appends the next match, then input cannot be skipped
+    bool context = false;
+    for (size_t i = 0; i < list.size() && !context; ++i)
+      context =
+        list[i].regex.find("\\i") != std::string::npos ||
+        list[i].regex.find("\\j") != std::string::npos ||
+        list[i].regex.find("\\k") != std::string::npos ||
+        list[i].code.line.find("more(") != std::string::npos;
+    if (context)
+      continue;
+    for (size_t i = 0; i < list.size(); ++i)
+    {
+      Rule& rule = list[i];
+      if (rule.regex == "<<EOF>>" || rule.code.line == "|" || (i > 0 && list[i - 1].code.line == "|") || !code_empty(rule.code.line) || !regex_context_free(rule.regex))
+        continue;
+      // the canonical regex of the ignorable rule and the regex that matches input that does not start like the ignorable rule
+      std::string canonical;
+      std::string other;
+      std::string prefix;
+      std::string body;
+      bool comment = false;
+      size_t size = rule.regex.size();
+      if (options["dotall"].empty() && size > 2 && rule.regex.compare(size - 2, 2, ".*") == 0 && (size < 3 || rule.regex.at(size - 3) != '\\'))
+        body = rule.regex.substr(0, size - 2);
+      else if (size > 9 && rule.regex.compare(size - 9, 9, "[^\\x0a]*") == 0)
+        body = rule.regex.substr(0, size - 9);
+      if (!body.empty() && options["case_insensitive"].empty() && options["freespace"].empty() && regex_literal(body, prefix) && prefix.find('\0') == std::string::npos)
+      {
+        // a line comment rule such as "//".* that matches a prefix followed by the rest of the line
+        comment = true;
+        for (size_t k = 0; k < prefix.size(); ++k)
+          canonical.append(regex_byte(static_cast<uint8_t>(prefix.at(k))));
+        canonical.append("[^\\x0a]*");
+        for (size_t k = 0; k < prefix.size(); ++k)
+        {
+          std::bitset<256> bytes;
+          bytes.set();
+          bytes.reset(static_cast<uint8_t>(prefix.at(k)));
+          if (k > 0)
+            other.append("|");
+          for (size_t l = 0; l < k; ++l)
+            other.append(regex_byte(static_cast<uint8_t>(prefix.at(l))));
+          other.append(k > 0 ? "(?:" : "").append(regex_bracket(bytes)).append("[\\x00-\\xff]*").append(k > 0 ? ")?" : "");
+        }
+      }
+      else
+      {
+        // a rule such as [ \t\r\n]+ that matches one or more bytes in a set of bytes
+        try
+        {
+          reflex::Pattern pattern(modifiers + rule.regex);
+          std::bitset<256> bytes;
+          for (int c = 0; c < 256; ++c)
+            if (reflex::Matcher(pattern, std::string(1, static_cast<char>(c))).matches() != 0)
+              bytes.set(c);
+          if (bytes.none() || bytes.test(0))
+            continue;
+          for (int c = 1; c < 256; ++c)
+            if (bytes.test(c))
+              prefix.push_back(static_cast<char>(c));
+          canonical = regex_bracket(bytes) + "+";
+          other = regex_bracket(~bytes) + "[\\x00-\\xff]*";
+        }
+        catch (reflex::regex_error&)
+        {
+          continue;
+        }
+      }
+      // the rule must match the canonical regex exactly, the rules before it may not match input that starts like the ignorable rule
+      // and the rules after it may only match input that the ignorable rule matches longer or as long as these rules
+      try
+      {
+        if (reflex::Pattern(modifiers + "(" + canonical + ")|(" + rule.regex + ")").reachable(2) ||
+            reflex::Pattern(modifiers + "(" + rule.regex + ")|(" + canonical + ")").reachable(2))
+          continue;
+        bool overlap = false;
+        for (int after = 0; after <= 1 && !overlap; ++after)
+        {
+          std::string regex = modifiers + "(" + other + (after ? "|" + canonical : "") + ")";
+          size_t rest = 0;
+          for (size_t j = after ? i + 1 : 0; j < (after ? list.size() : i); ++j)
+          {
+            if (list[j].regex != "<<EOF>>")
+            {
+              regex.append("|(").append(list[j].regex).append(")");
+              ++rest;
+            }
+          }
+          if (rest == 0)
+            continue;
+          reflex::Pattern pattern(regex);
+          for (reflex::Pattern::Accept k = 2; k <= pattern.size() && !overlap; ++k)
+            overlap = pattern.reachable(k);
+        }
+        if (overlap)
+          continue;
+      }
+      catch (reflex::regex_error&)
+      {
+        continue;
+      }
+      rule.skip = prefix;
+      rule.comment = comment;
+    }
+  }
+}
+
 /// Write lex.yy.cpp
 void Reflex::write()
 {
@@ -1786,6 +2200,8 @@ void Reflex::write()
     options["flex"] = options["bison"] = "true";
   if (!options["yyclass"].empty())
     options["flex"] = "true";
+  if (!options["profile_fsm"].empty() || !options["hybrid_fsm"].empty())
+    options["fast"] = "true";
   if (options["prefix"].empty() && !options["flex"].empty())
     options["prefix"] = "yy";
   if (options["lexer"].empty())
@@ -2351,62 +2767,169 @@ void Reflex::write_perf_report()
 {
   if (!options["perf_report"].empty())
   {
+    std::string file;
+    for (size_t i = 0; i < infile.size(); ++i)
+    {
+      if (infile.at(i) == '"' || infile.at(i) == '\\')
+        file.push_back('\\');
+      file.push_back(infile.at(i));
+    }
     *out <<
       "  void perf_report()\n"
       "  {\n"
-      "    if (perf_report_time_pointer != NULL)\n"
-      "      *perf_report_time_pointer += reflex::timer_elapsed(perf_report_timer);\n"
-      "    std::cerr << \"reflex " REFLEX_VERSION " " << escape_bs(infile) << " performance report:\\n\";\n";
+      "    perf_report_write(std::cerr, false);\n"
+      "    set_perf_report();\n"
+      "  }\n"
+      "  void perf_report_json(std::ostream& os)\n"
+      "  {\n"
+      "    perf_report_write(os, true);\n"
+      "  }\n"
+      "  void set_perf_report()\n"
+      "  {\n";
     for (Start start = 0; start < conditions.size(); ++start)
     {
-      *out <<
-        "    std::cerr << \"  " << conditions[start] << " rules matched:\\n\"";
       size_t report = 0;
       for (Rules::const_iterator rule = rules[start].begin(); rule != rules[start].end(); ++rule)
-      {
         if (rule->regex != "<<EOF>>" && rule->code.line != "|")
-        {
-          *out <<
-            "\n      \"    rule at line " << rule->code.lineno << " matched \" << perf_report_" << conditions[start] << "_rule[" << report << "] << \" times, matching \" << perf_report_" << conditions[start] << "_size[" << report << "] << \" bytes total in \" << perf_report_" << conditions[start] << "_time[" << report << "] << \" ms\\n\"";
           ++report;
-        }
-      }
+      if (report > 0)
+        *out <<
+          "    for (size_t i = 0; i < " << report << "; ++i)\n"
+          "    {\n"
+          "      perf_report_" << conditions[start] << "_rule[i] = 0;\n"
+          "      perf_report_" << conditions[start] << "_size[i] = 0;\n"
+          "      perf_report_" << conditions[start] << "_sample[i] = perf_report_type();\n"
+          "    }\n";
       if (options["nodefault"].empty())
         *out <<
-          "\n      \"    default rule invoked \" << perf_report_" << conditions[start] << "_default << \" times\\n\"";
-      *out <<
-        ";\n";
+          "    perf_report_" << conditions[start] << "_default = 0;\n";
     }
     *out <<
-      "    std::cerr << \"  WARNING: execution time measurements are relative:\\n  - includes caller's execution time between matches when " << options["lex"] << "() returns\\n  - perf-report instrumentation adds overhead that increases execution times\\n\" << std::endl;\n"
-      "    set_perf_report();\n"
-      "  }\n";
-    *out <<
-      "  void set_perf_report()\n"
-      "  {\n";
+      "    perf_report_pointer = NULL;\n"
+      "    perf_report_tick = 0;\n"
+      "    perf_report_ms = 0;\n"
+      "    reflex::timer_start(perf_report_timer);\n"
+      "    perf_report_start = reflex::timer_cycles();\n"
+      "  }\n"
+      " protected:\n"
+      "  struct perf_report_type {\n"
+      "    size_t   samples;\n"
+      "    uint64_t cycles;\n"
+      "    size_t   histogram[32];\n"
+      "  };\n"
+      "  void perf_report_sample()\n"
+      "  {\n"
+      "    uint64_t cycles = reflex::timer_cycles() - perf_report_cycles;\n"
+      "    size_t bucket = 0;\n"
+      "    while (bucket < 31 && (cycles >> bucket) > 1)\n"
+      "      ++bucket;\n"
+      "    ++perf_report_pointer->samples;\n"
+      "    perf_report_pointer->cycles += cycles;\n"
+      "    ++perf_report_pointer->histogram[bucket];\n"
+      "    perf_report_pointer = NULL;\n"
+      "  }\n"
+      "  void perf_report_write(std::ostream& os, bool json)\n"
+      "  {\n"
+      "    if (perf_report_pointer != NULL)\n"
+      "      perf_report_sample();\n"
+      "    perf_report_ms += reflex::timer_elapsed(perf_report_timer);\n"
+      "    double rate = perf_report_ms > 0 ? (reflex::timer_cycles() - perf_report_start) / perf_report_ms : 0;\n"
+      "    if (json)\n"
+      "      os << \"{\\\"file\\\":\\\"\" << ";
+    write_cstring(*out, file);
+    *out << " << \"\\\",\\\"sample\\\":" << perf_report_interval(options["perf_report"]) << ",\\\"cycles_per_ms\\\":\" << rate << \",\\\"conditions\\\":[\";\n"
+      "    else\n"
+      "      os << \"reflex " REFLEX_VERSION " " << escape_bs(infile) << " performance report:\\n\";\n";
     for (Start start = 0; start < conditions.size(); ++start)
     {
+      std::string prefix = "perf_report_" + conditions[start];
       size_t report = 0;
+      *out <<
+        "    {\n";
       for (Rules::const_iterator rule = rules[start].begin(); rule != rules[start].end(); ++rule)
       {
         if (rule->regex != "<<EOF>>" && rule->code.line != "|")
         {
-          *out <<
-            "    perf_report_" << conditions[start] << "_rule[" << report << "] = 0;\n"
-            "    perf_report_" << conditions[start] << "_size[" << report << "] = 0;\n"
-            "    perf_report_" << conditions[start] << "_time[" << report << "] = 0;\n";
+          *out << (report == 0 ? "      static const size_t line[] = { " : ", ") << rule->code.lineno;
           ++report;
         }
       }
-      if (options["nodefault"].empty())
+      if (report > 0)
         *out <<
-          "    perf_report_" << conditions[start] << "_default = 0;\n";
+          " };\n";
+      if (start > 0)
+        *out <<
+          "      if (json)\n"
+          "        os << \",\";\n";
+      *out <<
+        "      perf_report_write(os, json, \"" << conditions[start] << "\", " << report;
+      if (report > 0)
+        *out << ", line, " << prefix << "_rule, " << prefix << "_size, " << prefix << "_sample";
+      else
+        *out << ", NULL, NULL, NULL, NULL";
+      if (options["nodefault"].empty())
+        *out << ", &" << prefix << "_default";
+      else
+        *out << ", NULL";
+      *out <<
+        ", rate);\n"
+        "    }\n";
     }
     *out <<
-      "    perf_report_time_pointer = NULL;\n"
-      "    reflex::timer_start(perf_report_timer);\n"
+      "    if (json)\n"
+      "      os << \"]}\\n\";\n"
+      "    else\n"
+      "      os << \"  WARNING: execution time measurements are relative:\\n  - includes caller's execution time between matches when " << options["lex"] << "() returns\\n  - perf-report instrumentation adds overhead that increases execution times\\n\" << std::endl;\n"
       "  }\n"
-      " protected:\n";
+      "  void perf_report_write(std::ostream& os, bool json, const char *name, size_t n, const size_t *line, const size_t *rule, const size_t *size, const perf_report_type *sample, const size_t *dflt, double rate)\n"
+      "  {\n"
+      "    size_t bytes = 0;\n"
+      "    double ms = 0;\n"
+      "    for (size_t i = 0; i < n; ++i)\n"
+      "    {\n"
+      "      bytes += size[i];\n"
+      "      ms += perf_report_estimate(rule[i], sample[i], rate);\n"
+      "    }\n"
+      "    double bps = ms > 0 ? 1000 * bytes / ms : 0;\n"
+      "    if (json)\n"
+      "    {\n"
+      "      os << \"{\\\"name\\\":\\\"\" << name << \"\\\",\\\"bytes\\\":\" << bytes << \",\\\"ms\\\":\" << ms << \",\\\"bytes_per_second\\\":\" << bps;\n"
+      "      if (dflt != NULL)\n"
+      "        os << \",\\\"default\\\":\" << *dflt;\n"
+      "      os << \",\\\"rules\\\":[\";\n"
+      "      for (size_t i = 0; i < n; ++i)\n"
+      "      {\n"
+      "        os << (i > 0 ? \",\" : \"\") << \"{\\\"line\\\":\" << line[i] << \",\\\"matched\\\":\" << rule[i] << \",\\\"bytes\\\":\" << size[i] << \",\\\"ms\\\":\" << perf_report_estimate(rule[i], sample[i], rate) << \",\\\"samples\\\":\" << sample[i].samples << \",\\\"cycles\\\":\" << sample[i].cycles << \",\\\"histogram\\\":[\";\n"
+      "        for (size_t j = 0; j < 32; ++j)\n"
+      "          os << (j > 0 ? \",\" : \"\") << sample[i].histogram[j];\n"
+      "        os << \"]}\";\n"
+      "      }\n"
+      "      os << \"]}\";\n"
+      "    }\n"
+      "    else\n"
+      "    {\n"
+      "      os << \"  \" << name << \" rules matched:\\n\";\n"
+      "      for (size_t i = 0; i < n; ++i)\n"
+      "      {\n"
+      "        os << \"    rule at line \" << line[i] << \" matched \" << rule[i] << \" times, matching \" << size[i] << \" bytes total in \" << perf_report_estimate(rule[i], sample[i], rate) << \" ms\\n\";\n"
+      "        if (sample[i].samples > 0)\n"
+      "        {\n"
+      "          os << \"      sampled \" << sample[i].samples << \" times, latency histogram in cycles:\";\n"
+      "          for (size_t j = 0; j < 32; ++j)\n"
+      "            if (sample[i].histogram[j] > 0)\n"
+      "              os << \" <\" << (static_cast<uint64_t>(2) << j) << \":\" << sample[i].histogram[j];\n"
+      "          os << \"\\n\";\n"
+      "        }\n"
+      "      }\n"
+      "      if (dflt != NULL)\n"
+      "        os << \"    default rule invoked \" << *dflt << \" times\\n\";\n"
+      "      os << \"    \" << bytes << \" bytes matched in \" << ms << \" ms, \" << bps << \" bytes/sec\\n\";\n"
+      "    }\n"
+      "  }\n"
+      "  static double perf_report_estimate(size_t matched, const perf_report_type& sample, double rate)\n"
+      "  {\n"
+      "    return sample.samples > 0 && rate > 0 ? sample.cycles / rate * matched / sample.samples : 0;\n"
+      "  }\n";
     for (Start start = 0; start < conditions.size(); ++start)
     {
       size_t report = 0;
@@ -2418,18 +2941,155 @@ void Reflex::write_perf_report()
         *out <<
           "  size_t perf_report_" << conditions[start] << "_rule[" << report << "];\n"
           "  size_t perf_report_" << conditions[start] << "_size[" << report << "];\n"
-          "  float  perf_report_" << conditions[start] << "_time[" << report << "];\n";
+          "  perf_report_type perf_report_" << conditions[start] << "_sample[" << report << "];\n";
       }
       if (options["nodefault"].empty())
         *out <<
           "  size_t perf_report_" << conditions[start] << "_default;\n";
     }
     *out <<
-      "  float *perf_report_time_pointer;\n"
+      "  perf_report_type *perf_report_pointer;\n"
+      "  size_t perf_report_tick;\n"
+      "  uint64_t perf_report_cycles;\n"
+      "  uint64_t perf_report_start;\n"
+      "  double perf_report_ms;\n"
       "  reflex::timer_type perf_report_timer;\n";
   }
 }
 
+/// Write keyword perfect hash lookup functions to lex.yy.cpp
+void Reflex::write_keywords()
+{
+  std::string prefix = options["prefix"];
+  const char *prefix_opt = prefix != "yy" ? prefix.c_str() : "";
+  for (Start start = 0; start < conditions.size(); ++start)
+  {
+    const Rules& list = rules[start];
+    // the accept values of the rules matched by the FSM are followed by the accept values of the keyword rules
+    std::vector<size_t> accepts(list.size());
+    size_t accept = 0;
+    for (size_t i = 0; i < list.size(); ++i)
+      if (list[i].regex != "<<EOF>>" && list[i].keyword.empty())
+        accepts[i] = ++accept;
+    std::vector<size_t> keywords;
+    std::set<size_t> shadows;
+    size_t min = ~0UL;
+    size_t max = 0;
+    for (size_t i = 0; i < list.size(); ++i)
+    {
+      if (!list[i].keyword.empty())
+      {
+        accepts[i] = ++accept;
+        keywords.push_back(i);
+        shadows.insert(accepts[list[i].shadow]);
+        min = std::min(min, list[i].keyword.size());
+        max = std::max(max, list[i].keyword.size());
+      }
+    }
+    if (keywords.empty())
+      continue;
+    // hash and displace: hash the keywords into buckets, then find a displacement for each bucket, the largest bucket first
+    size_t n = keywords.size();
+    size_t buckets = 1;
+    while (2 * buckets < n)
+      buckets <<= 1;
+    size_t slots = 2;
+    while (slots < n + n / 2)
+      slots <<= 1;
+    std::vector<uint32_t> hashes(n);
+    std::vector<std::vector<size_t> > bucket(buckets);
+    for (size_t k = 0; k < n; ++k)
+    {
+      hashes[k] = keyword_hash(list[keywords[k]].keyword);
+      bucket[(hashes[k] ^ (hashes[k] >> 16)) & (buckets - 1)].push_back(k);
+    }
+    std::vector<uint16_t> displacements;
+    std::vector<size_t> table;
+    while (true)
+    {
+      displacements.assign(buckets, 0);
+      table.assign(slots, n);
+      bool done = true;
+      for (size_t size = n; size > 0 && done; --size)
+      {
+        for (size_t b = 0; b < buckets && done; ++b)
+        {
+          if (bucket[b].size() != size)
+            continue;
+          done = false;
+          for (uint32_t d = 0; d <= 0xffff && !done; ++d)
+          {
+            done = true;
+            for (size_t k = 0; k < size && done; ++k)
+            {
+              size_t slot = keyword_slot(hashes[bucket[b][k]], d) & (slots - 1);
+              done = table[slot] == n;
+              for (size_t l = 0; l < k && done; ++l)
+                done = (keyword_slot(hashes[bucket[b][l]], d) & (slots - 1)) != slot;
+            }
+            if (done)
+            {
+              displacements[b] = static_cast<uint16_t>(d);
+              for (size_t k = 0; k < size; ++k)
+                table[keyword_slot(hashes[bucket[b][k]], d) & (slots - 1)] = bucket[b][k];
+            }
+          }
+        }
+      }
+      if (done)
+        break;
+      slots <<= 1;
+    }
+    *out <<
+      "static size_t reflex_keyword_" << prefix_opt << conditions[start] << "(size_t accept, const reflex::AbstractMatcher& m)\n"
+      "{\n"
+      "  static const uint16_t displacement[" << buckets << "] = {";
+    for (size_t b = 0; b < buckets; ++b)
+      *out << (b % 16 ? " " : "\n    ") << displacements[b] << ",";
+    *out <<
+      "\n  };\n"
+      "  static const struct { const char *word; size_t size; size_t from; size_t to; } keyword[" << slots << "] = {";
+    for (size_t slot = 0; slot < slots; ++slot)
+    {
+      *out << "\n    { ";
+      if (table[slot] < n)
+      {
+        const Rule& rule = list[keywords[table[slot]]];
+        write_cstring(*out, rule.keyword);
+        *out << ", " << rule.keyword.size() << ", " << accepts[rule.shadow] << ", " << accepts[keywords[table[slot]]] << " },";
+      }
+      else
+      {
+        *out << "NULL, 0, 0, 0 },";
+      }
+    }
+    *out <<
+      "\n  };\n"
+      "  if (";
+    for (std::set<size_t>::const_iterator i = shadows.begin(); i != shadows.end(); ++i)
+      *out << (i == shadows.begin() ? "" : " || ") << "accept == " << *i;
+    *out <<
+      ")\n"
+      "  {\n"
+      "    size_t len = m.size();\n"
+      "    if (len >= " << min << " && len <= " << max << ")\n"
+      "    {\n"
+      "      const char *s = m.begin();\n"
+      "      uint32_t h = 2166136261U;\n"
+      "      for (size_t i = 0; i < len; ++i)\n"
+      "        h = (h ^ static_cast<uint8_t>(s[i])) * 16777619U;\n"
+      "      h = (h ^ displacement[(h ^ (h >> 16)) & " << buckets - 1 << "]) * 0x9E3779B1U;\n"
+      "      h = (h ^ (h >> 15)) & " << slots - 1 << ";\n"
+      "      if (keyword[h].from == accept && keyword[h].size == len && std::memcmp(keyword[h].word, s, len) == 0)\n"
+      "        return keyword[h].to;\n"
+      "    }\n"
+      "  }\n"
+      "  return accept;\n"
+      "}\n"
+      "\n";
+  }
+}
+
 /// Write section 1 user-defined code to lex.yy.cpp
 void Reflex::write_section_1()
 {
@@ -2781,6 +3441,7 @@ void Reflex::write_lexer()
     }
     *out << '\n';
   }
+  write_keywords();
   *out << token_type << " ";
   if (!options["namespace"].empty())
     write_namespace_scope();
@@ -2869,8 +3530,13 @@ void Reflex::write_lexer()
     "  {\n";
   if (!options["perf_report"].empty())
     *out <<
-      "    if (perf_report_time_pointer != NULL)\n"
-      "      *perf_report_time_pointer += reflex::timer_elapsed(perf_report_timer);\n";
+      "    if (perf_report_pointer != NULL)\n"
+      "      perf_report_sample();\n"
+      "    if (++perf_report_tick >= " << perf_report_interval(options["perf_report"]) << ")\n"
+      "    {\n"
+      "      perf_report_tick = 0;\n"
+      "      perf_report_cycles = reflex::timer_cycles();\n"
+      "    }\n";
   if (conditions.size() > 1)
     *out <<
       "    switch (start())\n"
@@ -2881,16 +3547,50 @@ void Reflex::write_lexer()
       *out <<
         "      case " << conditions[start] << ":\n"
         "        matcher().pattern(PATTERN_" << conditions[start] << ");\n";
+    // keyword rules matched by another rule are selected with a perfect hash lookup
+    std::string keyword_lookup;
+    std::string keyword_lookup_end;
+    size_t keyword_accept = 1;
+    for (Rules::const_iterator rule = rules[start].begin(); rule != rules[start].end(); ++rule)
+    {
+      if (rule->regex != "<<EOF>>" && rule->keyword.empty())
+        ++keyword_accept;
+      else if (!rule->keyword.empty())
+        keyword_lookup.assign("reflex_keyword_").append(prefix_opt).append(conditions[start]).append("(");
+    }
+    if (!keyword_lookup.empty())
+      keyword_lookup_end = ", matcher())";
+    // ignorable rules without actions skip white space and line comments before matching a token
+    size_t skips = 0;
+    for (Rules::const_iterator rule = rules[start].begin(); rule != rules[start].end(); ++rule)
+      if (!rule->skip.empty())
+        ++skips;
+    if (skips > 0)
+    {
+      *out << (skips > 1 ? "        while (" : "        ");
+      const char *sep = "";
+      for (Rules::const_iterator rule = rules[start].begin(); rule != rules[start].end(); ++rule)
+      {
+        if (!rule->skip.empty())
+        {
+          *out << sep << (rule->comment ? "matcher().skip_line(" : "matcher().skip_bytes(");
+          write_cstring(*out, rule->skip);
+          *out << ")";
+          sep = " || ";
+        }
+      }
+      *out << (skips > 1 ? ")\n          continue;\n" : ";\n");
+    }
     if (!options["find"].empty())
     {
       if (!options["bison_locations"].empty() && options["bison_complete"].empty())
         *out <<
           "        matcher().find();\n"
           "        yylloc_update(yylloc);\n"
-          "        switch (matcher().accept())\n";
+          "        switch (" << keyword_lookup << "matcher().accept()" << keyword_lookup_end << ")\n";
       else
         *out <<
-          "        switch (matcher().find())\n";
+          "        switch (" << keyword_lookup << "matcher().find()" << keyword_lookup_end << ")\n";
       *out <<
         "        {\n"
         "          case 0:\n";
@@ -2931,10 +3631,10 @@ void Reflex::write_lexer()
         *out <<
           "        matcher().scan();\n"
           "        yylloc_update(yylloc);\n"
-          "        switch (matcher().accept())\n";
+          "        switch (" << keyword_lookup << "matcher().accept()" << keyword_lookup_end << ")\n";
       else
         *out <<
-          "        switch (matcher().scan())\n";
+          "        switch (" << keyword_lookup << "matcher().scan()" << keyword_lookup_end << ")\n";
       *out <<
         "        {\n"
         "          case 0:\n"
@@ -3036,7 +3736,10 @@ void Reflex::write_lexer()
       bool eof_rule = rule->regex == "<<EOF>>";
       if (!eof_rule || !has_code)
       {
-        if (!eof_rule)
+        if (!rule->keyword.empty())
+          *out <<
+            "          case " << keyword_accept++ << ": // rule " << rule->code.file << ":" << rule->code.lineno << ": " << rule->pattern << " : keyword\n";
+        else if (!eof_rule)
           *out <<
             "          case " << accept << ": // rule " << rule->code.file << ":" << rule->code.lineno << ": " << rule->pattern << " :\n";
         has_code = rule->code.line != "|";
@@ -3049,7 +3752,8 @@ void Reflex::write_lexer()
               *out <<
                 "            ++perf_report_" << conditions[start] << "_rule[" << report << "];\n"
                 "            perf_report_" << conditions[start] << "_size[" << report << "] += size();\n"
-                "            perf_report_time_pointer = &perf_report_" << conditions[start] << "_time[" << report << "];\n";
+                "            if (perf_report_tick == 0)\n"
+                "              perf_report_pointer = &perf_report_" << conditions[start] << "_sample[" << report << "];\n";
               ++report;
             }
           }
@@ -3070,7 +3774,8 @@ void Reflex::write_lexer()
             *out <<
               "            break;\n";
         }
-        ++accept;
+        if (rule->keyword.empty())
+          ++accept;
       }
     }
     *out <<
@@ -3258,6 +3963,18 @@ void Reflex::write_final()
         option.append(";o");
       if (!options["find"].empty())
         option.append(";p");
+      if (!options["profile_fsm"].empty())
+        option.append(";v=reflex.").append(name).append(".prof");
+      if (!options["hybrid_fsm"].empty())
+      {
+        std::string profile = "reflex." + name + ".prof";
+        FILE *file = NULL;
+        if (fopen_s(&file, profile.c_str(), "r") != 0 || file == NULL)
+          warning("option hybrid-fsm cannot read the FSM state visit counts in ", profile.c_str());
+        else
+          ::fclose(file);
+        option.append(";y=").append(profile);
+      }
       if (options["tables_file"] == "true")
         option.append(";f=reflex.").append(name).append(".cpp");
       else if (!options["tables_file"].empty())
@@ -3274,7 +3991,7 @@ void Reflex::write_final()
         reflex::Pattern pattern(patterns[start], option);
         reflex::Pattern::Index accept = 1;
         for (size_t rule = 0; rule < rules[start].size(); ++rule)
-          if (rules[start][rule].regex != "<<EOF>>")
+          if (rules[start][rule].regex != "<<EOF>>" && rules[start][rule].keyword.empty())
             if (!pattern.reachable(accept++))
               warning("rule cannot be matched because a previous rule subsumes it, perhaps try to move this rule up?", "", rules[start][rule].code.lineno);
         reflex::Pattern::Index n = 0;
@@ -3515,6 +4232,15 @@ void Reflex::write_header_file()
   }
 }
 
+/// Return the keyword rule shadowed by the given rule that matches the text, or the rule itself
+size_t Reflex::test_rule(Start start, size_t rule, const std::string& text)
+{
+  for (size_t i = 0; i < rule; ++i)
+    if (rules[start][i].shadow == rule && rules[start][i].keyword == text)
+      return i;
+  return rule;
+}
+
 /// Debug and test the lexer patterns of a specified start condition on a specified input file.
 void Reflex::do_test()
 {
@@ -3558,15 +4284,20 @@ void Reflex::do_test()
     reflex::Pattern pattern(patterns[start], "r");
     reflex::Pattern::Index accept = 1;
     for (size_t rule = 0; rule < rules[start].size(); ++rule)
-      if (rules[start][rule].regex != "<<EOF>>")
+      if (rules[start][rule].regex != "<<EOF>>" && rules[start][rule].keyword.empty())
         if (!pattern.reachable(accept++))
           warning("rule cannot be matched because a previous rule subsumes it, perhaps try to move this rule up?", "", rules[start][rule].code.lineno);
+    // map accept values to rules, skipping the keyword rules removed from the FSM by --keyword-hash
+    std::vector<size_t> index;
+    for (size_t rule = 0; rule < rules[start].size(); ++rule)
+      if (rules[start][rule].keyword.empty())
+        index.push_back(rule);
     reflex::Matcher matcher(pattern, input);
     if (!options["find"].empty())
     {
       while (matcher.find())
       {
-        Rule& rule = rules[start][matcher.accept() - 1];
+        Rule& rule = rules[start][test_rule(start, index[matcher.accept() - 1], matcher.str())];
         std::cout << "--" <<
           SGR("\033[1;35m") << "rule " << escape_bs(rule.code.file) << ":" << rule.code.lineno << SGR("\033[0m") <<
           " start(" << start << ") " << matcher.lineno() << "," << matcher.columno() <<
@@ -3579,7 +4310,7 @@ void Reflex::do_test()
       {
         if (matcher.scan())
         {
-          Rule& rule = rules[start][matcher.accept() - 1];
+          Rule& rule = rules[start][test_rule(start, index[matcher.accept() - 1], matcher.str())];
           std::cout << "--" <<
             SGR("\033[1;35m") << "rule " << escape_bs(rule.code.file) << ":" << rule.code.lineno << SGR("\033[0m") <<
             " start(" << start << ") " << matcher.lineno() << "," << matcher.columno() <<
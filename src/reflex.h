@@ -125,11 +125,17 @@ class Reflex
       :
         pattern(pattern),
         regex(regex),
-        code(code)
+        code(code),
+        shadow(0),
+        comment(false)
     { }
     std::string pattern; ///< the pattern
     std::string regex;   ///< the pattern-converted regex for the selected regex engine
     Code        code;    ///< the action code corresponding to the pattern
+    std::string keyword; ///< the keyword string when this rule is recognized with a perfect hash instead of the regex
+    size_t      shadow;  ///< index of the rule that matches the keyword, e.g. an identifier rule, when keyword is set
+    std::string skip;    ///< the bytes skipped by an ignorable rule, e.g. white space, or the prefix of an ignorable line comment rule
+    bool        comment; ///< true if this rule is an ignorable line comment rule that starts with the skip prefix
   };
 
   typedef std::map<std::string,Library>     LibraryMap; ///< Dictionary of regex libraries
@@ -152,6 +158,8 @@ class Reflex
   void        parse_section_1();
   void        parse_section_2();
   void        parse_section_3();
+  void        find_keywords();
+  void        find_ignorable();
   void        include(const std::string& filename);
   void        write();
   void        write_banner(const char *title);
@@ -163,6 +171,7 @@ class Reflex
   void        write_section_init();
   void        write_section_begin();
   void        write_perf_report();
+  void        write_keywords();
   void        write_section_1();
   void        write_section_3();
   void        write_code(const Codes& codes);
@@ -178,6 +187,7 @@ class Reflex
   void        write_regexp_file();
   void        write_header_file();
   void        do_test();
+  size_t      test_rule(Start start, size_t rule, const std::string& text);
   bool        get_line();
   bool        skip_comment(size_t& pos);
   bool        is(const char *s);
@@ -4,7 +4,22 @@
 // Or disable trigraphs by enabling the GNU standard:
 // c++ -std=gnu++11 -Wall test.cpp pattern.cpp matcher.cpp
 
+#include <reflex/abslexer.h>
+#include <reflex/fuzzymatcher.h>
+#include <reflex/lineindex.h>
 #include <reflex/matcher.h>
+#include <reflex/matcherpool.h>
+#include <reflex/output.h>
+#include <reflex/parallel.h>
+#include <reflex/staticpattern.h>
+#include <reflex/streammatcher.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <type_traits>
 
 // #define INTERACTIVE // for interactive mode testing
 
@@ -278,6 +293,61 @@ Test tests[] = {
   { NULL, NULL, NULL, NULL, { } }
 };
 
+#if __cplusplus >= 201703L
+struct StaticTokens { static constexpr const char *regex = "(?i)select|from|[a-z_][a-z0-9_]*|[0-9]+(\\.[0-9]+)?|\\s+|[^\\w\\s]"; };
+struct StaticNeedle { static constexpr const char *regex = "needle"; };
+struct StaticNegated { static constexpr const char *regex = "(?i)[^a-z]+|[^a]"; };
+#endif
+
+// a lexer with a start condition for strings to test ParallelLexer
+struct StringLexer {
+  StringLexer(const Input& input, std::ostream&) : start_(0), matcher_(initial(), input) { }
+  static const Pattern& initial() { static const Pattern pattern("[a-z]+|[0-9]+|\"|\\s+|."); return pattern; }
+  static const Pattern& string() { static const Pattern pattern("\"|\\\\.|[^\"\\\\]+"); return pattern; }
+  int lex()
+  {
+    size_t accept;
+    while ((accept = matcher_.scan()) != 0)
+    {
+      if (start_ == 0 && accept == 3)
+        matcher_.pattern(string()), start_ = 1;
+      else if (start_ == 1 && accept == 1)
+        matcher_.pattern(initial()), start_ = 0;
+      else if (start_ == 0 && accept == 4)
+        continue;
+      return static_cast<int>(10 * start_ + accept);
+    }
+    return 0;
+  }
+  int start() const { return start_; }
+  Matcher& matcher() { return matcher_; }
+  int start_;
+  Matcher matcher_;
+};
+
+// a lexer that echoes its input to test the destruction order of lexers and their output sinks
+struct EchoLexer : public reflex::AbstractLexer<reflex::Matcher> {
+  EchoLexer(const Input& input, std::ostream& os) : AbstractLexer(input, os) { }
+  int lex()
+  {
+    if (!has_matcher())
+      matcher(new Matcher("\\w+|\\W", stdinit(), this));
+    while (matcher().scan() != 0)
+      echo();
+    return 0;
+  }
+};
+
+// a lexer with an anchor to test ParallelLexer synchronization of chunks that do not start after a newline
+struct AnchorLexer {
+  AnchorLexer(const Input& input, std::ostream&) : matcher_(anchors(), input) { }
+  static const Pattern& anchors() { static const Pattern pattern("^a|a|b|\\n"); return pattern; }
+  int lex() { return static_cast<int>(matcher_.scan()); }
+  int start() const { return 0; }
+  Matcher& matcher() { return matcher_; }
+  Matcher matcher_;
+};
+
 int main()
 {
   banner("PATTERN TESTS");
@@ -784,6 +854,1041 @@ int main()
     error("match results");
   std::cout << std::endl;
   //
+  banner("TEST ADD/REMOVE");
+  //
+  Pattern blocklist("foo|bar");
+  Pattern update(blocklist);
+  if (update.add("ba[zr]+") != 3 || update.size() != 3)
+    error("add results");
+  update.remove(2);
+  if (update.size() != 3 || update.reachable(2) || !update.reachable(3))
+    error("remove results");
+  matcher.pattern(update);
+  matcher.input("foo bar baz");
+  test = "";
+  while (matcher.find())
+  {
+    std::cout << matcher.text() << "=" << matcher.accept() << "/";
+    test.append(matcher.text()).append("/");
+    if ((matcher.accept() == 1) != (matcher.size() == 3 && matcher.chr() == 'f'))
+      error("add/remove accept results");
+  }
+  std::cout << std::endl;
+  if (test != "foo/bar/baz/")
+    error("add/remove find results");
+  matcher.pattern(blocklist);
+  matcher.input("foo baz");
+  test = "";
+  while (matcher.find())
+    test.append(matcher.text()).append("/");
+  if (test != "foo/")
+    error("add/remove original pattern results");
+  // removing the last subpattern drops the placeholders of the removed subpatterns before it
+  Pattern trimmed(update);
+  trimmed.remove(3);
+  if (trimmed.size() != 1 || trimmed[0] != "foo" || trimmed.add("qux") != 2 || trimmed.size() != 2 || trimmed[0] != "foo|qux")
+    error("remove last results");
+  trimmed.remove(1);
+  trimmed.remove(2);
+  if (trimmed.size() != 1 || trimmed.reachable(1))
+    error("remove all results");
+  {
+    // updates are published as new patterns, the pattern a matcher uses does not change until it switches
+    reflex::SharedPattern shared("foo|bar");
+    Matcher sharing;
+    sharing.pattern(shared).input("foo bar baz");
+    std::shared_ptr<const Pattern> before = shared.get();
+    if (shared.add("ba[zr]+") != 3)
+      error("shared add results");
+    shared.remove(2);
+    if (&sharing.pattern() != before.get() || before->size() != 2 || shared.get()->size() != 3)
+      error("shared pattern published");
+    test = "";
+    while (sharing.find())
+      test.append(sharing.text()).append("/");
+    if (test != "foo/bar/")
+      error("shared pattern before update results");
+    sharing.pattern(shared).input("foo bar baz");
+    test = "";
+    while (sharing.find())
+      test.append(sharing.text()).append("=").append(std::to_string(sharing.accept())).append("/");
+    if (test != "foo=1/bar=3/baz=3/")
+      error("shared pattern after update results");
+    // update while matching in another thread
+    std::string words;
+    for (int i = 0; i < 1000; ++i)
+      words.append("foo bar baz ");
+    std::thread updater([&shared]() {
+      for (int i = 0; i < 20; ++i)
+        shared.add("w" + std::to_string(i));
+    });
+    size_t found = 0;
+    for (int i = 0; i < 20; ++i)
+    {
+      sharing.pattern(shared).input(words);
+      while (sharing.find())
+        ++found;
+    }
+    updater.join();
+    if (found != 20 * 3000 || shared.get()->size() != 23)
+      error("shared pattern concurrent update results");
+  }
+  //
+  banner("TEST POOL");
+  //
+  MatcherPool pool(blocklist, NULL, 16);
+  pool.reserve(2);
+  if (pool.size() != 2)
+    error("pool reserve results");
+  {
+    MatcherPool::Guard guard(pool, "foo bar foo");
+    if (pool.size() != 1)
+      error("pool acquire results");
+    test = "";
+    while (guard->find())
+      test.append(guard->text()).append("/");
+    if (test != "foo/bar/foo/")
+      error("pool find results");
+  }
+  for (int k = 0; k < 2; ++k)
+  {
+    char line[] = "bar foo";
+    MatcherPool::Guard guard(pool, line, sizeof(line));
+    test = "";
+    while (guard->find())
+      test.append(guard->text()).append("/");
+    if (test != "bar/foo/" || guard->lineno() != 1)
+      error("pool in-place find results");
+  }
+  {
+    std::string many;
+    for (int k = 0; k < 100; ++k)
+      many.append("foo bar ");
+    MatcherPool::Guard guard(pool, many);
+    size_t n = 0;
+    while (guard->find())
+      ++n;
+    if (n != 200)
+      error("pool large input results");
+  }
+  if (pool.size() != 2)
+    error("pool release results");
+  //
+  banner("TEST MATCH SPAN");
+  //
+  const char span[] = { 'f', 'o', 'o', ' ', 'b', 'a', 'r', 'x' }; // not 0-terminated
+  if (reflex::match(blocklist, span, 3) != 1 || reflex::match(blocklist, span, 4) != 0 || reflex::match(blocklist, std::string("bar")) != 2)
+    error("span match results");
+  size_t first = 0, last = 0;
+  if (reflex::search(blocklist, span + 1, 7, &first, &last) != 2 || first != 3 || last != 6)
+    error("span search results");
+  if (reflex::search(blocklist, span, 2) != 0)
+    error("span search mismatch results");
+  // a SpanMatcher is not a Matcher, so the span cannot be written through a Matcher reference with text() or unput()
+  if (std::is_convertible<reflex::SpanMatcher*, reflex::Matcher*>::value || std::is_convertible<reflex::SpanMatcher*, reflex::AbstractMatcher*>::value)
+    error("span matcher is convertible to a matcher");
+  reflex::SpanMatcher span_matcher(blocklist, span, sizeof(span));
+  if (span_matcher.search() != 1 || span_matcher.str() != "foo" || span_matcher.search() != 2 || span_matcher.first() != 4 || span_matcher.last() != 7 || span_matcher.search() != 0 || !span_matcher.at_end())
+    error("span matcher search results");
+  struct Collect {
+    std::string *out;
+    void operator()(size_t accept, size_t first, size_t last) const
+    {
+      out->append(1, static_cast<char>('0' + accept)).append(1, static_cast<char>('0' + first)).append(1, static_cast<char>('0' + last)).append("/");
+    }
+  };
+  test = "";
+  Collect collect = { &test };
+  if (reflex::find_all(blocklist, span, sizeof(span), collect) != 2 || test != "103/247/")
+    error("span find_all results");
+  //
+  banner("TEST MATCH BATCH");
+  //
+  {
+    const char *batch[] = { "foo", "bar", "baz", "", "foobar", "fo", "bar", "foo", "xbar", "foo" };
+    size_t sizes[10], accepts[10];
+    for (size_t k = 0; k < 10; ++k)
+      sizes[k] = strlen(batch[k]);
+    reflex::match_batch(update, batch, sizes, 10, accepts);
+    for (size_t k = 0; k < 10; ++k)
+      if (accepts[k] != reflex::match(update, batch[k], sizes[k]))
+        error("match batch results");
+    if (accepts[0] != 1 || accepts[2] != 3 || accepts[3] != 0 || accepts[4] != 0)
+      error("match batch accept results");
+    Pattern anchored("^fo+\\b|bar$");
+    reflex::match_batch(anchored, batch, sizes, 10, accepts);
+    for (size_t k = 0; k < 10; ++k)
+      if (accepts[k] != reflex::match(anchored, batch[k], sizes[k]))
+        error("match batch anchored results");
+  }
+  //
+  banner("TEST STREAM");
+  //
+  {
+    struct Report : public reflex::StreamMatcher::Handler {
+      std::string out;
+      void operator()(reflex::StreamMatcher&, size_t accept, size_t first, size_t last)
+      {
+        out.append(std::to_string(accept)).append(":").append(std::to_string(static_cast<long>(first))).append("-").append(std::to_string(last)).append("/");
+      }
+    } report;
+    Pattern stream("(?m)\\bfoo\\b|^ba[rz]|end$");
+    reflex::StreamMatcher matcher(stream, &report, 16);
+    const char *chunks[] = { "fo", "o xf", "oo ", "foo", "\nbaz\nthe e", "nd" };
+    for (size_t k = 0; k < 6; ++k)
+      matcher.feed(chunks[k], strlen(chunks[k]));
+    if (report.out != "1:0-3/1:9-12/2:13-16/")
+      error("stream matches");
+    matcher.finish();
+    if (report.out != "1:0-3/1:9-12/2:13-16/3:21-24/" || matcher.matches() != 4 || matcher.offset() != 24)
+      error("stream finish matches");
+    report.out.clear();
+    matcher.reset();
+    matcher.set_handler(NULL);
+    matcher.feed("foo", 3);
+    matcher.finish();
+    if (matcher.matches() != 1 || !report.out.empty())
+      error("stream reset matches");
+    Pattern overlap("aa");
+    reflex::StreamMatcher unbounded(overlap, &report);
+    unbounded.feed("aaa", 3);
+    unbounded.finish();
+    if (report.out != "1:-1-2/1:-1-3/")
+      error("stream overlapping matches");
+    // the start of a match that spans many chunks is reported when the match is not longer than the history
+    Pattern span("x[a-y]*z");
+    reflex::StreamMatcher spanning(span, &report, 64);
+    std::string spans = "x" + std::string(50, 'a') + "z x" + std::string(100, 'a') + "z axaz";
+    report.out.clear();
+    for (size_t k = 0; k < spans.size(); k += 7)
+      spanning.feed(spans.data() + k, std::min<size_t>(7, spans.size() - k));
+    spanning.finish();
+    if (report.out != "1:0-52/1:-1-155/1:157-160/")
+      error("stream start of matches");
+  }
+  //
+  banner("TEST RING");
+  //
+  {
+    std::string lines;
+    for (int k = 0; k < 4000; ++k)
+      lines.append(static_cast<size_t>(k % 97 + 1), 'a').append(k % 1000 == 500 ? std::string(10000, 'b') : std::string()).append(" xy\n");
+    Pattern ab("a+b*|xy");
+    Matcher plain(ab, lines);
+    Matcher ringed(ab, lines);
+#if WITH_RING
+    if (!ringed.ring(4096))
+      error("ring buffer");
+#endif
+    plain.buffer(512);
+    ringed.buffer(512);
+    while (plain.find())
+    {
+      if (!ringed.find() || ringed.first() != plain.first() || ringed.str() != plain.str() || ringed.lineno() != plain.lineno() || ringed.columno() != plain.columno())
+        error("ring buffer matches");
+    }
+    if (ringed.find())
+      error("ring buffer end");
+  }
+  //
+  banner("TEST INPUT FD");
+  //
+  {
+    const char *name = "rtest_fd.txt";
+    FILE *file = fopen(name, "wb");
+    if (file == NULL)
+      error("cannot create rtest_fd.txt");
+    fwrite("\xff\xfeh\0i\0 \0\xe9\0\n\0", 1, 12, file); // UTF-16LE with BOM
+    fclose(file);
+    int fd = open(name, O_RDONLY);
+    if (fd < 0)
+      error("cannot open rtest_fd.txt");
+    reflex::Input input(fd, reflex::Input::file_hint::sequential);
+    if (input.fd() != fd || input.file_encoding() != reflex::Input::file_encoding::utf16le || input.size() != 5)
+      error("input fd properties");
+    Pattern words("\\w+|\\s|[^\\w\\s]+");
+    Matcher matcher(words, input);
+    test = "";
+    while (matcher.scan())
+      test.append(matcher.str()).append("/");
+    if (test != "hi/ /\xc3\xa9/\n/" || !matcher.in.eof())
+      error("input fd results");
+    close(fd);
+    // Latin-1 without BOM spanning several blocks read, with the encoding given to the constructor
+    std::string latin, utf8;
+    for (int i = 0; i < 1000; ++i)
+    {
+      latin.append(i % 7 ? "a" : "\xe9");
+      utf8.append(i % 7 ? "a" : "\xc3\xa9");
+    }
+    file = fopen(name, "wb");
+    if (file == NULL)
+      error("cannot create rtest_fd.txt");
+    fwrite(latin.data(), 1, latin.size(), file);
+    fclose(file);
+    fd = open(name, O_RDONLY);
+    if (fd < 0)
+      error("cannot open rtest_fd.txt");
+    reflex::Input latin_input(fd, reflex::Input::file_encoding::latin);
+    if (latin_input.file_encoding() != reflex::Input::file_encoding::latin)
+      error("input fd encoding properties");
+    test = "";
+    char chunk[3];
+    size_t got;
+    while ((got = latin_input.get(chunk, sizeof(chunk))) > 0)
+      test.append(chunk, got);
+    if (test != utf8 || !latin_input.eof())
+      error("input fd encoding results");
+    close(fd);
+    // a copy of file descriptor input continues with the bytes left in the block read buffer
+    fd = open(name, O_RDONLY);
+    if (fd < 0)
+      error("cannot open rtest_fd.txt");
+    reflex::Input latin_first(fd, reflex::Input::file_encoding::latin);
+    got = latin_first.get(chunk, sizeof(chunk));
+    test.assign(chunk, got);
+    reflex::Input latin_copy(latin_first);
+    got = latin_copy.get(chunk, sizeof(chunk));
+    test.append(chunk, got);
+    reflex::Input latin_rest;
+    latin_rest = latin_copy;
+    while ((got = latin_rest.get(chunk, sizeof(chunk))) > 0)
+      test.append(chunk, got);
+    if (test != utf8)
+      error("input fd copy results");
+    close(fd);
+    remove(name);
+  }
+  //
+  banner("TEST OUTPUT");
+  //
+  {
+    std::string text, redacted;
+    for (int i = 0; i < 2000; ++i)
+    {
+      std::string line = "line " + std::to_string(i) + (i % 3 ? " password=" : " user=") + std::to_string(i * 7919) + "\n";
+      text.append(line);
+      if (i % 3)
+        line = "line " + std::to_string(i) + " password=****\n";
+      redacted.append(line);
+    }
+    // pass the unmatched input and redact matches, with a small buffer to shift the input often
+    Pattern secret("password=\\d+");
+    std::istringstream is(text);
+    Matcher filter(secret, is);
+    filter.buffer(256);
+    std::ostringstream os;
+    {
+      reflex::Output out(os, 64);
+      out.attach(filter);
+      while (filter.find())
+      {
+        out.pass(filter);
+        out.write("password=****", 13);
+      }
+      out.pass(filter);
+      out.detach();
+    }
+    if (os.str() != redacted)
+      error("output pass");
+    // echo all matches and copied text to a file descriptor
+    const char *name = "rtest_out.txt";
+    int fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      error("cannot create rtest_out.txt");
+    Pattern words("\\w+|\\s+|\\W");
+    std::istringstream in(text);
+    Matcher echoer(words, in);
+    echoer.buffer(256);
+    {
+      reflex::Output out(fd, 128);
+      while (echoer.scan())
+      {
+        if (*echoer.begin() == '=')
+          out.stream() << ':';
+        else
+          out.echo(echoer);
+      }
+      out.detach();
+      if (!out.good())
+        error("output write");
+    }
+    close(fd);
+    std::ifstream file(name, std::ios::binary);
+    std::stringstream result;
+    result << file.rdbuf();
+    file.close();
+    std::string expected = text;
+    std::replace(expected.begin(), expected.end(), '=', ':');
+    if (result.str() != expected)
+      error("output echo");
+    remove(name);
+    // write to a full non-blocking pipe, waiting for the pipe to become writable
+    int fds[2];
+    if (pipe(fds) != 0)
+      error("cannot create pipe");
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    std::string piped;
+    std::thread reader([&]() {
+      char chunk[4096];
+      ssize_t n;
+      while ((n = read(fds[0], chunk, sizeof(chunk))) > 0)
+        piped.append(chunk, static_cast<size_t>(n));
+    });
+    {
+      reflex::Output out(fds[1], 1 << 20);
+      for (int i = 0; i < 64; ++i)
+        out.write(text.data(), text.size());
+      out.flush();
+      if (!out.good())
+        error("output non-blocking write");
+    }
+    close(fds[1]);
+    reader.join();
+    close(fds[0]);
+    if (piped.size() != 64 * text.size() || piped.compare(0, text.size(), text) != 0)
+      error("output non-blocking");
+  }
+  {
+    // a lexer and its output sink can be deleted in any order
+    std::ostringstream echoed;
+    std::ostream none(NULL);
+    reflex::Output *sink = new reflex::Output(echoed);
+    EchoLexer *lexer = new EchoLexer(Input("echo this"), none);
+    lexer->out(*sink);
+    lexer->lex();
+    delete sink;
+    if (echoed.str() != "echo this" || lexer->sink() != NULL || &lexer->out() != &std::cout)
+      error("output deleted before lexer");
+    delete lexer;
+    echoed.str("");
+    sink = new reflex::Output(echoed);
+    lexer = new EchoLexer(Input("echo that"), none);
+    lexer->out(*sink);
+    lexer->lex();
+    delete lexer;
+    sink->write("!", 1);
+    delete sink;
+    if (echoed.str() != "echo that!")
+      error("lexer deleted before output");
+  }
+  //
+  banner("TEST STATIC PATTERN");
+  //
+#if __cplusplus >= 201703L
+  {
+    typedef reflex::StaticPattern<StaticTokens> Tokens;
+    if (Tokens::nop == 0 || Tokens::npred != 1)
+      error("static pattern tables");
+    Pattern tokens(StaticTokens::regex);
+    const char *sql = "SELECT a_1, 3.14 FROM t\nWHERE x >= 42;";
+    Matcher fixed(Tokens::pattern(), sql);
+    Matcher dynamic(tokens, sql);
+    test = "";
+    while (size_t accept = fixed.scan())
+    {
+      if (dynamic.scan() != accept || dynamic.str() != fixed.str())
+        error("static pattern scan");
+      test.append(std::to_string(accept)).append(":").append(fixed.str()).append("/");
+    }
+    if (dynamic.scan() != 0 || test != "1:SELECT/5: /3:a_1/6:,/5: /4:3.14/5: /2:FROM/5: /3:t/5:\n/3:WHERE/5: /3:x/5: /6:>/6:=/5: /4:42/6:;/")
+      error("static pattern results");
+    typedef reflex::StaticPattern<StaticNeedle> Needle;
+    if (std::string(Needle::pred.data()) != "06106e6565646c65")
+      error("static pattern predictor");
+    Matcher needle(Needle::pattern(), "haystack with a needle and another needle");
+    test = "";
+    while (needle.find())
+      test.append(std::to_string(needle.first())).append("/");
+    if (test != "16/35/")
+      error("static pattern find");
+    // case-insensitive negated bracket lists are folded before negating, the same as Pattern
+    typedef reflex::StaticPattern<StaticNegated> Negated;
+    Pattern negated(StaticNegated::regex);
+    const char *letters = "aAbB12 xAz";
+    Matcher fixed_negated(Negated::pattern(), letters);
+    Matcher dynamic_negated(negated, letters);
+    test = "";
+    while (fixed_negated.find())
+    {
+      if (!dynamic_negated.find() || dynamic_negated.accept() != fixed_negated.accept() || dynamic_negated.str() != fixed_negated.str())
+        error("static pattern negated list");
+      test.append(std::to_string(fixed_negated.accept())).append(":").append(fixed_negated.str()).append("/");
+    }
+    if (dynamic_negated.find() || test != "2:b/2:B/1:12 /2:x/2:z/")
+      error("static pattern negated list results");
+  }
+#endif
+  //
+  banner("TEST UNICODE CLASS CONVERSION");
+  //
+  {
+    std::string letters = Matcher::convert("\\p{L}+", convert_flag::unicode);
+    if (Matcher::convert("\\p{L}+", convert_flag::unicode) != letters)
+      error("unicode class conversion cache");
+    Pattern pattern(letters + "|" + Matcher::convert("\\P{L}+", convert_flag::unicode));
+    Matcher matcher(pattern, "héllo, wörld ΑΒΓ 漢字 123");
+    test = "";
+    while (matcher.scan())
+      test.append(std::to_string(matcher.accept())).append(":").append(matcher.text()).append("/");
+    std::cout << test << std::endl;
+    if (test != "1:héllo/2:, /1:wörld/2: /1:ΑΒΓ/2: /1:漢字/2: 123/")
+      error("unicode class conversion");
+    std::string ranges = Matcher::convert("[\\x{80}-\\x{10FFFF}]", convert_flag::unicode);
+    if (Matcher(ranges, "\xc2\x80").matches() == 0 || Matcher(ranges, "\xf4\x8f\xbf\xbf").matches() == 0 || Matcher(ranges, "\xf4\x90\x80\x80").matches() != 0)
+      error("unicode range conversion");
+  }
+  //
+  banner("TEST SHARED PREDICTOR TABLES");
+  //
+  {
+    Pattern *first = new Pattern("[a-z]+ing|error");
+    Pattern *second = new Pattern("[a-z]+ing|error");
+    Pattern copy(*first);
+    Pattern string("needle");
+    delete first;
+    const char *text = "no error, keep going and singing";
+    Matcher matcher(*second, text);
+    Matcher copied(copy, text);
+    test = "";
+    while (matcher.find())
+    {
+      if (!copied.find() || copied.str() != matcher.str())
+        error("shared predictor tables copy");
+      test.append(matcher.str()).append("/");
+    }
+    delete second;
+    if (copied.find() || test != "error/going/singing/")
+      error("shared predictor tables");
+    copy = string;
+    if (Matcher(copy, "a needle in a haystack").find() != 1)
+      error("shared predictor tables assign");
+  }
+  //
+  banner("TEST SKIP BYTES AND LINES");
+  //
+  {
+    for (size_t k = 0; k < 100; ++k)
+    {
+      std::string spaces = std::string(k, ' ') + "\t\n" + std::string(k, ' ') + "x";
+      const char *s = spaces.c_str();
+      if (reflex::skipbytes(s, s + spaces.size(), " \t\n") != s + spaces.size() - 1 || reflex::skipbytes(s, s + k, " ") != s + k)
+        error("skipbytes");
+    }
+    Pattern pattern("[ \\n]+|//.*|[a-z]+|/");
+    std::string input = "  one // comment\n\n   two / three //\n//last";
+    for (int interactive = 0; interactive <= 1; ++interactive)
+    {
+      std::istringstream stream(input);
+      Matcher matcher(pattern, stream);
+      if (interactive)
+        matcher.interactive();
+      test = "";
+      while (true)
+      {
+        while (matcher.skip_bytes(" \n") || matcher.skip_line("//"))
+          continue;
+        if (matcher.scan() == 0)
+          break;
+        test.append(std::to_string(matcher.lineno())).append(":").append(matcher.text()).append("/");
+      }
+      std::cout << test << std::endl;
+      if (test != "1:one/3:two/3://3:three/")
+        error("skip bytes and lines");
+    }
+  }
+  //
+  banner("TEST PARALLEL LEXER");
+  //
+  {
+    std::string data;
+    srand(42);
+    for (size_t i = 0; i < 3000; ++i)
+    {
+      switch (rand() % 6)
+      {
+        case 0: data.append("word "); break;
+        case 1: data.append("12345 "); break;
+        case 2: data.append("\"a string\n\\\" with \"\n\" "); break;
+        case 3: data.append("\n"); break;
+        case 4: data.append("; "); break;
+        case 5: data.append("\"\n\n\n\n\n\" "); break;
+      }
+    }
+    std::vector<ParallelLexer<StringLexer>::Token> expect;
+    std::ostream null(NULL);
+    StringLexer lexer(Input(data.c_str(), data.size()), null);
+    int id;
+    while ((id = lexer.lex()) != 0)
+      expect.push_back(ParallelLexer<StringLexer>::Token(id, lexer.matcher().first(), lexer.matcher().size()));
+    for (size_t threads = 1; threads <= 8; ++threads)
+    {
+      for (int sync = -1; sync <= '\n'; sync += '\n' + 1)
+      {
+        ParallelLexer<StringLexer> parallel(threads, sync);
+        if (parallel.lex(data.c_str(), data.size()) != expect.size())
+          error("parallel lexer token count");
+        size_t k = 0;
+        for (size_t i = 0; i < parallel.chunks(); ++i)
+          for (size_t j = 0; j < parallel.tokens(i).size(); ++j, ++k)
+            if (parallel.tokens(i)[j].id != expect[k].id || parallel.tokens(i)[j].first != expect[k].first || parallel.tokens(i)[j].size != expect[k].size)
+              error("parallel lexer tokens");
+        std::cout << threads << " threads, sync " << sync << ": " << parallel.chunks() << " chunks, " << parallel.relexed() << " bytes relexed" << std::endl;
+      }
+    }
+    ParallelLexer<StringLexer> parallel(4);
+    if (parallel.lex("", 0) != 0 || parallel.lex("x", 1) != 1)
+      error("parallel lexer small input");
+    // chunks that start in the middle of a line must not match ^a at their start
+    std::string lines;
+    for (size_t i = 0; i < 100; ++i)
+      lines.append(i % 10 == 9 ? "ba\na" : "ba");
+    std::vector<int> ids;
+    AnchorLexer anchor(Input(lines.c_str(), lines.size()), null);
+    while ((id = anchor.lex()) != 0)
+      ids.push_back(id);
+    for (size_t threads = 1; threads <= 8; ++threads)
+    {
+      ParallelLexer<AnchorLexer> anchored(threads, -1);
+      if (anchored.lex(lines.c_str(), lines.size()) != ids.size())
+        error("parallel lexer anchor token count");
+      size_t k = 0;
+      for (size_t i = 0; i < anchored.chunks(); ++i)
+        for (size_t j = 0; j < anchored.tokens(i).size(); ++j, ++k)
+          if (anchored.tokens(i)[j].id != ids[k])
+            error("parallel lexer anchor tokens");
+    }
+  }
+  //
+  banner("TEST CONTAINS");
+  //
+  {
+    const char *regexes[] = { "abc", "a[0-9]+b", "x|yz|[0-9]{3}", "a*", "(?i)error|warn", "\\w+@\\w+", "a(?=bc)", "^ab", "(?m)^ab", "\\bcd\\b", "\\bx[^z]*y", "(?m)^x[^z]*y", "[a-c]+d", "b\\n?c", "(?^ab)|b", NULL };
+    srand(7);
+    for (const char **regex = regexes; *regex != NULL; ++regex)
+    {
+      Pattern pattern(*regex);
+      for (size_t k = 0; k < 300; ++k)
+      {
+        std::string input;
+        size_t n = rand() % 40;
+        for (size_t i = 0; i < n; ++i)
+          input.push_back("abcdxyz0123 @\nERwarn"[rand() % 21]);
+        if (reflex::contains(pattern, input) != (reflex::search(pattern, input) != 0))
+          error("contains");
+        std::istringstream stream(input);
+        Matcher matcher(pattern, stream);
+        if (matcher.contains() != (reflex::search(pattern, input) != 0))
+          error("contains stream");
+        // read the input in small blocks, the advance gives up on the last bytes buffered
+        std::istringstream block_stream(input);
+        Matcher blocks(pattern, block_stream);
+        blocks.buffer(8);
+        if (blocks.contains() != (reflex::search(pattern, input) != 0))
+          error("contains stream blocks");
+        std::string lines;
+        size_t count = 0;
+        size_t pos = 0;
+        while (pos <= input.size())
+        {
+          size_t end = input.find('\n', pos);
+          if (end == std::string::npos)
+            end = input.size();
+          std::string text = input.substr(pos, end - pos);
+          if (reflex::search(pattern, text) != 0)
+          {
+            lines.append(text).append("|");
+            ++count;
+          }
+          pos = end + 1;
+        }
+        if (std::strstr(*regex, "\\n") == NULL)
+        {
+          std::string found;
+          if (reflex::find_lines(pattern, input, [&](size_t first, size_t last) { found.append(input.substr(first, last - first)).append("|"); }) != count || found != lines)
+            error("find lines");
+        }
+      }
+    }
+    Pattern pattern("[0-9]+");
+    if (!reflex::contains(pattern, "abc 123") || reflex::contains(pattern, "abc") || reflex::contains(pattern, ""))
+      error("contains digits");
+    // the advance may stop at the end of the input when the pattern is not found
+    Pattern lazy("(a|b)*?c");
+    if (!reflex::contains(lazy, "xxabxc") || reflex::contains(lazy, "xxabx") || reflex::contains(lazy, ""))
+      error("contains lazy");
+    std::string input = "no\nthe 42\nnone\n7\n";
+    std::string found;
+    if (reflex::find_lines(pattern, input, [&](size_t first, size_t last) { found.append(input.substr(first, last - first)).append("|"); }) != 2 || found != "the 42|7|")
+      error("find lines digits");
+    // a match that crosses a newline must not hide a match on the next line
+    input = "x\nxy\nq\n";
+    found = "";
+    if (reflex::find_lines(Pattern("\\bx[^z]*y"), input, [&](size_t first, size_t last) { found.append(input.substr(first, last - first)).append("|"); }) != 1 || found != "xy|")
+      error("find lines word boundary");
+    found = "";
+    if (reflex::find_lines(Pattern("(?m)^x[^z]*y"), input, [&](size_t first, size_t last) { found.append(input.substr(first, last - first)).append("|"); }) != 1 || found != "xy|")
+      error("find lines anchor");
+  }
+  //
+  banner("TEST COUNT ALL");
+  //
+  {
+    const char *regexes[] = { "abc", "a[0-9]+b", "x|yz|[0-9]{3}", "a*", "\\w+", "a(?=bc)", "^ab", "b\\n?c", "a.*?c", "(?^ab)|[a-c]", "[a-d]+(?=x)", "ab|abcd|a", "x[^\\n]*y", "(a|b)*?c", NULL };
+    srand(11);
+    for (const char **regex = regexes; *regex != NULL; ++regex)
+    {
+      Pattern pattern(*regex);
+      for (size_t k = 0; k < 200; ++k)
+      {
+        std::string input;
+        size_t n = rand() % 60;
+        for (size_t i = 0; i < n; ++i)
+          input.push_back("abcdxyz0123 \n"[rand() % 13]);
+        std::vector<std::pair<size_t,size_t> > expected;
+        size_t lines = 0;
+        size_t line = 0;
+        Matcher iter(pattern, input);
+        while (iter.find())
+        {
+          expected.push_back(std::pair<size_t,size_t>(iter.first(), iter.last()));
+          if (lines == 0 || iter.lineno() != line)
+          {
+            line = iter.lineno();
+            ++lines;
+          }
+        }
+        if (reflex::count_all(pattern, input) != expected.size())
+          error("count all");
+        if (reflex::count_lines(pattern, input) != lines)
+          error("count all lines");
+        std::istringstream stream(input);
+        Matcher matcher(pattern, stream);
+        std::vector<std::pair<size_t,size_t> > offsets;
+        if (matcher.find_all(offsets) != expected.size() || offsets != expected)
+          error("find all offsets");
+        // read the input in small blocks to shift the buffer while counting
+        std::istringstream block_stream(input);
+        Matcher blocks(pattern, block_stream);
+        blocks.buffer(16);
+        offsets.clear();
+        if (blocks.find_all(offsets) != expected.size() || offsets != expected)
+          error("find all offsets blocks");
+        std::istringstream lines_stream(input);
+        if (Matcher(pattern, lines_stream).count_all(true) != lines)
+          error("count all lines stream");
+      }
+    }
+    Pattern pattern("[0-9]+");
+    if (reflex::count_all(pattern, "1 22\n\n333 x\n4") != 4 || reflex::count_lines(pattern, "1 22\n\n333 x\n4") != 3)
+      error("count all digits");
+    // a long last line without a newline is scanned for a newline once, also when the buffer shifts
+    std::string text = "1\n\n";
+    for (size_t i = 0; i < 100000; ++i)
+      text.append("12 ");
+    if (reflex::count_lines(pattern, text) != 2)
+      error("count all lines long line");
+    std::istringstream stream(text + "\n" + text);
+    if (Matcher(pattern, stream).count_all(true) != 4)
+      error("count all lines long line stream");
+  }
+  //
+  banner("TEST LINE INDEX");
+  //
+  {
+    Pattern pattern("\\w+|\\n");
+    srand(13);
+    for (size_t k = 0; k < 300; ++k)
+    {
+      std::string input;
+      size_t n = rand() % 80;
+      for (size_t i = 0; i < n; ++i)
+        input.push_back("ab \t\n\xc3\xa9"[rand() % 7]);
+      LineIndex index(input);
+      if (index.lines() != static_cast<size_t>(std::count(input.begin(), input.end(), '\n')) + 1)
+        error("line index lines");
+      Matcher matcher(pattern, input);
+      matcher.tabs(4);
+      while (matcher.find())
+      {
+        size_t pos = matcher.first();
+        size_t bol = input.rfind('\n', pos == 0 ? 0 : pos - 1);
+        bol = pos == 0 || bol == std::string::npos ? 0 : bol + 1;
+        size_t eol = input.find('\n', pos);
+        if (eol == std::string::npos)
+          eol = input.size();
+        if (index.lineno(matcher) != matcher.lineno() || index.columno(matcher) != matcher.columno())
+          error("line index lineno columno");
+        if (index.bol(pos) != bol || index.eol(pos) != eol || index.bol_of(index.lineno(pos)) != bol || index.eol_of(index.lineno(pos)) != eol)
+          error("line index bol eol");
+      }
+      if (index.lineno(input.size()) != index.lines() || index.eol(input.size()) != input.size())
+        error("line index end");
+    }
+    std::string text = "ab\n\ncd\n";
+    LineIndex index(text);
+    if (index.lines() != 4 || index.lineno(3) != 2 || index.lineno(4) != 3 || index.bol(5) != 4 || index.eol(5) != 6 || index.bol_of(4) != 7 || index.bol_of(5) != 7)
+      error("line index lines and positions");
+  }
+  //
+  banner("TEST CASE-INSENSITIVE STRING SEARCH");
+  //
+  {
+    const char *words[] = { "error", "e-42", "xy", "abcdefghijklmnopqrstuvwxyz0123456789abcdef", NULL };
+    const char *regexes[] = { "(?i)error", "(?i)e-42", "(?i)xy", "(?i)abcdefghijklmnopqrstuvwxyz0123456789abcdef", NULL };
+    srand(17);
+    for (size_t w = 0; words[w] != NULL; ++w)
+    {
+      for (int digits = 0; digits < 2; ++digits)
+      {
+        std::string word = words[w];
+        Pattern pattern(std::string(regexes[w]).append(digits ? "[0-9]+" : ""));
+        for (size_t k = 0; k < 200; ++k)
+        {
+          std::string input;
+          size_t n = rand() % 400;
+          while (input.size() < n)
+          {
+            int r = rand() % 10;
+            if (r < 2)
+              for (size_t i = 0; i < word.size(); ++i)
+                input.push_back(rand() % 2 ? static_cast<char>(std::toupper(word[i])) : word[i]);
+            else if (r < 3)
+              input.push_back("0123456789"[rand() % 10]);
+            else
+              input.push_back(" eErR@`{[-!xXyY0aA\xc5\xe5"[rand() % 20]);
+          }
+          std::string expected;
+          size_t i = 0;
+          while (i + word.size() <= input.size())
+          {
+            size_t j = 0;
+            while (j < word.size() && std::tolower(static_cast<unsigned char>(input[i + j])) == word[j])
+              ++j;
+            if (j == word.size() && digits)
+              while (i + j < input.size() && std::isdigit(static_cast<unsigned char>(input[i + j])))
+                ++j;
+            if (j > word.size() || (j == word.size() && !digits))
+            {
+              expected.append(std::to_string(i)).append("-").append(std::to_string(i + j)).append(" ");
+              i += j;
+            }
+            else
+            {
+              ++i;
+            }
+          }
+          std::string found;
+          Matcher matcher(pattern, input);
+          while (matcher.find())
+            found.append(std::to_string(matcher.first())).append("-").append(std::to_string(matcher.last())).append(" ");
+          if (found != expected)
+            error("case-insensitive string search");
+        }
+      }
+    }
+    Matcher matcher("(?i:ab)CD", "abcd aBCD ABCd ABCD");
+    if (!matcher.find() || matcher.first() != 5 || !matcher.find() || matcher.first() != 15 || matcher.find())
+      error("case-insensitive prefix search");
+    // the fuzzy matcher searches both cases of the first char of the prefix, the prefix is stored in lower case
+    Pattern error_pattern("(?i)error");
+    std::string text = "xx ERROR yy Error zz ERRXR";
+    FuzzyMatcher fuzzy(error_pattern, 1, text);
+    std::string found;
+    while (fuzzy.find())
+      found.append(fuzzy.str()).append(" ");
+    if (found != "ERROR Error ERRXR ")
+      error("case-insensitive fuzzy search");
+  }
+  //
+  banner("TEST NFA FALLBACK");
+  //
+  {
+    // the DFA of (a|b)*a(a|b){14} has 32768 states, the bit-parallel NFA has a few dozen positions
+    Pattern pattern("(a|b)*a(a|b){14}|cab");
+    if (pattern.positions() == 0 || pattern.nodes() != 0)
+      error("NFA fallback");
+    Pattern dfa("(a|b)*a(a|b){4}|cab", "d");
+    if (dfa.positions() != 0)
+      error("NFA fallback disabled");
+    srand(7);
+    for (int k = 0; k < 200; ++k)
+    {
+      std::string input;
+      size_t len = rand() % 120;
+      for (size_t i = 0; i < len; ++i)
+        input.push_back("abababx"[rand() % 7]);
+      // leftmost longest matches end 15 chars after the last 'a' of each a|b run
+      std::string expected;
+      size_t i = 0;
+      while (i < input.size())
+      {
+        size_t j = i;
+        while (j < input.size() && input[j] != 'x')
+          ++j;
+        size_t b = i;
+        while (j >= b + 15)
+        {
+          size_t p = j - 15 + 1;
+          while (p > b && input[p - 1] != 'a')
+            --p;
+          if (p == b)
+            break;
+          expected.append(std::to_string(b)).append("-").append(std::to_string(p + 14)).append(" ");
+          b = p + 14;
+        }
+        i = j + 1;
+      }
+      std::string found;
+      Matcher matcher(pattern, input);
+      while (matcher.find())
+        found.append(std::to_string(matcher.first())).append("-").append(std::to_string(matcher.last())).append(" ");
+      if (found != expected)
+        error("NFA find");
+      bool whole = input.size() >= 15 && input[input.size() - 15] == 'a' && input.find('x') == std::string::npos;
+      if ((Matcher(pattern, input).matches() != 0) != whole)
+        error("NFA matches");
+    }
+    Matcher matcher(pattern, "xcabx");
+    if (!matcher.find() || matcher.accept() != 2 || matcher.str() != "cab" || matcher.find())
+      error("NFA string alternative");
+  }
+  {
+    // the repeats [ab]{5000} and [ab]{100,200} collapse into counter positions, the expanded NFA has more than 4096 positions
+    Pattern pattern("[ab]*a[ab]{5000}|c[ab]{100,200}d");
+    if (pattern.positions() == 0 || pattern.positions() > 16)
+      error("NFA counters");
+    std::string run = std::string(10, 'b') + "a" + std::string(5000, 'b');
+    std::string input = "x" + run + "x";
+    Matcher matcher(pattern, input);
+    if (!matcher.find() || matcher.first() != 1 || matcher.size() != run.size() || matcher.find())
+      error("NFA counter find");
+    if (Matcher(pattern, run.substr(1)).matches() == 0 || Matcher(pattern, run.substr(0, run.size() - 1)).matches() != 0)
+      error("NFA counter matches");
+    for (size_t k = 90; k < 210; ++k)
+    {
+      std::string input = "c" + std::string(k, 'a') + "d";
+      if ((Matcher(pattern, input).matches() != 0) != (k >= 100 && k <= 200))
+        error("NFA bounded counter matches");
+    }
+  }
+  {
+    // the fuzzy and streaming matchers construct the DFA of a pattern matched with the NFA
+    Pattern pattern("(a|b)*a(a|b){14}");
+    std::string input = "xx" + std::string(20, 'a') + "yy";
+    FuzzyMatcher fuzzy(pattern, 1, input);
+    if (pattern.positions() == 0 || !fuzzy.find() || fuzzy.str().find(std::string(20, 'a')) == std::string::npos)
+      error("NFA fuzzy matcher");
+    reflex::StreamMatcher stream(pattern);
+    stream.feed(input.data(), input.size());
+    stream.finish();
+    if (stream.matches() == 0)
+      error("NFA stream matcher");
+    // setting an NFA pattern constructs its DFA, replacing the DFA owned by the matcher
+    Pattern other("(a|b)*b(a|b){14}");
+    std::string bees = "xx" + std::string(20, 'b') + "yy";
+    stream.pattern(other);
+    stream.feed(bees.data(), bees.size());
+    stream.finish();
+    if (other.positions() == 0 || stream.matches() == 0 || &stream.pattern() == &other)
+      error("NFA stream matcher pattern");
+    stream.pattern(stream.pattern());
+    stream.feed(bees.data(), bees.size());
+    stream.finish();
+    if (stream.matches() == 0)
+      error("NFA stream matcher same pattern");
+    // FSM code has no opcode table to walk
+    Pattern fsm(static_cast<Pattern::FSM>([](reflex::Matcher&) { }));
+    try
+    {
+      reflex::StreamMatcher none(fsm);
+      error("NFA stream matcher FSM");
+    }
+    catch (const std::invalid_argument&)
+    { }
+    try
+    {
+      stream.pattern(fsm);
+      error("NFA stream matcher set FSM");
+    }
+    catch (const std::invalid_argument&)
+    { }
+    stream.reset();
+    stream.feed(bees.data(), bees.size());
+    stream.finish();
+    if (stream.matches() == 0)
+      error("NFA stream matcher after FSM");
+  }
+  //
+  banner("TEST ESTIMATE");
+  //
+  {
+    // the estimate of a constructed DFA is exact
+    Pattern pattern("(a|b)*a(a|b){4}");
+    const Pattern::Estimate& estimate = pattern.estimate();
+    if (!estimate.exact || estimate.states != pattern.nodes() || estimate.positions == 0 || estimate.repeats != 4 || estimate.bytes == 0)
+      error("estimate exact");
+  }
+  {
+    // the DFA of (a|b)*a(a|b){20} has 2^21 states, simulate the NFA instead when the estimate exceeds the limit
+    Pattern pattern("(a|b)*a(a|b){20}", "l=1000");
+    if (pattern.estimate().exact || pattern.estimate().states <= 1000 || pattern.nodes() > 1000 || pattern.positions() == 0)
+      error("estimate limit");
+    std::string input = "bba" + std::string(20, 'b');
+    if (Matcher(pattern, input).matches() == 0)
+      error("estimate limit matches");
+  }
+  {
+    // refuse early when the NFA cannot be simulated
+    try
+    {
+      Pattern pattern("(a|b)*a(a|b){20}", "dl=1000");
+      error("estimate limit throws");
+    }
+    catch (const regex_error& e)
+    {
+      if (e.code() != regex_error::exceeds_limits)
+        error("estimate limit code");
+    }
+  }
+  {
+    // a small DFA within the limit is constructed
+    Pattern pattern("\\w+\\s+\\w+", "l=1000");
+    if (!pattern.estimate().exact || pattern.nodes() == 0 || pattern.positions() != 0)
+      error("estimate within limit");
+  }
+  //
+  banner("TEST MEMORY USAGE");
+  //
+  {
+    Pattern pattern("\\w+\\s+\\w+");
+    Pattern::Memory memory = pattern.memory_usage();
+    if (memory.opcodes != pattern.words() * sizeof(Pattern::Opcode) || memory.nfa != 0 || memory.total != memory.pattern + memory.opcodes + memory.predictor + memory.hfa + memory.nfa || memory.peak <= memory.total)
+      error("pattern memory usage");
+    Pattern nfa("(a|b)*a(a|b){20}");
+    memory = nfa.memory_usage();
+    if (memory.opcodes != 0 || memory.nfa == 0 || memory.peak <= memory.total)
+      error("NFA pattern memory usage");
+    // the buffer grows to hold a long match, its peak size is retained when the matcher scans a buffer in place
+    Pattern word("\\w+");
+    std::string input(4 * AbstractMatcher::Const::BUFSZ, 'a');
+    Matcher matcher(word, input);
+    if (matcher.memory_usage().buffer != AbstractMatcher::Const::BUFSZ + 1 || matcher.memory_usage().pattern != 0)
+      error("matcher memory usage");
+    if (!matcher.find() || matcher.size() != input.size())
+      error("matcher memory usage find");
+    Matcher::Memory usage = matcher.memory_usage();
+    if (usage.buffer <= input.size() || usage.total != usage.matcher + usage.buffer + usage.pattern || usage.peak != usage.total)
+      error("matcher memory usage grow");
+    char span[] = "abc";
+    matcher.buffer(span, sizeof(span));
+    if (matcher.memory_usage().buffer != 0 || matcher.memory_usage().peak != usage.peak)
+      error("matcher memory usage peak");
+    Matcher owner("\\w+", "abc");
+    if (owner.memory_usage().pattern != word.memory_usage().total)
+      error("matcher memory usage owned pattern");
+  }
+  //
   banner("DONE");
   return 0;
 }